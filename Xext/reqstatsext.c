@@ -0,0 +1,256 @@
+/*
+ * Copyright © 2026 X.Org Foundation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * XORG-REQUEST-STATS: reads, resets and toggles the request statistics
+ * collected in dix/reqstats.c.  See reqstatsproto.h for the wire format.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <string.h>
+#include <X11/X.h>
+#include <X11/Xproto.h>
+#include "misc.h"
+#include "os.h"
+#include "dixstruct.h"
+#include "extnsionst.h"
+#include "swaprep.h"
+#include "extinit.h"
+#include "xace.h"
+#include "protocol-versions.h"
+#include "reqstats.h"
+#include "reqstatsproto.h"
+
+static void
+CountRequestStats(int major, int minor, ReqStatsPtr stats, void *closure)
+{
+    int *num_stats = closure;
+
+    (*num_stats)++;
+}
+
+#define Put64(field, value) do {                \
+        field ## _hi = (CARD64) (value) >> 32;  \
+        field ## _lo = (value) & 0xffffffff;    \
+    } while (0)
+
+static void
+WriteRequestStats(int major, int minor, ReqStatsPtr stats, void *closure)
+{
+    ClientPtr client = closure;
+    xReqStatsOpcodeStats scratch = {
+        .major = major,
+        .minor = minor,
+        .max_us = stats->max_us
+    };
+    CARD32 buckets[REQSTATS_NUM_BUCKETS];
+
+    Put64(scratch.count, stats->count);
+    Put64(scratch.errors, stats->errors);
+    Put64(scratch.bytes_in, stats->bytes_in);
+    Put64(scratch.total_us, stats->total_us);
+    memcpy(buckets, stats->buckets, sizeof(buckets));
+
+    if (client->swapped) {
+        swaps(&scratch.minor);
+        SwapLongs((CARD32 *) &scratch.count_hi,
+                  bytes_to_int32(sz_xReqStatsOpcodeStats) - 1);
+        SwapLongs(buckets, REQSTATS_NUM_BUCKETS);
+    }
+    WriteToClient(client, sz_xReqStatsOpcodeStats, &scratch);
+    WriteToClient(client, sizeof(buckets), buckets);
+}
+
+static int
+ProcReqStatsQueryVersion(ClientPtr client)
+{
+    xReqStatsQueryVersionReply rep = {
+        .type = X_Reply,
+        .sequenceNumber = client->sequence,
+        .length = 0,
+        .majorVersion = SERVER_REQSTATS_MAJOR_VERSION,
+        .minorVersion = SERVER_REQSTATS_MINOR_VERSION
+    };
+
+    REQUEST_SIZE_MATCH(xReqStatsQueryVersionReq);
+
+    if (client->swapped) {
+        swaps(&rep.sequenceNumber);
+        swapl(&rep.majorVersion);
+        swapl(&rep.minorVersion);
+    }
+    WriteToClient(client, sizeof(xReqStatsQueryVersionReply), &rep);
+    return Success;
+}
+
+static int
+ProcReqStatsQueryRequestStats(ClientPtr client)
+{
+    REQUEST(xReqStatsQueryRequestStatsReq);
+    xReqStatsQueryRequestStatsReply rep;
+    ClientReqStatsPtr cstats = NULL;
+    int num_stats = 0;
+    int rc;
+
+    REQUEST_SIZE_MATCH(xReqStatsQueryRequestStatsReq);
+
+    if (stuff->client != None) {
+        int clientID = CLIENT_ID(stuff->client);
+
+        if ((clientID >= currentMaxClients) || !clients[clientID]) {
+            client->errorValue = stuff->client;
+            return BadValue;
+        }
+        cstats = ReqStatsForClient(clients[clientID]);
+    }
+
+    if (stuff->flags & ~(ReqStatsFlagEnable | ReqStatsFlagDisable |
+                         ReqStatsFlagReset)) {
+        client->errorValue = stuff->flags;
+        return BadValue;
+    }
+
+    /* A client may always read its own row; anything else is server state */
+    if (!cstats || CLIENT_ID(stuff->client) != client->index) {
+        rc = XaceHook(XACE_SERVER_ACCESS, client, DixGetAttrAccess);
+        if (rc != Success)
+            return rc;
+    }
+    if (stuff->flags) {
+        rc = XaceHook(XACE_SERVER_ACCESS, client, DixManageAccess);
+        if (rc != Success)
+            return rc;
+    }
+
+    if (stuff->flags & ReqStatsFlagReset)
+        ReqStatsReset();
+    if (stuff->flags & ReqStatsFlagEnable)
+        reqStatsEnabled = TRUE;
+    if (stuff->flags & ReqStatsFlagDisable)
+        reqStatsEnabled = FALSE;
+
+    if (!cstats)
+        ReqStatsForEach(CountRequestStats, &num_stats);
+
+    rep = (xReqStatsQueryRequestStatsReply) {
+        .type = X_Reply,
+        .enabled = reqStatsEnabled,
+        .sequenceNumber = client->sequence,
+        .length = bytes_to_int32(cstats ? sz_xReqStatsClientStats :
+                                 num_stats * (sz_xReqStatsOpcodeStats +
+                                              REQSTATS_NUM_BUCKETS * 4)),
+        .numStats = num_stats,
+        .numBuckets = REQSTATS_NUM_BUCKETS
+    };
+    if (client->swapped) {
+        swaps(&rep.sequenceNumber);
+        swapl(&rep.length);
+        swapl(&rep.numStats);
+        swapl(&rep.numBuckets);
+    }
+    WriteToClient(client, sizeof(xReqStatsQueryRequestStatsReply), &rep);
+
+    if (cstats) {
+        xReqStatsClientStats scratch = {
+            .max_us = cstats->max_us,
+            .reads = cstats->reads
+        };
+
+        Put64(scratch.requests, cstats->requests);
+        Put64(scratch.errors, cstats->errors);
+        Put64(scratch.bytes_in, cstats->bytes_in);
+        Put64(scratch.bytes_out, cstats->bytes_out);
+        Put64(scratch.total_us, cstats->total_us);
+
+        if (client->swapped)
+            SwapLongs((CARD32 *) &scratch,
+                      bytes_to_int32(sz_xReqStatsClientStats));
+        WriteToClient(client, sz_xReqStatsClientStats, &scratch);
+    }
+    else
+        ReqStatsForEach(WriteRequestStats, client);
+
+    return Success;
+}
+
+static int
+ProcReqStatsDispatch(ClientPtr client)
+{
+    REQUEST(xReq);
+
+    switch (stuff->data) {
+    case X_ReqStatsQueryVersion:
+        return ProcReqStatsQueryVersion(client);
+    case X_ReqStatsQueryRequestStats:
+        return ProcReqStatsQueryRequestStats(client);
+    default:
+        return BadRequest;
+    }
+}
+
+static int _X_COLD
+SProcReqStatsQueryVersion(ClientPtr client)
+{
+    REQUEST(xReqStatsQueryVersionReq);
+    REQUEST_SIZE_MATCH(xReqStatsQueryVersionReq);
+    swapl(&stuff->majorVersion);
+    swapl(&stuff->minorVersion);
+    return ProcReqStatsQueryVersion(client);
+}
+
+static int _X_COLD
+SProcReqStatsQueryRequestStats(ClientPtr client)
+{
+    REQUEST(xReqStatsQueryRequestStatsReq);
+    REQUEST_SIZE_MATCH(xReqStatsQueryRequestStatsReq);
+    swapl(&stuff->client);
+    swapl(&stuff->flags);
+    return ProcReqStatsQueryRequestStats(client);
+}
+
+static int _X_COLD
+SProcReqStatsDispatch(ClientPtr client)
+{
+    REQUEST(xReq);
+
+    swaps(&stuff->length);
+    switch (stuff->data) {
+    case X_ReqStatsQueryVersion:
+        return SProcReqStatsQueryVersion(client);
+    case X_ReqStatsQueryRequestStats:
+        return SProcReqStatsQueryRequestStats(client);
+    default:
+        return BadRequest;
+    }
+}
+
+void
+ReqStatsExtensionInit(void)
+{
+    AddExtension(REQSTATS_NAME, 0, 0,
+                 ProcReqStatsDispatch, SProcReqStatsDispatch,
+                 NULL, StandardMinorOpcode);
+}
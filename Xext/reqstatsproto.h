@@ -0,0 +1,127 @@
+/*
+ * Copyright © 2026 X.Org Foundation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Wire protocol of XORG-REQUEST-STATS, a private extension of this server
+ * that reports the request statistics collected in dix/reqstats.c.  It is
+ * not part of xorgproto; clients that want it carry a copy of this file
+ * and must check the extension is present and QueryVersion before use.
+ */
+
+#ifndef _REQSTATSPROTO_H_
+#define _REQSTATSPROTO_H_
+
+#include <X11/Xmd.h>
+
+#define REQSTATS_NAME                   "XORG-REQUEST-STATS"
+#define REQSTATS_MAJOR                  1
+#define REQSTATS_MINOR                  0
+
+#define X_ReqStatsQueryVersion          0
+#define X_ReqStatsQueryRequestStats     1
+
+#define ReqStatsFlagEnable              (1 << 0)
+#define ReqStatsFlagDisable             (1 << 1)
+#define ReqStatsFlagReset               (1 << 2)
+
+typedef struct {
+    CARD8   reqType;
+    CARD8   reqStatsReqType;
+    CARD16  length;
+    CARD32  majorVersion;
+    CARD32  minorVersion;
+} xReqStatsQueryVersionReq;
+#define sz_xReqStatsQueryVersionReq 12
+
+typedef struct {
+    CARD8   type;
+    CARD8   pad1;
+    CARD16  sequenceNumber;
+    CARD32  length;
+    CARD32  majorVersion;
+    CARD32  minorVersion;
+    CARD32  pad2;
+    CARD32  pad3;
+    CARD32  pad4;
+    CARD32  pad5;
+} xReqStatsQueryVersionReply;
+#define sz_xReqStatsQueryVersionReply 32
+
+typedef struct {
+    CARD8   reqType;
+    CARD8   reqStatsReqType;
+    CARD16  length;
+    CARD32  client;             /* None for per-opcode statistics */
+    CARD32  flags;              /* applied before the reply is generated */
+} xReqStatsQueryRequestStatsReq;
+#define sz_xReqStatsQueryRequestStatsReq 12
+
+typedef struct {
+    CARD8   type;
+    CARD8   enabled;
+    CARD16  sequenceNumber;
+    CARD32  length;
+    CARD32  numStats;
+    CARD32  numBuckets;
+    CARD32  pad1;
+    CARD32  pad2;
+    CARD32  pad3;
+    CARD32  pad4;
+} xReqStatsQueryRequestStatsReply;
+#define sz_xReqStatsQueryRequestStatsReply 32
+
+/* Follows the reply when a client was given */
+typedef struct {
+    CARD32  requests_hi;
+    CARD32  requests_lo;
+    CARD32  errors_hi;
+    CARD32  errors_lo;
+    CARD32  bytes_in_hi;
+    CARD32  bytes_in_lo;
+    CARD32  bytes_out_hi;
+    CARD32  bytes_out_lo;
+    CARD32  total_us_hi;
+    CARD32  total_us_lo;
+    CARD32  max_us;
+    CARD32  reads;              /* read calls made for the client's input */
+} xReqStatsClientStats;
+#define sz_xReqStatsClientStats 48
+
+/* numStats of these follow the reply, each followed by numBuckets CARD32 */
+typedef struct {
+    CARD8   major;
+    CARD8   pad;
+    CARD16  minor;
+    CARD32  count_hi;
+    CARD32  count_lo;
+    CARD32  errors_hi;
+    CARD32  errors_lo;
+    CARD32  bytes_in_hi;
+    CARD32  bytes_in_lo;
+    CARD32  total_us_hi;
+    CARD32  total_us_lo;
+    CARD32  max_us;
+} xReqStatsOpcodeStats;
+#define sz_xReqStatsOpcodeStats 40
+
+#endif /* _REQSTATSPROTO_H_ */
@@ -2555,6 +2555,7 @@ RecalculateDeviceDeliverableEvents(WindowPtr pWin)
                              & ~inputMasks->dontPropagateMask[i] &
                              PropagateMask[i]);
         }
+        UpdateDeliverySkip(pChild);
         if (pChild->firstChild) {
             pChild = pChild->firstChild;
             continue;
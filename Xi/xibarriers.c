@@ -69,6 +69,8 @@ typedef struct PointerBarrierClient *PointerBarrierClientPtr;
 
 struct PointerBarrierDevice {
     struct xorg_list entry;
+    struct xorg_list hit_entry; /* in the screen's hits while hit */
+    struct PointerBarrierClient *client;
     int deviceid;
     Time last_timestamp;
     int barrier_event_id;
@@ -79,6 +81,7 @@ struct PointerBarrierDevice {
 
 struct PointerBarrierClient {
     XID id;
+    CARD32 serial; /* creation order on the screen */
     ScreenPtr screen;
     Window window;
     struct PointerBarrier barrier;
@@ -91,8 +94,23 @@ struct PointerBarrierClient {
     struct xorg_list per_device;
 };
 
+/*
+ * Barriers are either vertical or horizontal, so a movement can only be
+ * blocked by vertical barriers whose x lies between its start and end x,
+ * and horizontal ones likewise in y.  Each kind is kept sorted by that
+ * coordinate and only the matching range is tested.
+ */
+typedef struct _BarrierIndex {
+    struct PointerBarrierClient **barriers;
+    int num, size;
+} BarrierIndexRec, *BarrierIndexPtr;
+
 typedef struct _BarrierScreen {
     struct xorg_list barriers;
+    BarrierIndexRec vertical;   /* sorted by x1 */
+    BarrierIndexRec horizontal; /* sorted by y1 */
+    struct xorg_list hits;      /* PointerBarrierDevices with hit set */
+    CARD32 serial;
 } BarrierScreenRec, *BarrierScreenPtr;
 
 #define GetBarrierScreen(s) ((BarrierScreenPtr)dixLookupPrivate(&(s)->devPrivates, BarrierScreenPrivateKey))
@@ -112,7 +130,9 @@ static struct PointerBarrierDevice *AllocBarrierDevice(void)
     pbd->release_event_id = 0;
     pbd->hit = FALSE;
     pbd->seen = FALSE;
+    pbd->client = NULL;
     xorg_list_init(&pbd->entry);
+    xorg_list_init(&pbd->hit_entry);
 
     return pbd;
 }
@@ -122,6 +142,7 @@ static void FreePointerBarrierClient(struct PointerBarrierClient *c)
     struct PointerBarrierDevice *pbd = NULL, *tmp = NULL;
 
     xorg_list_for_each_entry_safe(pbd, tmp, &c->per_device, entry) {
+        xorg_list_del(&pbd->hit_entry);
         free(pbd);
     }
     free(c);
@@ -152,6 +173,81 @@ barrier_is_vertical(const struct PointerBarrier *barrier)
     return barrier->x1 == barrier->x2;
 }
 
+static BarrierIndexPtr
+barrier_index(BarrierScreenPtr cs, const struct PointerBarrier *barrier)
+{
+    return barrier_is_vertical(barrier) ? &cs->vertical : &cs->horizontal;
+}
+
+static int
+barrier_index_key(const struct PointerBarrier *barrier)
+{
+    return barrier_is_vertical(barrier) ? barrier->x1 : barrier->y1;
+}
+
+/**
+ * @return The position of the first barrier in the index whose key is
+ * not less than key.
+ */
+static int
+barrier_index_lower_bound(BarrierIndexPtr index, int key)
+{
+    int lo = 0, hi = index->num;
+
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+
+        if (barrier_index_key(&index->barriers[mid]->barrier) < key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static Bool
+barrier_index_insert(BarrierScreenPtr cs, struct PointerBarrierClient *c)
+{
+    BarrierIndexPtr index = barrier_index(cs, &c->barrier);
+    int i;
+
+    if (index->num == index->size) {
+        int size = index->size ? index->size * 2 : 16;
+        struct PointerBarrierClient **barriers;
+
+        barriers = reallocarray(index->barriers, size, sizeof(*barriers));
+        if (!barriers)
+            return FALSE;
+        index->barriers = barriers;
+        index->size = size;
+    }
+
+    i = barrier_index_lower_bound(index, barrier_index_key(&c->barrier));
+    memmove(&index->barriers[i + 1], &index->barriers[i],
+            (index->num - i) * sizeof(*index->barriers));
+    index->barriers[i] = c;
+    index->num++;
+    return TRUE;
+}
+
+static void
+barrier_index_remove(BarrierScreenPtr cs, struct PointerBarrierClient *c)
+{
+    BarrierIndexPtr index = barrier_index(cs, &c->barrier);
+    int i;
+
+    for (i = barrier_index_lower_bound(index, barrier_index_key(&c->barrier));
+         i < index->num; i++) {
+        if (index->barriers[i] == c) {
+            index->num--;
+            memmove(&index->barriers[i], &index->barriers[i + 1],
+                    (index->num - i) * sizeof(*index->barriers));
+            return;
+        }
+    }
+    BUG_WARN_MSG(1, "barrier %x missing from the index\n", (unsigned) c->id);
+}
+
 /**
  * @return The set of barrier movement directions the movement vector
  * x1/y1 → x2/y2 represents.
@@ -323,19 +419,24 @@ barrier_blocks_device(struct PointerBarrierClient *client,
  * @param y2 Y end coordinate of movement vector
  * @return The barrier nearest to the movement origin that blocks this movement.
  */
-static struct PointerBarrierClient *
-barrier_find_nearest(BarrierScreenPtr cs, DeviceIntPtr dev,
-                     int dir,
-                     int x1, int y1, int x2, int y2)
+static void
+barrier_find_nearest_in(BarrierIndexPtr index, int lo, int hi,
+                        DeviceIntPtr dev, int dir,
+                        int x1, int y1, int x2, int y2,
+                        struct PointerBarrierClient **nearest,
+                        double *min_distance)
 {
-    struct PointerBarrierClient *c, *nearest = NULL;
-    double min_distance = INT_MAX;      /* can't get higher than that in X anyway */
+    int i;
 
-    xorg_list_for_each_entry(c, &cs->barriers, entry) {
+    for (i = barrier_index_lower_bound(index, lo); i < index->num; i++) {
+        struct PointerBarrierClient *c = index->barriers[i];
         struct PointerBarrier *b = &c->barrier;
         struct PointerBarrierDevice *pbd;
         double distance;
 
+        if (barrier_index_key(b) > hi)
+            break;
+
         pbd = GetBarrierDevice(c, dev->id);
         if (pbd->seen)
             continue;
@@ -347,12 +448,31 @@ barrier_find_nearest(BarrierScreenPtr cs, DeviceIntPtr dev,
             continue;
 
         if (barrier_is_blocking(b, x1, y1, x2, y2, &distance)) {
-            if (min_distance > distance) {
-                min_distance = distance;
-                nearest = c;
+            /* On a tie, the most recently created barrier wins */
+            if (*min_distance > distance ||
+                (*min_distance == distance && *nearest &&
+                 c->serial > (*nearest)->serial)) {
+                *min_distance = distance;
+                *nearest = c;
             }
         }
     }
+}
+
+static struct PointerBarrierClient *
+barrier_find_nearest(BarrierScreenPtr cs, DeviceIntPtr dev,
+                     int dir,
+                     int x1, int y1, int x2, int y2)
+{
+    struct PointerBarrierClient *nearest = NULL;
+    double min_distance = INT_MAX;      /* can't get higher than that in X anyway */
+
+    barrier_find_nearest_in(&cs->vertical, min(x1, x2), max(x1, x2),
+                            dev, dir, x1, y1, x2, y2,
+                            &nearest, &min_distance);
+    barrier_find_nearest_in(&cs->horizontal, min(y1, y2), max(y1, y2),
+                            dev, dir, x1, y1, x2, y2,
+                            &nearest, &min_distance);
 
     return nearest;
 }
@@ -397,6 +517,7 @@ input_constrain_cursor(DeviceIntPtr dev, ScreenPtr screen,
     int dir;
     struct PointerBarrier *nearest = NULL;
     PointerBarrierClientPtr c;
+    struct PointerBarrierDevice *pbd, *tmp;
     Time ms = GetTimeInMillis();
     BarrierEvent ev = {
         .header = ET_Internal,
@@ -436,7 +557,6 @@ input_constrain_cursor(DeviceIntPtr dev, ScreenPtr screen,
 
     while (dir != 0) {
         int new_sequence;
-        struct PointerBarrierDevice *pbd;
 
         c = barrier_find_nearest(cs, master, dir, current_x, current_y, x, y);
         if (!c)
@@ -448,6 +568,8 @@ input_constrain_cursor(DeviceIntPtr dev, ScreenPtr screen,
         new_sequence = !pbd->hit;
 
         pbd->seen = TRUE;
+        if (!pbd->hit)
+            xorg_list_add(&pbd->hit_entry, &cs->hits);
         pbd->hit = TRUE;
 
         if (pbd->barrier_event_id == pbd->release_event_id)
@@ -480,19 +602,21 @@ input_constrain_cursor(DeviceIntPtr dev, ScreenPtr screen,
         *nevents += 1;
     }
 
-    xorg_list_for_each_entry(c, &cs->barriers, entry) {
-        struct PointerBarrierDevice *pbd;
+    /* Only barriers that are hit can have been seen or be left */
+    xorg_list_for_each_entry_safe(pbd, tmp, &cs->hits, hit_entry) {
         int flags = 0;
 
-        pbd = GetBarrierDevice(c, master->id);
-        pbd->seen = FALSE;
-        if (!pbd->hit)
+        if (pbd->deviceid != master->id)
             continue;
 
+        c = pbd->client;
+        pbd->seen = FALSE;
+
         if (barrier_inside_hit_box(&c->barrier, x, y))
             continue;
 
         pbd->hit = FALSE;
+        xorg_list_del(&pbd->hit_entry);
 
         ev.type = ET_BarrierLeave;
 
@@ -610,6 +734,7 @@ CreatePointerBarrierClient(ClientPtr client,
             goto error;
         }
         pbd->deviceid = dev->id;
+        pbd->client = ret;
 
         xorg_list_add(&pbd->entry, &ret->per_device);
     }
@@ -626,6 +751,11 @@ CreatePointerBarrierClient(ClientPtr client,
         ret->barrier.directions &= ~(BarrierPositiveX | BarrierNegativeX);
     if (barrier_is_vertical(&ret->barrier))
         ret->barrier.directions &= ~(BarrierPositiveY | BarrierNegativeY);
+    if (!barrier_index_insert(cs, ret)) {
+        err = BadAlloc;
+        goto error;
+    }
+    ret->serial = ++cs->serial;
     xorg_list_add(&ret->entry, &cs->barriers);
 
     *client_out = ret;
@@ -689,6 +819,7 @@ BarrierFreeBarrier(void *data, XID id)
         mieqEnqueue(dev, (InternalEvent *) &ev);
     }
 
+    barrier_index_remove(GetBarrierScreen(screen), c);
     xorg_list_del(&c->entry);
 
     FreePointerBarrierClient(c);
@@ -708,6 +839,7 @@ static void add_master_func(void *res, XID id, void *devid)
 
     pbd = AllocBarrierDevice();
     pbd->deviceid = *deviceid;
+    pbd->client = barrier;
 
     xorg_list_add(&pbd->entry, &barrier->per_device);
 }
@@ -753,6 +885,7 @@ static void remove_master_func(void *res, XID id, void *devid)
     }
 
     xorg_list_del(&pbd->entry);
+    xorg_list_del(&pbd->hit_entry);
     free(pbd);
 }
 
@@ -917,6 +1050,7 @@ XIBarrierInit(void)
         if (!cs)
             return FALSE;
         xorg_list_init(&cs->barriers);
+        xorg_list_init(&cs->hits);
         SetBarrierScreen(pScreen, cs);
     }
 
@@ -933,6 +1067,8 @@ XIBarrierReset(void)
     for (i = 0; i < screenInfo.numScreens; i++) {
         ScreenPtr pScreen = screenInfo.screens[i];
         BarrierScreenPtr cs = GetBarrierScreen(pScreen);
+        free(cs->vertical.barriers);
+        free(cs->horizontal.barriers);
         free(cs);
         SetBarrierScreen(pScreen, NULL);
     }
@@ -129,6 +129,7 @@ int ProcInitialConnection();
 #include "xkbsrv.h"
 #include "site.h"
 #include "client.h"
+#include "reqstats.h"
 
 #ifdef XSERVER_DTRACE
 #include "registry.h"
@@ -229,6 +230,7 @@ long SmartScheduleSlice = SMART_SCHEDULE_DEFAULT_INTERVAL;
 long SmartScheduleInterval = SMART_SCHEDULE_DEFAULT_INTERVAL;
 long SmartScheduleMaxSlice = SMART_SCHEDULE_MAX_SLICE;
 long SmartScheduleTime;
+Bool SmartScheduleChargeTime = FALSE;
 int SmartScheduleLatencyLimited = 0;
 static ClientPtr SmartLastClient;
 static int SmartLastIndex[SMART_MAX_PRIORITY - SMART_MIN_PRIORITY + 1];
@@ -306,6 +308,23 @@ mark_client_ungrab(void)
     }
 }
 
+/*
+ * With -schedChargeTime, penalize a client which consumed ticks once for
+ * every slice used, so that a client whose requests take several slices
+ * to execute (huge PutImage, Render composites) waits for the cheaper
+ * ones to be served.
+ */
+void
+SmartSchedulePenalize(ClientPtr client, long ticks)
+{
+    long slices = ticks / SmartScheduleSlice;
+
+    if (slices > client->smart_priority - SMART_MIN_PRIORITY)
+        client->smart_priority = SMART_MIN_PRIORITY;
+    else
+        client->smart_priority -= slices;
+}
+
 static ClientPtr
 SmartScheduleClient(void)
 {
@@ -405,6 +424,8 @@ Dispatch(void)
     int result;
     ClientPtr client;
     long start_tick;
+    int req_len;
+    CARD64 req_start;
 
     nextFreeClientID = 1;
     nClients = 0;
@@ -440,7 +461,10 @@ Dispatch(void)
                 if ((SmartScheduleTime - start_tick) >= SmartScheduleSlice)
                 {
                     /* Penalize clients which consume ticks */
-                    if (client->smart_priority > SMART_MIN_PRIORITY)
+                    if (SmartScheduleChargeTime)
+                        SmartSchedulePenalize(client,
+                                              SmartScheduleTime - start_tick);
+                    else if (client->smart_priority > SMART_MIN_PRIORITY)
                         client->smart_priority--;
                     break;
                 }
@@ -453,6 +477,9 @@ Dispatch(void)
                     break;
                 }
 
+                req_len = result;
+                req_start = reqStatsEnabled ? GetTimeInMicros() : 0;
+
                 client->sequence++;
                 client->majorOp = ((xReq *) client->requestBuffer)->reqType;
                 client->minorOp = 0;
@@ -478,6 +505,10 @@ Dispatch(void)
                         result =
                             (*client->requestVector[client->majorOp]) (client);
                 }
+                if (req_start)
+                    ReqStatsRecord(client, req_len,
+                                   GetTimeInMicros() - req_start, result);
+
                 if (!SmartScheduleSignalEnable)
                     SmartScheduleTime = GetTimeInMillis();
 
@@ -2066,6 +2097,55 @@ ProcPutImage(ClientPtr client)
     return Success;
 }
 
+/*
+ * The chunk buffers of one GetImage reply.  Once the output code is done
+ * with a chunk, its buffer is kept for the next one, so a client that keeps
+ * up is served from two buffers however many chunks the image takes.
+ */
+typedef struct {
+    int refcnt;                 /* DoGetImage and each queued chunk */
+    Bool open;                  /* DoGetImage still wants buffers */
+    char *spare;
+} ImageBufferPoolRec, *ImageBufferPoolPtr;
+
+static void
+ImageBufferDone(void *buf, void *closure)
+{
+    ImageBufferPoolPtr pool = closure;
+
+    if (pool->open && !pool->spare)
+        pool->spare = buf;
+    else
+        free(buf);
+    if (--pool->refcnt == 0)
+        free(pool);
+}
+
+/*
+ * Send a chunk of image data.  The buffer is handed over to the output code,
+ * which saves copying it if the client can't keep up, whenever there is
+ * another one for the next chunk.  New buffers are zeroed, as GetImage may
+ * leave the padding alone; reused ones only hold earlier chunks of the same
+ * reply.
+ */
+static char *
+WriteImageToClient(ClientPtr client, int count, char *pBuf, long size,
+                   ImageBufferPoolPtr pool)
+{
+    char *pNext = pool->spare;
+
+    pool->spare = NULL;
+    if (!pNext)
+        pNext = calloc(1, size);
+    if (!pNext) {
+        WriteToClient(client, count, pBuf);
+        return pBuf;
+    }
+    pool->refcnt++;
+    WriteBufferToClient(client, count, pBuf, ImageBufferDone, pool);
+    return pNext;
+}
+
 static int
 DoGetImage(ClientPtr client, int format, Drawable drawable,
            int x, int y, int width, int height,
@@ -2080,6 +2160,7 @@ DoGetImage(ClientPtr client, int format, Drawable drawable,
     long widthBytesLine, length;
     Mask plane = 0;
     char *pBuf;
+    ImageBufferPoolPtr pool;
     xGetImageReply xgi;
     RegionPtr pVisibleRegion = NULL;
 
@@ -2194,6 +2275,12 @@ DoGetImage(ClientPtr client, int format, Drawable drawable,
     }
     if (!(pBuf = calloc(1, length)))
         return BadAlloc;
+    if (!(pool = calloc(1, sizeof(ImageBufferPoolRec)))) {
+        free(pBuf);
+        return BadAlloc;
+    }
+    pool->refcnt = 1;
+    pool->open = TRUE;
     WriteReplyToClient(client, sizeof(xGetImageReply), &xgi);
 
     if (pDraw->type == DRAWABLE_WINDOW)
@@ -2222,7 +2309,8 @@ DoGetImage(ClientPtr client, int format, Drawable drawable,
             ReformatImage(pBuf, (int) (nlines * widthBytesLine),
                           BitsPerPixel(pDraw->depth), ClientOrder(client));
 
-            WriteToClient(client, (int) (nlines * widthBytesLine), pBuf);
+            pBuf = WriteImageToClient(client, (int) (nlines * widthBytesLine),
+                                      pBuf, length, pool);
             linesDone += nlines;
         }
     }
@@ -2250,13 +2338,20 @@ DoGetImage(ClientPtr client, int format, Drawable drawable,
                     ReformatImage(pBuf, (int) (nlines * widthBytesLine),
                                   1, ClientOrder(client));
 
-                    WriteToClient(client, (int)(nlines * widthBytesLine), pBuf);
+                    pBuf = WriteImageToClient(client,
+                                              (int) (nlines * widthBytesLine),
+                                              pBuf, length, pool);
                     linesDone += nlines;
                 }
             }
         }
     }
     free(pBuf);
+    free(pool->spare);
+    pool->spare = NULL;
+    pool->open = FALSE;
+    if (--pool->refcnt == 0)
+        free(pool);
     return Success;
 }
 
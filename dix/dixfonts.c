@@ -774,8 +774,7 @@ doListFontsAndAliases(ClientPtr client, LFclosurePtr c)
     reply.length = bytes_to_int32(stringLens + nnames);
     client->pSwapReplyFunc = ReplySwapVector[X_ListFonts];
     WriteSwappedDataToClient(client, sizeof(xListFontsReply), &reply);
-    WriteToClient(client, stringLens + nnames, bufferStart);
-    free(bufferStart);
+    WriteBufferToClient(client, stringLens + nnames, bufferStart, NULL, NULL);
 
  bail:
     ClientWakeup(client);
@@ -2718,6 +2718,15 @@ DeliverDeviceEvents(WindowPtr pWin, InternalEvent *event, GrabPtr grab,
     verify_internal_event(event);
 
     while (pWin) {
+        WindowPtr skip = pWin->deliverySkip;
+
+        /* Nothing on the way up to skip selects device events */
+        if (skip && !(stopAt && stopAt->deliverySkip == skip)) {
+            child = skip->drawable.id;
+            pWin = skip->parent;
+            continue;
+        }
+
         if ((mask = EventIsDeliverable(dev, event->any.type, pWin))) {
             /* XI2 events first */
             if (mask & EVENT_XI2_MASK) {
@@ -3918,10 +3927,11 @@ CheckPassiveGrabsOnWindow(WindowPtr pWin,
                           DeviceIntPtr device,
                           InternalEvent *event, BOOL checkCore, BOOL activate)
 {
-    GrabPtr grab = wPassiveGrabs(pWin);
+    GrabPtr grab;
     GrabPtr tempGrab;
+    PassiveGrabIterRec iter;
 
-    if (!grab)
+    if (!wPassiveGrabs(pWin))
         return NULL;
 
     tempGrab = AllocGrab(NULL);
@@ -3951,7 +3961,8 @@ CheckPassiveGrabsOnWindow(WindowPtr pWin,
     tempGrab->modifiersDetail.pMask = NULL;
     tempGrab->next = NULL;
 
-    for (; grab; grab = grab->next) {
+    for (grab = FirstPassiveGrab(pWin, tempGrab->detail.exact, &iter);
+         grab; grab = NextPassiveGrab(&iter)) {
         if (!CheckPassiveGrab(device, grab, event, checkCore, tempGrab))
             continue;
 
@@ -4328,6 +4339,32 @@ FixKeyState(DeviceEvent *event, DeviceIntPtr keybd)
 #define ManagerMask \
 	(SubstructureRedirectMask | ResizeRedirectMask)
 
+/**
+ * Deep toolkit trees are mostly made of windows that no client selects
+ * device events on.  For such a window, deliverySkip is the topmost
+ * window of the unbroken run of them that starts at the window and goes
+ * up the tree, so DeliverDeviceEvents can step over the whole run at once.
+ * It is NULL for windows that select core, XI or XI2 device events or
+ * stop their propagation, and for windows that were never updated.
+ *
+ * Must be called on a window after its parent, whenever its masks, its
+ * parent or its parent's deliverySkip change.
+ */
+void
+UpdateDeliverySkip(WindowPtr pWin)
+{
+    WindowPtr pParent = pWin->parent;
+
+    if (((pWin->eventMask | wOtherEventMasks(pWin) |
+          wDontPropagateMask(pWin)) & PropagateMask) ||
+        wOtherInputMasks(pWin))
+        pWin->deliverySkip = NullWindow;
+    else if (pParent && pParent->deliverySkip)
+        pWin->deliverySkip = pParent->deliverySkip;
+    else
+        pWin->deliverySkip = pWin;
+}
+
 /**
  * Recalculate which events may be deliverable for the given window.
  * Recalculated mask is used for quicker determination which events may be
@@ -4360,6 +4397,7 @@ RecalculateDeliverableEvents(WindowPtr pWin)
             pChild->deliverableEvents |=
                 (pChild->parent->deliverableEvents &
                  ~wDontPropagateMask(pChild) & PropagateMask);
+        UpdateDeliverySkip(pChild);
         if (pChild->firstChild) {
             pChild = pChild->firstChild;
             continue;
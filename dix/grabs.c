@@ -188,6 +188,210 @@ UngrabAllDevices(Bool kill_client)
     ErrorF("End list of ungrabbed devices\n");
 }
 
+/*
+ * Windows with many passive grabs, the root window of a desktop with
+ * hotkeys in particular, get an index from key or button to their grabs
+ * once a lookup had to walk more than GRAB_INDEX_MIN of them.  A grab with
+ * a pMask-free detail d can only match another grab or event for d, or
+ * one that has AnyKey (which is 0, like AnyButton, XIAnyKeycode and
+ * XIAnyButton) as its detail, so a lookup for d only has to walk those
+ * two buckets.  The list stays authoritative: the first match in list
+ * order wins, so the buckets keep the order of the list and are merged
+ * by position when walked.
+ */
+
+#define GRAB_INDEX_MIN          32
+#define GRAB_INDEX_DETAILS      256
+
+typedef struct {
+    GrabPtr grab;
+    unsigned long serial;       /* larger is nearer the head of the list */
+} GrabIndexEntry;
+
+typedef struct _GrabIndexBucket {
+    GrabIndexEntry *entries;    /* oldest first */
+    int num, size;
+} GrabIndexBucketRec;
+
+typedef struct _GrabIndex {
+    unsigned long serial;
+    GrabIndexBucketRec buckets[GRAB_INDEX_DETAILS];
+} GrabIndexRec;
+
+void
+GrabIndexFree(WindowPtr pWin)
+{
+    GrabIndexPtr idx = pWin->optional ? pWin->optional->grabIndex : NULL;
+    int i;
+
+    if (!idx)
+        return;
+    for (i = 0; i < GRAB_INDEX_DETAILS; i++)
+        free(idx->buckets[i].entries);
+    free(idx);
+    pWin->optional->grabIndex = NULL;
+}
+
+static Bool
+GrabIndexAppend(GrabIndexPtr idx, GrabPtr grab)
+{
+    GrabIndexBucketRec *bucket = &idx->buckets[grab->detail.exact];
+
+    if (bucket->num == bucket->size) {
+        int size = bucket->size ? bucket->size * 2 : 4;
+        GrabIndexEntry *entries;
+
+        entries = reallocarray(bucket->entries, size, sizeof(*entries));
+        if (!entries)
+            return FALSE;
+        bucket->entries = entries;
+        bucket->size = size;
+    }
+    bucket->entries[bucket->num].grab = grab;
+    bucket->entries[bucket->num].serial = ++idx->serial;
+    bucket->num++;
+    return TRUE;
+}
+
+/* (Re)build the index of pWin, leaving none if that fails */
+static void
+GrabIndexBuild(WindowPtr pWin)
+{
+    GrabIndexPtr idx;
+    GrabPtr grab, *grabs;
+    int i, count = 0;
+
+    GrabIndexFree(pWin);
+
+    for (grab = pWin->optional->passiveGrabs; grab; grab = grab->next) {
+        if (grab->detail.exact >= GRAB_INDEX_DETAILS)
+            return;
+        count++;
+    }
+
+    idx = calloc(1, sizeof(GrabIndexRec));
+    grabs = xallocarray(count, sizeof(GrabPtr));
+    if (!idx || !grabs) {
+        free(grabs);
+        free(idx);
+        return;
+    }
+    pWin->optional->grabIndex = idx;
+
+    i = count;
+    for (grab = pWin->optional->passiveGrabs; grab; grab = grab->next)
+        grabs[--i] = grab;
+    for (i = 0; i < count; i++) {
+        if (!GrabIndexAppend(idx, grabs[i])) {
+            GrabIndexFree(pWin);
+            break;
+        }
+    }
+    free(grabs);
+}
+
+/* grab has just been put at the head of the list */
+static void
+GrabIndexAdd(WindowPtr pWin, GrabPtr grab)
+{
+    GrabIndexPtr idx = pWin->optional->grabIndex;
+
+    if (!idx)
+        return;
+    if (grab->detail.exact >= GRAB_INDEX_DETAILS ||
+        !GrabIndexAppend(idx, grab))
+        GrabIndexFree(pWin);
+}
+
+/* grab has just been taken off the list */
+static void
+GrabIndexRemove(WindowPtr pWin, GrabPtr grab)
+{
+    GrabIndexPtr idx = pWin->optional ? pWin->optional->grabIndex : NULL;
+    GrabIndexBucketRec *bucket;
+    int i;
+
+    if (!idx)
+        return;
+    bucket = &idx->buckets[grab->detail.exact];
+    for (i = bucket->num - 1; i >= 0; i--) {
+        if (bucket->entries[i].grab == grab) {
+            bucket->num--;
+            memmove(&bucket->entries[i], &bucket->entries[i + 1],
+                    (bucket->num - i) * sizeof(*bucket->entries));
+            return;
+        }
+    }
+}
+
+/**
+ * Start walking the passive grabs on pWin, in list order, that may match a
+ * grab or event with the given detail, which must not have a pMask.
+ * Other grabs may be left out.  The list must not change during the walk.
+ *
+ * @return The first grab, or NULL.
+ */
+GrabPtr
+FirstPassiveGrab(WindowPtr pWin, unsigned int detail, PassiveGrabIterPtr iter)
+{
+    GrabPtr grab = wPassiveGrabs(pWin);
+    int walked;
+
+    iter->next = grab;
+    iter->exact = iter->any = NULL;
+    if (!grab || detail == 0)
+        return NextPassiveGrab(iter);
+
+    if (!pWin->optional->grabIndex) {
+        for (walked = 0; grab && walked <= GRAB_INDEX_MIN; grab = grab->next)
+            walked++;
+        if (walked > GRAB_INDEX_MIN)
+            GrabIndexBuild(pWin);
+    }
+
+    if (pWin->optional->grabIndex) {
+        GrabIndexPtr idx = pWin->optional->grabIndex;
+
+        iter->next = NULL;
+        iter->any = &idx->buckets[0];
+        iter->any_pos = iter->any->num;
+        if (detail < GRAB_INDEX_DETAILS) {
+            iter->exact = &idx->buckets[detail];
+            iter->exact_pos = iter->exact->num;
+        }
+    }
+    return NextPassiveGrab(iter);
+}
+
+GrabPtr
+NextPassiveGrab(PassiveGrabIterPtr iter)
+{
+    GrabIndexEntry *exact = NULL, *any = NULL;
+    GrabPtr grab;
+
+    if (!iter->exact && !iter->any) {
+        grab = iter->next;
+        if (grab)
+            iter->next = grab->next;
+        return grab;
+    }
+
+    if (iter->exact && iter->exact_pos > 0)
+        exact = &iter->exact->entries[iter->exact_pos - 1];
+    if (iter->any_pos > 0)
+        any = &iter->any->entries[iter->any_pos - 1];
+
+    if (exact && (!any || exact->serial > any->serial)) {
+        iter->exact_pos--;
+        return exact->grab;
+    }
+    if (any) {
+        iter->any_pos--;
+        return any->grab;
+    }
+    return NULL;
+}
+
 GrabPtr
 AllocGrab(const GrabPtr src)
 {
@@ -325,10 +529,13 @@ DeletePassiveGrab(void *value, XID id)
     prev = 0;
     for (g = (wPassiveGrabs(pGrab->window)); g; g = g->next) {
         if (pGrab == g) {
+            GrabIndexRemove(pGrab->window, g);
             if (prev)
                 prev->next = g->next;
-            else if (!(pGrab->window->optional->passiveGrabs = g->next))
+            else if (!(pGrab->window->optional->passiveGrabs = g->next)) {
+                GrabIndexFree(pGrab->window);
                 CheckWindowOptionalNeed(pGrab->window);
+            }
             break;
         }
         prev = g;
@@ -529,10 +736,12 @@ int
 AddPassiveGrabToList(ClientPtr client, GrabPtr pGrab)
 {
     GrabPtr grab;
+    PassiveGrabIterRec iter;
     Mask access_mode = DixGrabAccess;
     int rc;
 
-    for (grab = wPassiveGrabs(pGrab->window); grab; grab = grab->next) {
+    for (grab = FirstPassiveGrab(pGrab->window, pGrab->detail.exact, &iter);
+         grab; grab = NextPassiveGrab(&iter)) {
         if (GrabMatchesSecond(pGrab, grab, (pGrab->grabtype == CORE))) {
             if (CLIENT_BITS(pGrab->resource) != CLIENT_BITS(grab->resource)) {
                 FreeGrab(pGrab);
@@ -549,7 +758,8 @@ AddPassiveGrabToList(ClientPtr client, GrabPtr pGrab)
         return rc;
 
     /* Remove all grabs that match the new one exactly */
-    for (grab = wPassiveGrabs(pGrab->window); grab; grab = grab->next) {
+    for (grab = FirstPassiveGrab(pGrab->window, pGrab->detail.exact, &iter);
+         grab; grab = NextPassiveGrab(&iter)) {
         if (GrabsAreIdentical(pGrab, grab)) {
             DeletePassiveGrabFromList(grab);
             break;
@@ -563,6 +773,7 @@ AddPassiveGrabToList(ClientPtr client, GrabPtr pGrab)
 
     pGrab->next = pGrab->window->optional->passiveGrabs;
     pGrab->window->optional->passiveGrabs = pGrab;
+    GrabIndexAdd(pGrab->window, pGrab);
     if (AddResource(pGrab->resource, RT_PASSIVEGRAB, (void *) pGrab))
         return Success;
     return BadAlloc;
@@ -688,6 +899,7 @@ DeletePassiveGrabFromList(GrabPtr pMinuendGrab)
             grab = adds[i];
             grab->next = grab->window->optional->passiveGrabs;
             grab->window->optional->passiveGrabs = grab;
+            GrabIndexAdd(grab->window, grab);
         }
         for (i = 0; i < nups; i++) {
             free(*updates[i]);
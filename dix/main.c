@@ -107,6 +107,8 @@ Equipment Corporation.
 #include "registry.h"
 #include "client.h"
 #include "exevents.h"
+#include "reqstats.h"
+#include "xkbsrv.h"
 #ifdef PANORAMIX
 #include "panoramiXsrv.h"
 #else
@@ -122,6 +124,22 @@ extern void Dispatch(void);
 
 CallbackListPtr RootWindowFinalizeCallback = NULL;
 
+/*
+ * With -verbose, log how long each step of startup took, and how long it
+ * was until the server was ready for clients.
+ */
+static CARD64 startupBegin, startupPhase;
+
+static void
+StartupPhase(const char *name)
+{
+    CARD64 now = GetTimeInMicros();
+
+    LogMessageVerb(X_INFO, 1, "Startup: %-20s %8.2f ms\n", name,
+                   (now - startupPhase) / 1000.0);
+    startupPhase = now;
+}
+
 int
 dix_main(int argc, char *argv[], char *envp[])
 {
@@ -130,6 +148,8 @@ dix_main(int argc, char *argv[], char *envp[])
 
     display = "0";
 
+    startupBegin = startupPhase = GetTimeInMicros();
+
     InitRegions();
 
     CheckUserParameters(argc, argv, envp);
@@ -140,10 +160,14 @@ dix_main(int argc, char *argv[], char *envp[])
 
     ProcessCommandLine(argc, argv);
 
+    StartupPhase("command line");
+
     alwaysCheckForInput[0] = 0;
     alwaysCheckForInput[1] = 1;
     while (1) {
         serverGeneration++;
+        if (serverGeneration > 1)
+            startupBegin = startupPhase = GetTimeInMicros();
         ScreenSaverTime = defaultScreenSaverTime;
         ScreenSaverInterval = defaultScreenSaverInterval;
         ScreenSaverBlanking = defaultScreenSaverBlanking;
@@ -164,6 +188,11 @@ dix_main(int argc, char *argv[], char *envp[])
         else
             ResetWellKnownSockets();
         clients[0] = serverClient;
+
+        /* InitInput will want the default keymap, start compiling it now */
+        XkbPrecompileKeymap();
+
+        StartupPhase("os");
         currentMaxClients = 1;
 
         /* clear any existing selections */
@@ -186,15 +215,20 @@ dix_main(int argc, char *argv[], char *envp[])
 
         InitAtoms();
         InitEvents();
+        ReqStatsInit();
         xfont2_init_glyph_caching();
         dixResetRegistry();
         InitFonts();
         InitCallbackManager();
+        StartupPhase("dix");
+
         InitOutput(&screenInfo, argc, argv);
+        StartupPhase("output");
 
         if (screenInfo.numScreens < 1)
             FatalError("no screens found");
         InitExtensions(argc, argv);
+        StartupPhase("extensions");
 
         for (i = 0; i < screenInfo.numGPUScreens; i++) {
             ScreenPtr pScreen = screenInfo.gpuscreens[i];
@@ -221,6 +255,7 @@ dix_main(int argc, char *argv[], char *envp[])
                 FatalError("failed to create root window");
             CallCallbacks(&RootWindowFinalizeCallback, pScreen);
         }
+        StartupPhase("screen resources");
 
         if (SetDefaultFontPath(defaultFontPath) != Success) {
             ErrorF("[dix] failed to set default font path '%s'",
@@ -234,6 +269,7 @@ dix_main(int argc, char *argv[], char *envp[])
             FatalError("could not open default cursor font '%s'",
                        defaultCursorFont);
         }
+        StartupPhase("fonts");
 
 #ifdef PANORAMIX
         /*
@@ -250,6 +286,7 @@ dix_main(int argc, char *argv[], char *envp[])
         InitInput(argc, argv);
         InitAndStartDevices();
         ReserveClientIds(serverClient);
+        StartupPhase("input");
 
         dixSaveScreens(serverClient, SCREEN_SAVER_FORCER, ScreenSaverReset);
 
@@ -273,6 +310,10 @@ dix_main(int argc, char *argv[], char *envp[])
 
         InputThreadInit();
 
+        StartupPhase("connection setup");
+        LogMessageVerb(X_INFO, 1, "Startup: ready for clients after %.2f ms\n",
+                       (GetTimeInMicros() - startupBegin) / 1000.0);
+
         Dispatch();
 
         UndisplayDevices();
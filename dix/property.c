@@ -86,6 +86,187 @@ PrintPropertys(WindowPtr pWin)
 }
 #endif
 
+/*
+ * Windows with many properties, the root window in particular, get a hash
+ * index from atom to property once a lookup had to walk more than
+ * PROPERTY_INDEX_MIN of them.  The list stays authoritative: it keeps the
+ * order ListProperties reports, and a security module may put several
+ * properties with the same name on it, of which the index holds the first.
+ */
+
+#define PROPERTY_INDEX_MIN      16
+#define PROPERTY_INDEX_BITS     5
+
+typedef struct _PropertyIndex {
+    int count;                  /* occupied slots */
+    int bits;                   /* log(2)(slots) */
+    PropertyPtr slots[];
+} PropertyIndexRec, *PropertyIndexPtr;
+
+static inline int
+PropertyHash(Atom name, int bits)
+{
+    return (CARD32) ((CARD32) name * 2654435761U) >> (32 - bits);
+}
+
+/* The slot holding name, or the empty slot it would go into */
+static PropertyPtr *
+PropertyIndexSlot(PropertyIndexPtr idx, Atom name)
+{
+    int mask = (1 << idx->bits) - 1;
+    int pos = PropertyHash(name, idx->bits);
+
+    while (idx->slots[pos] && idx->slots[pos]->propertyName != name)
+        pos = (pos + 1) & mask;
+
+    return &idx->slots[pos];
+}
+
+/* (Re)build the index of pWin, leaving none if that fails */
+static void
+PropertyIndexBuild(WindowPtr pWin)
+{
+    PropertyIndexPtr idx;
+    PropertyPtr pProp, *slot;
+    int bits = PROPERTY_INDEX_BITS;
+    int count = 0;
+
+    free(pWin->optional->propIndex);
+    pWin->optional->propIndex = NULL;
+
+    for (pProp = pWin->optional->userProps; pProp; pProp = pProp->next)
+        count++;
+    while ((1 << bits) < 2 * count)
+        bits++;
+
+    idx = calloc(1, sizeof(PropertyIndexRec) + (sizeof(PropertyPtr) << bits));
+    if (!idx)
+        return;
+    idx->bits = bits;
+
+    for (pProp = pWin->optional->userProps; pProp; pProp = pProp->next) {
+        slot = PropertyIndexSlot(idx, pProp->propertyName);
+        if (!*slot) {
+            *slot = pProp;
+            idx->count++;
+        }
+    }
+    pWin->optional->propIndex = idx;
+}
+
+/* pProp has just been put at the head of the list */
+static void
+PropertyIndexAdd(WindowPtr pWin, PropertyPtr pProp)
+{
+    PropertyIndexPtr idx = pWin->optional->propIndex;
+    PropertyPtr *slot;
+
+    if (!idx)
+        return;
+
+    slot = PropertyIndexSlot(idx, pProp->propertyName);
+    if (!*slot) {
+        if (2 * (idx->count + 1) > (1 << idx->bits)) {
+            PropertyIndexBuild(pWin);
+            return;
+        }
+        idx->count++;
+    }
+    *slot = pProp;
+}
+
+/* pProp has just been taken off the list, its next pointer is still valid */
+static void
+PropertyIndexRemove(WindowPtr pWin, PropertyPtr pProp)
+{
+    PropertyIndexPtr idx = pWin->optional->propIndex;
+    PropertyPtr *slot, dup;
+    int mask, i, j, home;
+
+    if (!idx)
+        return;
+
+    slot = PropertyIndexSlot(idx, pProp->propertyName);
+    if (*slot != pProp)
+        return;
+
+    for (dup = pProp->next; dup; dup = dup->next) {
+        if (dup->propertyName == pProp->propertyName) {
+            *slot = dup;
+            return;
+        }
+    }
+
+    /* Move later entries of the cluster into the hole where they may go */
+    mask = (1 << idx->bits) - 1;
+    i = j = slot - idx->slots;
+    for (;;) {
+        j = (j + 1) & mask;
+        if (!idx->slots[j])
+            break;
+        home = PropertyHash(idx->slots[j]->propertyName, idx->bits);
+        if (((j - home) & mask) < ((j - i) & mask))
+            continue;
+        idx->slots[i] = idx->slots[j];
+        i = j;
+    }
+    idx->slots[i] = NULL;
+    idx->count--;
+
+    if (idx->count < PROPERTY_INDEX_MIN / 2) {
+        free(idx);
+        pWin->optional->propIndex = NULL;
+    }
+    else if (idx->bits > PROPERTY_INDEX_BITS && 8 * idx->count < mask)
+        PropertyIndexBuild(pWin);
+}
+
+static PropertyPtr
+FindProperty(WindowPtr pWin, Atom propertyName)
+{
+    PropertyPtr pProp;
+    int walked = 0;
+
+    if (!pWin->optional)
+        return NULL;
+
+    if (pWin->optional->propIndex)
+        return *PropertyIndexSlot(pWin->optional->propIndex, propertyName);
+
+    for (pProp = pWin->optional->userProps; pProp; pProp = pProp->next) {
+        if (pProp->propertyName == propertyName)
+            break;
+        walked++;
+    }
+
+    if (walked > PROPERTY_INDEX_MIN)
+        PropertyIndexBuild(pWin);
+
+    return pProp;
+}
+
+static void
+RemoveProperty(WindowPtr pWin, PropertyPtr pProp)
+{
+    PropertyPtr prevProp;
+
+    if (pWin->optional->userProps == pProp) {
+        /* Takes care of head */
+        pWin->optional->userProps = pProp->next;
+    }
+    else {
+        /* Need to traverse to find the previous element */
+        prevProp = pWin->optional->userProps;
+        while (prevProp->next != pProp)
+            prevProp = prevProp->next;
+        prevProp->next = pProp->next;
+    }
+
+    PropertyIndexRemove(pWin, pProp);
+    if (!pWin->optional->userProps)
+        CheckWindowOptionalNeed(pWin);
+}
+
 int
 dixLookupProperty(PropertyPtr *result, WindowPtr pWin, Atom propertyName,
                   ClientPtr client, Mask access_mode)
@@ -95,9 +276,7 @@ dixLookupProperty(PropertyPtr *result, WindowPtr pWin, Atom propertyName,
 
     client->errorValue = propertyName;
 
-    for (pProp = wUserProps(pWin); pProp; pProp = pProp->next)
-        if (pProp->propertyName == propertyName)
-            break;
+    pProp = FindProperty(pWin, propertyName);
 
     if (pProp)
         rc = XaceHookPropertyAccess(client, pWin, &pProp, access_mode);
@@ -295,6 +474,7 @@ dixChangeWindowProperty(ClientPtr pClient, WindowPtr pWin, Atom property,
         }
         pProp->next = pWin->optional->userProps;
         pWin->optional->userProps = pProp;
+        PropertyIndexAdd(pWin, pProp);
     }
     else if (rc == Success) {
         /* To append or prepend to a property the request format and type
@@ -368,7 +548,7 @@ dixChangeWindowProperty(ClientPtr pClient, WindowPtr pWin, Atom property,
 int
 DeleteProperty(ClientPtr client, WindowPtr pWin, Atom propName)
 {
-    PropertyPtr pProp, prevProp;
+    PropertyPtr pProp;
     int rc;
 
     rc = dixLookupProperty(&pProp, pWin, propName, client, DixDestroyAccess);
@@ -376,19 +556,7 @@ DeleteProperty(ClientPtr client, WindowPtr pWin, Atom propName)
         return Success;         /* Succeed if property does not exist */
 
     if (rc == Success) {
-        if (pWin->optional->userProps == pProp) {
-            /* Takes care of head */
-            if (!(pWin->optional->userProps = pProp->next))
-                CheckWindowOptionalNeed(pWin);
-        }
-        else {
-            /* Need to traverse to find the previous element */
-            prevProp = pWin->optional->userProps;
-            while (prevProp->next != pProp)
-                prevProp = prevProp->next;
-            prevProp->next = pProp->next;
-        }
-
+        RemoveProperty(pWin, pProp);
         deliverPropertyNotifyEvent(pWin, PropertyDelete, pProp);
         free(pProp->data);
         dixFreeObjectWithPrivates(pProp, PRIVATE_PROPERTY);
@@ -410,8 +578,11 @@ DeleteAllWindowProperties(WindowPtr pWin)
         pProp = pNextProp;
     }
 
-    if (pWin->optional)
+    if (pWin->optional) {
         pWin->optional->userProps = NULL;
+        free(pWin->optional->propIndex);
+        pWin->optional->propIndex = NULL;
+    }
 }
 
 static int
@@ -443,7 +614,7 @@ NullPropertyReply(ClientPtr client, ATOM propertyType, int format)
 int
 ProcGetProperty(ClientPtr client)
 {
-    PropertyPtr pProp, prevProp;
+    PropertyPtr pProp;
     unsigned long n, len, ind;
     int rc;
     WindowPtr pWin;
@@ -546,19 +717,7 @@ ProcGetProperty(ClientPtr client)
 
     if (stuff->delete && (reply.bytesAfter == 0)) {
         /* Delete the Property */
-        if (pWin->optional->userProps == pProp) {
-            /* Takes care of head */
-            if (!(pWin->optional->userProps = pProp->next))
-                CheckWindowOptionalNeed(pWin);
-        }
-        else {
-            /* Need to traverse to find the previous element */
-            prevProp = pWin->optional->userProps;
-            while (prevProp->next != pProp)
-                prevProp = prevProp->next;
-            prevProp->next = pProp->next;
-        }
-
+        RemoveProperty(pWin, pProp);
         free(pProp->data);
         dixFreeObjectWithPrivates(pProp, PRIVATE_PROPERTY);
     }
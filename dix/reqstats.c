@@ -0,0 +1,227 @@
+/*
+ * Copyright © 2026 X.Org Foundation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <X11/X.h>
+#include "misc.h"
+#include "os.h"
+#include "dixstruct.h"
+#include "extnsionst.h"
+#include "privates.h"
+#include "reqstats.h"
+
+Bool reqStatsEnabled = FALSE;
+
+/*
+ * Core requests only ever have minor opcode 0 and get a single entry,
+ * extension majors get a lazily allocated array indexed by minor opcode.
+ */
+#define REQSTATS_NUM_MAJORS     256
+#define REQSTATS_NUM_MINORS     256
+
+static ReqStatsPtr reqStats[REQSTATS_NUM_MAJORS];
+
+static DevPrivateKeyRec ClientReqStatsKeyRec;
+
+#define ClientReqStatsKey (&ClientReqStatsKeyRec)
+
+int
+ReqStatsBucket(CARD64 us)
+{
+    int shift = REQSTATS_SUB_BITS;
+    int bucket;
+
+    if (us < REQSTATS_SUB_BUCKETS)
+        return us;
+
+    while ((us >> (shift + 1)) != 0)
+        shift++;
+
+    bucket = (shift - REQSTATS_SUB_BITS + 1) * REQSTATS_SUB_BUCKETS +
+        ((us >> (shift - REQSTATS_SUB_BITS)) & (REQSTATS_SUB_BUCKETS - 1));
+
+    return min(bucket, REQSTATS_NUM_BUCKETS - 1);
+}
+
+/* Smallest latency in microseconds that ends up in the given bucket */
+CARD64
+ReqStatsBucketMin(int bucket)
+{
+    int shift;
+
+    if (bucket < REQSTATS_SUB_BUCKETS)
+        return bucket;
+
+    shift = bucket / REQSTATS_SUB_BUCKETS - 1 + REQSTATS_SUB_BITS;
+    return (CARD64) (REQSTATS_SUB_BUCKETS + bucket % REQSTATS_SUB_BUCKETS)
+        << (shift - REQSTATS_SUB_BITS);
+}
+
+ReqStatsPtr
+ReqStatsLookup(int major, int minor)
+{
+    if (major < 0 || major >= REQSTATS_NUM_MAJORS || !reqStats[major])
+        return NULL;
+
+    if (major < EXTENSION_BASE)
+        return minor == 0 ? reqStats[major] : NULL;
+
+    if (minor < 0 || minor >= REQSTATS_NUM_MINORS)
+        return NULL;
+
+    return &reqStats[major][minor];
+}
+
+static ReqStatsPtr
+ReqStatsGet(int major, int minor)
+{
+    if (!reqStats[major]) {
+        reqStats[major] = calloc(major < EXTENSION_BASE ? 1 :
+                                 REQSTATS_NUM_MINORS, sizeof(ReqStatsRec));
+        if (!reqStats[major])
+            return NULL;
+    }
+
+    if (major < EXTENSION_BASE)
+        return reqStats[major];
+
+    if (minor < 0 || minor >= REQSTATS_NUM_MINORS)
+        return NULL;
+
+    return &reqStats[major][minor];
+}
+
+void
+ReqStatsForEach(ReqStatsProcPtr proc, void *closure)
+{
+    int major, minor;
+
+    for (major = 0; major < REQSTATS_NUM_MAJORS; major++) {
+        int nminor;
+
+        if (!reqStats[major])
+            continue;
+
+        nminor = major < EXTENSION_BASE ? 1 : REQSTATS_NUM_MINORS;
+        for (minor = 0; minor < nminor; minor++) {
+            if (reqStats[major][minor].count)
+                (*proc) (major, minor, &reqStats[major][minor], closure);
+        }
+    }
+}
+
+ClientReqStatsPtr
+ReqStatsForClient(ClientPtr client)
+{
+    if (!dixPrivateKeyRegistered(ClientReqStatsKey))
+        return NULL;
+
+    return dixLookupPrivate(&client->devPrivates, ClientReqStatsKey);
+}
+
+void
+ReqStatsRecord(ClientPtr client, int bytes, CARD64 us, int result)
+{
+    ReqStatsPtr stats = ReqStatsGet(client->majorOp, client->minorOp);
+    ClientReqStatsPtr cstats = ReqStatsForClient(client);
+    CARD32 us32 = min(us, 0xffffffff);
+
+    if (stats) {
+        stats->count++;
+        stats->bytes_in += bytes;
+        stats->total_us += us;
+        stats->max_us = max(stats->max_us, us32);
+        stats->buckets[ReqStatsBucket(us)]++;
+        if (result != Success)
+            stats->errors++;
+    }
+
+    if (cstats) {
+        cstats->requests++;
+        cstats->bytes_in += bytes;
+        cstats->total_us += us;
+        cstats->max_us = max(cstats->max_us, us32);
+        if (result != Success)
+            cstats->errors++;
+    }
+}
+
+void
+ReqStatsCountOutput(ClientPtr client, int bytes)
+{
+    ClientReqStatsPtr cstats = ReqStatsForClient(client);
+
+    if (cstats)
+        cstats->bytes_out += bytes;
+}
+
+void
+ReqStatsCountRead(ClientPtr client)
+{
+    ClientReqStatsPtr cstats = ReqStatsForClient(client);
+
+    if (cstats)
+        cstats->reads++;
+}
+
+static void
+ReqStatsFreeOpcodes(void)
+{
+    int i;
+
+    for (i = 0; i < REQSTATS_NUM_MAJORS; i++) {
+        free(reqStats[i]);
+        reqStats[i] = NULL;
+    }
+}
+
+void
+ReqStatsReset(void)
+{
+    int i;
+
+    ReqStatsFreeOpcodes();
+
+    if (dixPrivateKeyRegistered(ClientReqStatsKey)) {
+        for (i = 0; i < currentMaxClients; i++) {
+            if (clients[i])
+                memset(ReqStatsForClient(clients[i]), 0,
+                       sizeof(ClientReqStatsRec));
+        }
+    }
+}
+
+void
+ReqStatsInit(void)
+{
+    ReqStatsFreeOpcodes();
+
+    if (!dixRegisterPrivateKey(ClientReqStatsKey, PRIVATE_CLIENT,
+                               sizeof(ClientReqStatsRec)))
+        FatalError("failed to register request statistics private\n");
+}
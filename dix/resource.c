@@ -105,8 +105,13 @@ Equipment Corporation.
  *      A resource ID is a 32 bit quantity, the upper 2 bits of which are
  *	off-limits for client-visible resources.  The next 8 bits are
  *      used as client ID, and the low 22 bits come from the client.
- *	A resource ID is "hashed" by extracting and xoring subfields
- *      (varying with the size of the hash table).
+ *
+ *      Each client's resources are kept in an array in the order they were
+ *      added, indexed by an open-addressing hash table (robin hood hashing
+ *      with linear probing and backward shift deletion) that maps the id to
+ *      the position in that array.  Freed entries are only marked dead and
+ *      the array is compacted later, so walking a client's resources stays
+ *      safe while the callbacks add or free resources.
  *
  *      It is sometimes necessary for the server to create an ID that looks
  *      like it belongs to a client.  This ID, however,  must not be one
@@ -149,27 +154,37 @@ Equipment Corporation.
 #define TypeNameString(t) LookupResourceName(t)
 #endif
 
-static void RebuildTable(int    /*client */
-    );
-
 #define SERVER_MINID 32
 
-#define INITBUCKETS 64
+#define INITRESOURCES 32
 #define INITHASHSIZE 6
-#define MAXHASHSIZE 16
+
+/* An entry whose resource has been freed, see ResourceEntryDead */
+#define DEAD_ID None
+
+/* An index slot not referring to any entry */
+#define EMPTY_SLOT -1
 
 typedef struct _Resource {
-    struct _Resource *next;
     XID id;
     RESTYPE type;
     void *value;
 } ResourceRec, *ResourcePtr;
 
+typedef struct _ResourceSlot {
+    XID id;
+    int entry;
+} ResourceSlot;
+
 typedef struct _ClientResource {
-    ResourcePtr *resources;
-    int elements;
-    int buckets;
-    int hashsize;               /* log(2)(buckets) */
+    ResourcePtr resources;      /* in the order they were added */
+    int used;                   /* entries used, including dead ones */
+    int size;                   /* entries allocated */
+    int elements;               /* live entries */
+    ResourceSlot *index;
+    int hashsize;               /* log(2)(index slots) */
+    int iterating;              /* no compaction while walking resources */
+    int lastLookup;             /* entry found by the last lookup */
     XID fakeID;
     XID endFakeID;
 } ClientResourceRec;
@@ -645,12 +660,22 @@ InitClientResources(ClientPtr client)
         memcpy(resourceTypes, predefTypes, sizeof(predefTypes));
     }
     clientTable[i = client->index].resources =
-        malloc(INITBUCKETS * sizeof(ResourcePtr));
+        xallocarray(INITRESOURCES, sizeof(ResourceRec));
     if (!clientTable[i].resources)
         return FALSE;
-    clientTable[i].buckets = INITBUCKETS;
+    clientTable[i].index = xallocarray(1 << INITHASHSIZE,
+                                       sizeof(ResourceSlot));
+    if (!clientTable[i].index) {
+        free(clientTable[i].resources);
+        clientTable[i].resources = NULL;
+        return FALSE;
+    }
+    clientTable[i].size = INITRESOURCES;
+    clientTable[i].used = 0;
     clientTable[i].elements = 0;
     clientTable[i].hashsize = INITHASHSIZE;
+    clientTable[i].iterating = 0;
+    clientTable[i].lastLookup = 0;
     /* Many IDs allocated from the server client are visible to clients,
      * so we don't use the SERVER_BIT for them, but we have to start
      * past the magic value constants used in the protocol.  For normal
@@ -659,8 +684,8 @@ InitClientResources(ClientPtr client)
     clientTable[i].fakeID = client->clientAsMask |
         (client->index ? SERVER_BIT : SERVER_MINID);
     clientTable[i].endFakeID = (clientTable[i].fakeID | RESOURCE_ID_MASK) + 1;
-    for (j = 0; j < INITBUCKETS; j++) {
-        clientTable[i].resources[j] = NULL;
+    for (j = 0; j < (1 << INITHASHSIZE); j++) {
+        clientTable[i].index[j].entry = EMPTY_SLOT;
     }
     return TRUE;
 }
@@ -678,18 +703,266 @@ HashResourceID(XID id, int numBits)
     return (id ^ (id >> numBits)) & ~((~0) << numBits);
 }
 
+static inline Bool
+ResourceEntryDead(ResourcePtr res)
+{
+    return res->id == DEAD_ID;
+}
+
+/*
+ * Fibonacci hashing of the whole id.  Resource ids are mostly handed out
+ * sequentially, both by the clients and by FakeClientID, and the two
+ * sequences overlap in their low bits, which would make linear probing
+ * form long clusters with HashResourceID.
+ */
+static inline int
+ResourceIndexHash(XID id, int bits)
+{
+    return (CARD32) ((CARD32) id * 2654435761U) >> (32 - bits);
+}
+
+/* How far the slot at pos is away from where its id hashes to */
+static inline int
+ResourceProbeDistance(ClientResourceRec *rrec, int pos)
+{
+    int mask = (1 << rrec->hashsize) - 1;
+
+    return (pos - ResourceIndexHash(rrec->index[pos].id, rrec->hashsize)) & mask;
+}
+
+static void
+IndexInsert(ClientResourceRec *rrec, XID id, int entry)
+{
+    int mask = (1 << rrec->hashsize) - 1;
+    int pos = ResourceIndexHash(id, rrec->hashsize);
+    int dist = 0;
+
+    for (;;) {
+        ResourceSlot *slot = &rrec->index[pos];
+        int slotDist;
+
+        if (slot->entry == EMPTY_SLOT) {
+            slot->id = id;
+            slot->entry = entry;
+            return;
+        }
+
+        /* Take the place of any slot closer to its home than we are */
+        slotDist = ResourceProbeDistance(rrec, pos);
+        if (slotDist < dist) {
+            ResourceSlot tmp = *slot;
+
+            slot->id = id;
+            slot->entry = entry;
+            id = tmp.id;
+            entry = tmp.entry;
+            dist = slotDist;
+        }
+
+        pos = (pos + 1) & mask;
+        dist++;
+    }
+}
+
+static void
+IndexRemove(ClientResourceRec *rrec, XID id, int entry)
+{
+    int mask = (1 << rrec->hashsize) - 1;
+    int pos = ResourceIndexHash(id, rrec->hashsize);
+    int next;
+
+    while (rrec->index[pos].entry != entry)
+        pos = (pos + 1) & mask;
+
+    /* Shift the following slots back until one is empty or at home */
+    for (;;) {
+        next = (pos + 1) & mask;
+        if (rrec->index[next].entry == EMPTY_SLOT ||
+            ResourceProbeDistance(rrec, next) == 0)
+            break;
+        rrec->index[pos] = rrec->index[next];
+        pos = next;
+    }
+    rrec->index[pos].entry = EMPTY_SLOT;
+}
+
+#define MatchAnyType    0
+#define MatchType       1
+#define MatchClass      2
+
+static inline Bool
+ResourceMatches(ResourcePtr res, XID id, RESTYPE type, int match)
+{
+    if (res->id != id || ResourceEntryDead(res))
+        return FALSE;
+
+    switch (match) {
+    case MatchType:
+        return res->type == type;
+    case MatchClass:
+        return (res->type & type) != 0;
+    default:
+        return TRUE;
+    }
+}
+
+/*
+ * Find the most recently added resource matching id and type.  Returns the
+ * entry or -1.
+ */
+static int
+FindEntry(ClientResourceRec *rrec, XID id, RESTYPE type, int match)
+{
+    int mask = (1 << rrec->hashsize) - 1;
+    int pos = ResourceIndexHash(id, rrec->hashsize);
+    int dist = 0;
+    int found = -1;
+
+    for (;;) {
+        ResourceSlot *slot = &rrec->index[pos];
+
+        if (slot->entry == EMPTY_SLOT || ResourceProbeDistance(rrec, pos) < dist)
+            break;
+
+        if (slot->id == id && slot->entry > found &&
+            ResourceMatches(&rrec->resources[slot->entry], id, type, match))
+            found = slot->entry;
+
+        pos = (pos + 1) & mask;
+        dist++;
+    }
+
+    return found;
+}
+
+/* Like FindEntry, but tries the last resource looked up first */
+static inline ResourcePtr
+LookupEntry(ClientResourceRec *rrec, XID id, RESTYPE type, int match)
+{
+    int entry;
+
+    if (rrec->lastLookup < rrec->used &&
+        ResourceMatches(&rrec->resources[rrec->lastLookup], id, type, match))
+        return &rrec->resources[rrec->lastLookup];
+
+    entry = FindEntry(rrec, id, type, match);
+    if (entry < 0)
+        return NULL;
+
+    rrec->lastLookup = entry;
+    return &rrec->resources[entry];
+}
+
+/*
+ * Reallocate the index so it has at least twice as many slots as there
+ * are entries and insert all live entries.
+ */
+static Bool
+RebuildIndex(ClientResourceRec *rrec, int size)
+{
+    ResourceSlot *index;
+    int hashsize = INITHASHSIZE;
+    int i;
+
+    while ((1 << hashsize) < 2 * size)
+        hashsize++;
+
+    index = xallocarray(1 << hashsize, sizeof(ResourceSlot));
+    if (!index)
+        return FALSE;
+    for (i = 0; i < (1 << hashsize); i++)
+        index[i].entry = EMPTY_SLOT;
+
+    free(rrec->index);
+    rrec->index = index;
+    rrec->hashsize = hashsize;
+
+    for (i = 0; i < rrec->used; i++) {
+        if (!ResourceEntryDead(&rrec->resources[i]))
+            IndexInsert(rrec, rrec->resources[i].id, i);
+    }
+
+    return TRUE;
+}
+
+/*
+ * Squeeze out dead entries, keeping the order of the live ones.  Must not
+ * be called while somebody walks the entries.
+ */
+static void
+CompactResources(ClientResourceRec *rrec)
+{
+    int i, j;
+
+    for (i = 0, j = 0; i < rrec->used; i++) {
+        if (!ResourceEntryDead(&rrec->resources[i]))
+            rrec->resources[j++] = rrec->resources[i];
+    }
+    rrec->used = j;
+    rrec->lastLookup = 0;
+
+    /* the index is at least as large as needed, just refill it */
+    for (i = 0; i < (1 << rrec->hashsize); i++)
+        rrec->index[i].entry = EMPTY_SLOT;
+    for (i = 0; i < rrec->used; i++)
+        IndexInsert(rrec, rrec->resources[i].id, i);
+}
+
+/* Make room for one more entry at the end */
+static Bool
+GrowResources(ClientResourceRec *rrec)
+{
+    ResourcePtr resources;
+    int size;
+
+    if (!rrec->iterating && rrec->used - rrec->elements >= rrec->size / 2) {
+        CompactResources(rrec);
+        return TRUE;
+    }
+
+    size = 2 * rrec->size;
+    resources = reallocarray(rrec->resources, size, sizeof(ResourceRec));
+    if (!resources)
+        return FALSE;
+    rrec->resources = resources;
+
+    if (!RebuildIndex(rrec, size))
+        return FALSE;
+
+    rrec->size = size;
+    return TRUE;
+}
+
+/*
+ * Unhook an entry from the index and mark it dead.  The caller gets a copy
+ * of the resource, the entry itself may be reused once we're not iterating.
+ */
+static void
+RemoveEntry(ClientResourceRec *rrec, int entry, ResourcePtr res)
+{
+    *res = rrec->resources[entry];
+
+    IndexRemove(rrec, res->id, entry);
+    rrec->resources[entry].id = DEAD_ID;
+    rrec->resources[entry].value = NULL;
+    rrec->elements--;
+
+    if (rrec->iterating)
+        return;
+
+    if (rrec->elements == 0)
+        rrec->used = rrec->lastLookup = 0;
+    else if (rrec->used > INITRESOURCES && rrec->elements < rrec->used / 4)
+        CompactResources(rrec);
+}
+
 static XID
 AvailableID(int client, XID id, XID maxid, XID goodid)
 {
-    ResourcePtr res;
-
     if ((goodid >= id) && (goodid <= maxid))
         return goodid;
     for (; id <= maxid; id++) {
-        res = clientTable[client].resources[HashResourceID(id, clientTable[client].hashsize)];
-        while (res && (res->id != id))
-            res = res->next;
-        if (!res)
+        if (FindEntry(&clientTable[client], id, RT_NONE, MatchAnyType) < 0)
             return id;
     }
     return 0;
@@ -699,7 +972,6 @@ void
 GetXIDRange(int client, Bool server, XID *minp, XID *maxp)
 {
     XID id, maxid;
-    ResourcePtr *resp;
     ResourcePtr res;
     int i;
     XID goodid;
@@ -709,18 +981,18 @@ GetXIDRange(int client, Bool server, XID *minp, XID *maxp)
         id |= client ? SERVER_BIT : SERVER_MINID;
     maxid = id | RESOURCE_ID_MASK;
     goodid = 0;
-    for (resp = clientTable[client].resources, i = clientTable[client].buckets;
-         --i >= 0;) {
-        for (res = *resp++; res; res = res->next) {
-            if ((res->id < id) || (res->id > maxid))
-                continue;
-            if (((res->id - id) >= (maxid - res->id)) ?
-                (goodid = AvailableID(client, id, res->id - 1, goodid)) :
-                !(goodid = AvailableID(client, res->id + 1, maxid, goodid)))
-                maxid = res->id - 1;
-            else
-                id = res->id + 1;
-        }
+    for (i = 0; i < clientTable[client].used; i++) {
+        res = &clientTable[client].resources[i];
+        if (ResourceEntryDead(res))
+            continue;
+        if ((res->id < id) || (res->id > maxid))
+            continue;
+        if (((res->id - id) >= (maxid - res->id)) ?
+            (goodid = AvailableID(client, id, res->id - 1, goodid)) :
+            !(goodid = AvailableID(client, res->id + 1, maxid, goodid)))
+            maxid = res->id - 1;
+        else
+            id = res->id + 1;
     }
     if (id > maxid)
         id = maxid = 0;
@@ -798,79 +1070,37 @@ AddResource(XID id, RESTYPE type, void *value)
 {
     int client;
     ClientResourceRec *rrec;
-    ResourcePtr res, *head;
+    ResourcePtr res;
 
 #ifdef XSERVER_DTRACE
     XSERVER_RESOURCE_ALLOC(id, type, value, TypeNameString(type));
 #endif
     client = CLIENT_ID(id);
     rrec = &clientTable[client];
-    if (!rrec->buckets) {
+    if (!rrec->resources) {
         ErrorF("[dix] AddResource(%lx, %x, %lx), client=%d \n",
                (unsigned long) id, type, (unsigned long) value, client);
         FatalError("client not in use\n");
     }
-    if ((rrec->elements >= 4 * rrec->buckets) && (rrec->hashsize < MAXHASHSIZE))
-        RebuildTable(client);
-    head = &rrec->resources[HashResourceID(id, clientTable[client].hashsize)];
-    res = malloc(sizeof(ResourceRec));
-    if (!res) {
+    if (rrec->used == rrec->size && !GrowResources(rrec)) {
         (*resourceTypes[type & TypeMask].deleteFunc) (value, id);
         return FALSE;
     }
-    res->next = *head;
+    res = &rrec->resources[rrec->used];
     res->id = id;
     res->type = type;
     res->value = value;
-    *head = res;
+    IndexInsert(rrec, id, rrec->used);
+    /* lookups return the most recent resource, don't let the cache hide it */
+    if (rrec->lastLookup < rrec->used &&
+        rrec->resources[rrec->lastLookup].id == id)
+        rrec->lastLookup = rrec->used;
+    rrec->used++;
     rrec->elements++;
     CallResourceStateCallback(ResourceStateAdding, res);
     return TRUE;
 }
 
-static void
-RebuildTable(int client)
-{
-    int j;
-    ResourcePtr res, next;
-    ResourcePtr **tails, *resources;
-    ResourcePtr **tptr, *rptr;
-
-    /*
-     * For now, preserve insertion order, since some ddx layers depend
-     * on resources being free in the opposite order they are added.
-     */
-
-    j = 2 * clientTable[client].buckets;
-    tails =  xallocarray(j, sizeof(ResourcePtr *));
-    if (!tails)
-        return;
-    resources =  xallocarray(j, sizeof(ResourcePtr));
-    if (!resources) {
-        free(tails);
-        return;
-    }
-    for (rptr = resources, tptr = tails; --j >= 0; rptr++, tptr++) {
-        *rptr = NULL;
-        *tptr = rptr;
-    }
-    clientTable[client].hashsize++;
-    for (j = clientTable[client].buckets,
-         rptr = clientTable[client].resources; --j >= 0; rptr++) {
-        for (res = *rptr; res; res = next) {
-            next = res->next;
-            res->next = NULL;
-            tptr = &tails[HashResourceID(res->id, clientTable[client].hashsize)];
-            **tptr = res;
-            *tptr = &res->next;
-        }
-    }
-    free(tails);
-    clientTable[client].buckets *= 2;
-    free(clientTable[client].resources);
-    clientTable[client].resources = resources;
-}
-
 static void
 doFreeResource(ResourcePtr res, Bool skip)
 {
@@ -878,42 +1108,26 @@ doFreeResource(ResourcePtr res, Bool skip)
 
     if (!skip)
         resourceTypes[res->type & TypeMask].deleteFunc(res->value, res->id);
-
-    free(res);
 }
 
 void
 FreeResource(XID id, RESTYPE skipDeleteFuncType)
 {
     int cid;
-    ResourcePtr res;
-    ResourcePtr *prev, *head;
-    int *eltptr;
-    int elements;
-
-    if (((cid = CLIENT_ID(id)) < LimitClients) && clientTable[cid].buckets) {
-        head = &clientTable[cid].resources[HashResourceID(id, clientTable[cid].hashsize)];
-        eltptr = &clientTable[cid].elements;
-
-        prev = head;
-        while ((res = *prev)) {
-            if (res->id == id) {
-                RESTYPE rtype = res->type;
-
+    int entry;
+    ResourceRec res;
+
+    if (((cid = CLIENT_ID(id)) < LimitClients) && clientTable[cid].resources) {
+        /* deleteFunc may change the table, so look the id up again each
+         * time around */
+        while ((entry = FindEntry(&clientTable[cid], id,
+                                  RT_NONE, MatchAnyType)) >= 0) {
+            RemoveEntry(&clientTable[cid], entry, &res);
 #ifdef XSERVER_DTRACE
-                XSERVER_RESOURCE_FREE(res->id, res->type,
-                                      res->value, TypeNameString(res->type));
+            XSERVER_RESOURCE_FREE(res.id, res.type,
+                                  res.value, TypeNameString(res.type));
 #endif
-                *prev = res->next;
-                elements = --*eltptr;
-
-                doFreeResource(res, rtype == skipDeleteFuncType);
-
-                if (*eltptr != elements)
-                    prev = head;        /* prev may no longer be valid */
-            }
-            else
-                prev = &res->next;
+            doFreeResource(&res, res.type == skipDeleteFuncType);
         }
     }
 }
@@ -922,28 +1136,18 @@ void
 FreeResourceByType(XID id, RESTYPE type, Bool skipFree)
 {
     int cid;
-    ResourcePtr res;
-    ResourcePtr *prev, *head;
-
-    if (((cid = CLIENT_ID(id)) < LimitClients) && clientTable[cid].buckets) {
-        head = &clientTable[cid].resources[HashResourceID(id, clientTable[cid].hashsize)];
+    int entry;
+    ResourceRec res;
 
-        prev = head;
-        while ((res = *prev)) {
-            if (res->id == id && res->type == type) {
+    if (((cid = CLIENT_ID(id)) < LimitClients) && clientTable[cid].resources) {
+        entry = FindEntry(&clientTable[cid], id, type, MatchType);
+        if (entry >= 0) {
+            RemoveEntry(&clientTable[cid], entry, &res);
 #ifdef XSERVER_DTRACE
-                XSERVER_RESOURCE_FREE(res->id, res->type,
-                                      res->value, TypeNameString(res->type));
+            XSERVER_RESOURCE_FREE(res.id, res.type,
+                                  res.value, TypeNameString(res.type));
 #endif
-                *prev = res->next;
-                clientTable[cid].elements--;
-
-                doFreeResource(res, skipFree);
-
-                break;
-            }
-            else
-                prev = &res->next;
+            doFreeResource(&res, skipFree);
         }
     }
 }
@@ -960,14 +1164,12 @@ ChangeResourceValue(XID id, RESTYPE rtype, void *value)
     int cid;
     ResourcePtr res;
 
-    if (((cid = CLIENT_ID(id)) < LimitClients) && clientTable[cid].buckets) {
-        res = clientTable[cid].resources[HashResourceID(id, clientTable[cid].hashsize)];
-
-        for (; res; res = res->next)
-            if ((res->id == id) && (res->type == rtype)) {
-                res->value = value;
-                return TRUE;
-            }
+    if (((cid = CLIENT_ID(id)) < LimitClients) && clientTable[cid].resources) {
+        res = LookupEntry(&clientTable[cid], id, rtype, MatchType);
+        if (res) {
+            res->value = value;
+            return TRUE;
+        }
     }
     return FALSE;
 }
@@ -982,27 +1184,23 @@ void
 FindClientResourcesByType(ClientPtr client,
                           RESTYPE type, FindResType func, void *cdata)
 {
-    ResourcePtr *resources;
-    ResourcePtr this, next;
-    int i, elements;
-    int *eltptr;
+    ClientResourceRec *rrec;
+    int i;
 
     if (!client)
         client = serverClient;
 
-    resources = clientTable[client->index].resources;
-    eltptr = &clientTable[client->index].elements;
-    for (i = 0; i < clientTable[client->index].buckets; i++) {
-        for (this = resources[i]; this; this = next) {
-            next = this->next;
-            if (!type || this->type == type) {
-                elements = *eltptr;
-                (*func) (this->value, this->id, cdata);
-                if (*eltptr != elements)
-                    next = resources[i];        /* start over */
-            }
-        }
+    rrec = &clientTable[client->index];
+    rrec->iterating++;
+    for (i = 0; i < rrec->used; i++) {
+        ResourcePtr this = &rrec->resources[i];
+
+        if (ResourceEntryDead(this))
+            continue;
+        if (!type || this->type == type)
+            (*func) (this->value, this->id, cdata);
     }
+    rrec->iterating--;
 }
 
 void FindSubResources(void *resource,
@@ -1017,25 +1215,21 @@ void FindSubResources(void *resource,
 void
 FindAllClientResources(ClientPtr client, FindAllRes func, void *cdata)
 {
-    ResourcePtr *resources;
-    ResourcePtr this, next;
-    int i, elements;
-    int *eltptr;
+    ClientResourceRec *rrec;
+    int i;
 
     if (!client)
         client = serverClient;
 
-    resources = clientTable[client->index].resources;
-    eltptr = &clientTable[client->index].elements;
-    for (i = 0; i < clientTable[client->index].buckets; i++) {
-        for (this = resources[i]; this; this = next) {
-            next = this->next;
-            elements = *eltptr;
+    rrec = &clientTable[client->index];
+    rrec->iterating++;
+    for (i = 0; i < rrec->used; i++) {
+        ResourcePtr this = &rrec->resources[i];
+
+        if (!ResourceEntryDead(this))
             (*func) (this->value, this->id, this->type, cdata);
-            if (*eltptr != elements)
-                next = resources[i];    /* start over */
-        }
     }
+    rrec->iterating--;
 }
 
 void *
@@ -1043,74 +1237,67 @@ LookupClientResourceComplex(ClientPtr client,
                             RESTYPE type,
                             FindComplexResType func, void *cdata)
 {
-    ResourcePtr *resources;
-    ResourcePtr this, next;
+    ClientResourceRec *rrec;
     void *value;
     int i;
 
     if (!client)
         client = serverClient;
 
-    resources = clientTable[client->index].resources;
-    for (i = 0; i < clientTable[client->index].buckets; i++) {
-        for (this = resources[i]; this; this = next) {
-            next = this->next;
-            if (!type || this->type == type) {
-                /* workaround func freeing the type as DRI1 does */
-                value = this->value;
-                if ((*func) (value, this->id, cdata))
-                    return value;
+    rrec = &clientTable[client->index];
+    rrec->iterating++;
+    for (i = 0; i < rrec->used; i++) {
+        ResourcePtr this = &rrec->resources[i];
+
+        if (ResourceEntryDead(this))
+            continue;
+        if (!type || this->type == type) {
+            /* workaround func freeing the type as DRI1 does */
+            value = this->value;
+            if ((*func) (value, this->id, cdata)) {
+                rrec->iterating--;
+                return value;
             }
         }
     }
+    rrec->iterating--;
     return NULL;
 }
 
 void
 FreeClientNeverRetainResources(ClientPtr client)
 {
-    ResourcePtr *resources;
-    ResourcePtr this;
-    ResourcePtr *prev;
-    int j, elements;
-    int *eltptr;
+    ClientResourceRec *rrec;
+    ResourceRec res;
+    int i;
 
     if (!client)
         return;
 
-    resources = clientTable[client->index].resources;
-    eltptr = &clientTable[client->index].elements;
-    for (j = 0; j < clientTable[client->index].buckets; j++) {
-        prev = &resources[j];
-        while ((this = *prev)) {
-            RESTYPE rtype = this->type;
+    rrec = &clientTable[client->index];
+    rrec->iterating++;
+    for (i = rrec->used; --i >= 0;) {
+        ResourcePtr this = &rrec->resources[i];
+
+        if (ResourceEntryDead(this) || !(this->type & RC_NEVERRETAIN))
+            continue;
 
-            if (rtype & RC_NEVERRETAIN) {
+        RemoveEntry(rrec, i, &res);
 #ifdef XSERVER_DTRACE
-                XSERVER_RESOURCE_FREE(this->id, this->type,
-                                      this->value, TypeNameString(this->type));
+        XSERVER_RESOURCE_FREE(res.id, res.type,
+                              res.value, TypeNameString(res.type));
 #endif
-                *prev = this->next;
-                clientTable[client->index].elements--;
-                elements = *eltptr;
-
-                doFreeResource(this, FALSE);
-
-                if (*eltptr != elements)
-                    prev = &resources[j];       /* prev may no longer be valid */
-            }
-            else
-                prev = &this->next;
-        }
+        doFreeResource(&res, FALSE);
     }
+    rrec->iterating--;
 }
 
 void
 FreeClientResources(ClientPtr client)
 {
-    ResourcePtr *resources;
-    ResourcePtr this;
-    int j;
+    ClientResourceRec *rrec;
+    ResourceRec res;
+    int i;
 
     /* This routine shouldn't be called with a null client, but just in
        case ... */
@@ -1120,35 +1307,35 @@ FreeClientResources(ClientPtr client)
 
     HandleSaveSet(client);
 
-    resources = clientTable[client->index].resources;
-    for (j = 0; j < clientTable[client->index].buckets; j++) {
-        /* It may seem silly to update the head of this resource list as
-           we delete the members, since the entire list will be deleted any way,
-           but there are some resource deletion functions "FreeClientPixels" for
-           one which do a LookupID on another resource id (a Colormap id in this
-           case), so the resource list must be kept valid up to the point that
-           it is deleted, so every time we delete a resource, we must update the
-           head, just like in FreeResource. I hope that this doesn't slow down
-           mass deletion appreciably. PRH */
-
-        ResourcePtr *head;
-
-        head = &resources[j];
+    rrec = &clientTable[client->index];
+    rrec->iterating++;
+    while (rrec->elements) {
+        /* Free in the opposite order the resources were added.  Every
+           resource is removed from the table before its delete function
+           runs, since some of them, "FreeClientPixels" for one, look up
+           other resources of the same client (a Colormap id in this case),
+           so the table must be kept valid up to the point that it is
+           deleted.  Delete functions may add resources too, hence the
+           outer loop. */
+        for (i = rrec->used; --i >= 0;) {
+            if (ResourceEntryDead(&rrec->resources[i]))
+                continue;
 
-        for (this = *head; this; this = *head) {
+            RemoveEntry(rrec, i, &res);
 #ifdef XSERVER_DTRACE
-            XSERVER_RESOURCE_FREE(this->id, this->type,
-                                  this->value, TypeNameString(this->type));
+            XSERVER_RESOURCE_FREE(res.id, res.type,
+                                  res.value, TypeNameString(res.type));
 #endif
-            *head = this->next;
-            clientTable[client->index].elements--;
-
-            doFreeResource(this, FALSE);
+            doFreeResource(&res, FALSE);
         }
     }
-    free(clientTable[client->index].resources);
-    clientTable[client->index].resources = NULL;
-    clientTable[client->index].buckets = 0;
+    rrec->iterating--;
+
+    free(rrec->resources);
+    free(rrec->index);
+    rrec->resources = NULL;
+    rrec->index = NULL;
+    rrec->used = rrec->size = 0;
 }
 
 void
@@ -1157,7 +1344,7 @@ FreeAllResources(void)
     int i;
 
     for (i = currentMaxClients; --i >= 0;) {
-        if (clientTable[i].buckets)
+        if (clientTable[i].resources)
             FreeClientResources(clients[i]);
     }
 }
@@ -1198,13 +1385,8 @@ dixLookupResourceByType(void **result, XID id, RESTYPE rtype,
     if ((rtype & TypeMask) > lastResourceType)
         return BadImplementation;
 
-    if ((cid < LimitClients) && clientTable[cid].buckets) {
-        res = clientTable[cid].resources[HashResourceID(id, clientTable[cid].hashsize)];
-
-        for (; res; res = res->next)
-            if (res->id == id && res->type == rtype)
-                break;
-    }
+    if ((cid < LimitClients) && clientTable[cid].resources)
+        res = LookupEntry(&clientTable[cid], id, rtype, MatchType);
     if (client) {
         client->errorValue = id;
     }
@@ -1233,13 +1415,8 @@ dixLookupResourceByClass(void **result, XID id, RESTYPE rclass,
 
     *result = NULL;
 
-    if ((cid < LimitClients) && clientTable[cid].buckets) {
-        res = clientTable[cid].resources[HashResourceID(id, clientTable[cid].hashsize)];
-
-        for (; res; res = res->next)
-            if (res->id == id && (res->type & rclass))
-                break;
-    }
+    if ((cid < LimitClients) && clientTable[cid].resources)
+        res = LookupEntry(&clientTable[cid], id, rclass, MatchClass);
     if (client) {
         client->errorValue = id;
     }
@@ -67,18 +67,116 @@ SOFTWARE.
 Selection *CurrentSelections;
 CallbackListPtr SelectionCallback;
 
+/*
+ * Besides the list, selections are indexed by atom in an open-addressing
+ * hash table.  Selections are only freed on server reset, so the index
+ * never has to remove any.  A security module may create several
+ * selections of the same name, the index holds the most recent one, the
+ * first on the list.
+ *
+ * Selections with an owner are also kept on OwnedSelections, so that
+ * windows and clients going away only have to look at those.
+ */
+
+#define SELECTION_INDEX_BITS    6
+
+static Selection **SelectionIndex;
+static int SelectionIndexBits;
+static int SelectionIndexCount;
+
+static struct xorg_list OwnedSelections = { &OwnedSelections, &OwnedSelections };
+
+static inline int
+SelectionHash(Atom name, int bits)
+{
+    return (CARD32) ((CARD32) name * 2654435761U) >> (32 - bits);
+}
+
+/* The slot holding name, or the empty slot it would go into */
+static Selection **
+SelectionIndexSlot(Selection **table, int bits, Atom name)
+{
+    int mask = (1 << bits) - 1;
+    int pos = SelectionHash(name, bits);
+
+    while (table[pos] && table[pos]->selection != name)
+        pos = (pos + 1) & mask;
+
+    return &table[pos];
+}
+
+static Bool
+SelectionIndexGrow(void)
+{
+    int bits = SelectionIndex ? SelectionIndexBits + 1 : SELECTION_INDEX_BITS;
+    Selection **table, **slot;
+    int i;
+
+    table = calloc(1 << bits, sizeof(Selection *));
+    if (!table)
+        return FALSE;
+
+    for (i = 0; SelectionIndex && i < (1 << SelectionIndexBits); i++) {
+        if (SelectionIndex[i]) {
+            slot = SelectionIndexSlot(table, bits, SelectionIndex[i]->selection);
+            *slot = SelectionIndex[i];
+        }
+    }
+
+    free(SelectionIndex);
+    SelectionIndex = table;
+    SelectionIndexBits = bits;
+    return TRUE;
+}
+
+/* Make room for one more selection, before it is added */
+static Bool
+SelectionIndexReserve(void)
+{
+    if (SelectionIndex &&
+        2 * (SelectionIndexCount + 1) <= (1 << SelectionIndexBits))
+        return TRUE;
+
+    return SelectionIndexGrow();
+}
+
+static void
+SelectionIndexAdd(Selection * pSel)
+{
+    Selection **slot = SelectionIndexSlot(SelectionIndex, SelectionIndexBits,
+                                          pSel->selection);
+
+    if (!*slot)
+        SelectionIndexCount++;
+    *slot = pSel;
+}
+
+static void
+SetSelectionOwner(Selection * pSel, Window window, WindowPtr pWin,
+                  ClientPtr client)
+{
+    if (client && !pSel->client)
+        xorg_list_append(&pSel->owned, &OwnedSelections);
+    else if (!client && pSel->client)
+        xorg_list_del(&pSel->owned);
+
+    pSel->window = window;
+    pSel->pWin = pWin;
+    pSel->client = client;
+}
+
 int
 dixLookupSelection(Selection ** result, Atom selectionName,
                    ClientPtr client, Mask access_mode)
 {
-    Selection *pSel;
+    Selection *pSel = NULL;
     int rc = BadMatch;
 
     client->errorValue = selectionName;
 
-    for (pSel = CurrentSelections; pSel; pSel = pSel->next)
-        if (pSel->selection == selectionName)
-            break;
+    if (SelectionIndex)
+        pSel = *SelectionIndexSlot(SelectionIndex, SelectionIndexBits,
+                                   selectionName);
 
     if (pSel)
         rc = XaceHookSelectionAccess(client, &pSel, access_mode);
@@ -99,6 +197,11 @@ InitSelections(void)
     }
 
     CurrentSelections = NULL;
+
+    free(SelectionIndex);
+    SelectionIndex = NULL;
+    SelectionIndexCount = 0;
+    xorg_list_init(&OwnedSelections);
 }
 
 static _X_INLINE void
@@ -112,30 +215,24 @@ CallSelectionCallback(Selection * pSel, ClientPtr client,
 void
 DeleteWindowFromAnySelections(WindowPtr pWin)
 {
-    Selection *pSel;
+    Selection *pSel, *tmp;
 
-    for (pSel = CurrentSelections; pSel; pSel = pSel->next)
+    xorg_list_for_each_entry_safe(pSel, tmp, &OwnedSelections, owned)
         if (pSel->pWin == pWin) {
             CallSelectionCallback(pSel, NULL, SelectionWindowDestroy);
-
-            pSel->pWin = (WindowPtr) NULL;
-            pSel->window = None;
-            pSel->client = NullClient;
+            SetSelectionOwner(pSel, None, NULL, NullClient);
         }
 }
 
 void
 DeleteClientFromAnySelections(ClientPtr client)
 {
-    Selection *pSel;
+    Selection *pSel, *tmp;
 
-    for (pSel = CurrentSelections; pSel; pSel = pSel->next)
+    xorg_list_for_each_entry_safe(pSel, tmp, &OwnedSelections, owned)
         if (pSel->client == client) {
             CallSelectionCallback(pSel, NULL, SelectionClientClose);
-
-            pSel->pWin = (WindowPtr) NULL;
-            pSel->window = None;
-            pSel->client = NullClient;
+            SetSelectionOwner(pSel, None, NULL, NullClient);
         }
 }
 
@@ -194,11 +291,14 @@ ProcSetSelectionOwner(ClientPtr client)
         /*
          * It doesn't exist, so add it...
          */
+        if (!SelectionIndexReserve())
+            return BadAlloc;
         pSel = dixAllocateObjectWithPrivates(Selection, PRIVATE_SELECTION);
         if (!pSel)
             return BadAlloc;
 
         pSel->selection = stuff->selection;
+        xorg_list_init(&pSel->owned);
 
         /* security creation/labeling check */
         rc = XaceHookSelectionAccess(client, &pSel,
@@ -210,14 +310,13 @@ ProcSetSelectionOwner(ClientPtr client)
 
         pSel->next = CurrentSelections;
         CurrentSelections = pSel;
+        SelectionIndexAdd(pSel);
     }
     else
         return rc;
 
     pSel->lastTimeChanged = time;
-    pSel->window = stuff->window;
-    pSel->pWin = pWin;
-    pSel->client = (pWin ? client : NullClient);
+    SetSelectionOwner(pSel, stuff->window, pWin, pWin ? client : NullClient);
 
     CallSelectionCallback(pSel, client, SelectionSetOwner);
     return Success;
@@ -132,6 +132,7 @@ Equipment Corporation.
 #include "privates.h"
 #include "xace.h"
 #include "exevents.h"
+#include "dixgrabs.h"
 
 #include <X11/Xatom.h>          /* must come after server includes */
 
@@ -501,6 +502,7 @@ SetWindowToDefaults(WindowPtr pWin)
 
     pWin->eventMask = 0;
     pWin->deliverableEvents = 0;
+    pWin->deliverySkip = NullWindow;
     pWin->dontPropagate = 0;
     pWin->forcedBS = FALSE;
     pWin->redirectDraw = RedirectDrawNone;
@@ -608,6 +610,9 @@ CreateRootWindow(ScreenPtr pScreen)
     pWin->optional->inputShape = NULL;
     pWin->optional->inputMasks = NULL;
     pWin->optional->deviceCursors = NULL;
+    pWin->optional->propIndex = NULL;
+    pWin->optional->childIndex = NULL;
+    pWin->optional->grabIndex = NULL;
     pWin->optional->colormap = pScreen->defColormap;
     pWin->optional->visual = pScreen->rootVisual;
 
@@ -918,6 +923,7 @@ CreateWindow(Window wid, WindowPtr pParent, int x, int y, unsigned w,
             pParent->lastChild = pWin;
         pParent->firstChild = pWin;
     }
+    InvalidateChildIndex(pParent);
 
     SetWinSize(pWin);
     SetBorderSize(pWin);
@@ -999,6 +1005,8 @@ DisposeWindowOptional(WindowPtr pWin)
         pWin->optional->deviceCursors = NULL;
     }
 
+    GrabIndexFree(pWin);
+    free(pWin->optional->childIndex);
     free(pWin->optional);
     pWin->optional = NULL;
 }
@@ -1067,6 +1075,7 @@ CrushTree(WindowPtr pWin)
             pChild = pParent;
             pChild->firstChild = NullWindow;
             pChild->lastChild = NullWindow;
+            InvalidateChildIndex(pChild);
             if (pChild == pWin)
                 return;
         }
@@ -1106,6 +1115,7 @@ DeleteWindow(void *value, XID wid)
             pWin->nextSib->prevSib = pWin->prevSib;
         if (pWin->prevSib)
             pWin->prevSib->nextSib = pWin->nextSib;
+        InvalidateChildIndex(pParent);
     }
     else
         pWin->drawable.pScreen->root = NULL;
@@ -1639,12 +1649,188 @@ GetWindowAttributes(WindowPtr pWin, ClientPtr client,
     wa->visualID = wVisual(pWin);
 }
 
+/*
+ * Child index
+ *
+ * Picking the window under the pointer walks the children of each level in
+ * stacking order.  Windows with many children get a coarse grid over the
+ * bounding boxes of all their children, mapped or not, in coordinates
+ * relative to the parent; each cell lists the children overlapping it,
+ * topmost first.  Mapping, shaping and unmapping leave the index valid
+ * since callers still test each candidate, but anything that changes a
+ * child's geometry or the stacking order throws it away.
+ */
+
+#define CHILD_INDEX_MAX_GRID    64
+#define CHILD_INDEX_BUDGET      4       /* cell entries per child */
+
+typedef struct _ChildIndex {
+    int x1, y1, x2, y2;         /* extent of the grid */
+    int cellWidth, cellHeight;
+    int grid;                   /* cells along each axis */
+    int *cellStart;             /* grid * grid + 1 offsets into children */
+    WindowPtr children[];
+} ChildIndexRec, *ChildIndexPtr;
+
+static inline void
+ChildIndexBox(WindowPtr pChild, BoxPtr box)
+{
+    int bw = wBorderWidth(pChild);
+
+    box->x1 = pChild->origin.x - bw;
+    box->y1 = pChild->origin.y - bw;
+    box->x2 = pChild->origin.x + (int) pChild->drawable.width + bw;
+    box->y2 = pChild->origin.y + (int) pChild->drawable.height + bw;
+}
+
+static size_t
+ChildIndexEntries(WindowPtr pParent, int x1, int y1, int cw, int ch)
+{
+    WindowPtr pChild;
+    size_t entries = 0;
+    BoxRec box;
+
+    for (pChild = pParent->firstChild; pChild; pChild = pChild->nextSib) {
+        ChildIndexBox(pChild, &box);
+        entries += (size_t) ((box.x2 - 1 - x1) / cw - (box.x1 - x1) / cw + 1) *
+            ((box.y2 - 1 - y1) / ch - (box.y1 - y1) / ch + 1);
+    }
+    return entries;
+}
+
+void
+InvalidateChildIndex(WindowPtr pParent)
+{
+    if (pParent && pParent->optional && pParent->optional->childIndex) {
+        free(pParent->optional->childIndex);
+        pParent->optional->childIndex = NULL;
+    }
+}
+
+/*
+ * Build the child index of pParent.  The grid starts at roughly one cell
+ * per child and is coarsened until large children, which land in many
+ * cells, fit in the entry budget.
+ */
+Bool
+BuildChildIndex(WindowPtr pParent)
+{
+    ChildIndexPtr idx;
+    WindowPtr pChild;
+    BoxRec box, extent = { 0, 0, 0, 0 };
+    int n = 0, grid, cw, ch, cells, i, col, row, c1, c2, r1, r2;
+    int *fill;
+    size_t entries;
+
+    InvalidateChildIndex(pParent);
+
+    for (pChild = pParent->firstChild; pChild; pChild = pChild->nextSib) {
+        ChildIndexBox(pChild, &box);
+        if (n++ == 0)
+            extent = box;
+        else {
+            extent.x1 = min(extent.x1, box.x1);
+            extent.y1 = min(extent.y1, box.y1);
+            extent.x2 = max(extent.x2, box.x2);
+            extent.y2 = max(extent.y2, box.y2);
+        }
+    }
+    if (n == 0)
+        return FALSE;
+
+    for (grid = 1; grid * grid < n && grid < CHILD_INDEX_MAX_GRID; grid <<= 1);
+    for (;;) {
+        cw = (extent.x2 - extent.x1 + grid - 1) / grid;
+        ch = (extent.y2 - extent.y1 + grid - 1) / grid;
+        entries = ChildIndexEntries(pParent, extent.x1, extent.y1, cw, ch);
+        if (grid == 1 || entries <= (size_t) n * CHILD_INDEX_BUDGET)
+            break;
+        grid >>= 1;
+    }
+    cells = grid * grid;
+
+    if (!MakeWindowOptional(pParent))
+        return FALSE;
+    idx = malloc(sizeof(ChildIndexRec) + entries * sizeof(WindowPtr) +
+                 (cells + 1) * sizeof(int));
+    fill = calloc(cells, sizeof(int));
+    if (!idx || !fill) {
+        free(idx);
+        free(fill);
+        return FALSE;
+    }
+    idx->x1 = extent.x1;
+    idx->y1 = extent.y1;
+    idx->x2 = extent.x2;
+    idx->y2 = extent.y2;
+    idx->cellWidth = cw;
+    idx->cellHeight = ch;
+    idx->grid = grid;
+    idx->cellStart = (int *) &idx->children[entries];
+
+    /* count the entries of each cell, then lay them out in stacking order */
+    for (pChild = pParent->firstChild; pChild; pChild = pChild->nextSib) {
+        ChildIndexBox(pChild, &box);
+        c1 = (box.x1 - extent.x1) / cw;
+        c2 = (box.x2 - 1 - extent.x1) / cw;
+        r1 = (box.y1 - extent.y1) / ch;
+        r2 = (box.y2 - 1 - extent.y1) / ch;
+        for (row = r1; row <= r2; row++)
+            for (col = c1; col <= c2; col++)
+                fill[row * grid + col]++;
+    }
+    idx->cellStart[0] = 0;
+    for (i = 0; i < cells; i++) {
+        idx->cellStart[i + 1] = idx->cellStart[i] + fill[i];
+        fill[i] = idx->cellStart[i];
+    }
+    for (pChild = pParent->firstChild; pChild; pChild = pChild->nextSib) {
+        ChildIndexBox(pChild, &box);
+        c1 = (box.x1 - extent.x1) / cw;
+        c2 = (box.x2 - 1 - extent.x1) / cw;
+        r1 = (box.y1 - extent.y1) / ch;
+        r2 = (box.y2 - 1 - extent.y1) / ch;
+        for (row = r1; row <= r2; row++)
+            for (col = c1; col <= c2; col++)
+                idx->children[fill[row * grid + col]++] = pChild;
+    }
+    free(fill);
+
+    pParent->optional->childIndex = idx;
+    return TRUE;
+}
+
+/*
+ * Return the children of pParent whose bounding box may contain the
+ * screen position x, y, topmost first.  pParent must have a child index.
+ */
+WindowPtr *
+ChildIndexLookup(WindowPtr pParent, int x, int y, int *count)
+{
+    ChildIndexPtr idx = pParent->optional->childIndex;
+    int cell;
+
+    x -= pParent->drawable.x;
+    y -= pParent->drawable.y;
+    if (x < idx->x1 || x >= idx->x2 || y < idx->y1 || y >= idx->y2) {
+        *count = 0;
+        return NULL;
+    }
+    cell = ((y - idx->y1) / idx->cellHeight) * idx->grid +
+        (x - idx->x1) / idx->cellWidth;
+    *count = idx->cellStart[cell + 1] - idx->cellStart[cell];
+    return &idx->children[idx->cellStart[cell]];
+}
+
 WindowPtr
 MoveWindowInStack(WindowPtr pWin, WindowPtr pNextSib)
 {
     WindowPtr pParent = pWin->parent;
     WindowPtr pFirstChange = pWin;      /* highest window where list changes */
 
+    /* called for every move, resize and restack of pWin */
+    InvalidateChildIndex(pParent);
+
     if (pWin->nextSib != pNextSib) {
         WindowPtr pOldNextSib = pWin->nextSib;
 
@@ -1879,6 +2065,7 @@ ResizeChildrenWinSize(WindowPtr pWin, int dx, int dy, int dw, int dh)
                 DeliverEvents(pSib, &event, 1, NullWindow);
                 pSib->origin.x = cwsx;
                 pSib->origin.y = cwsy;
+                InvalidateChildIndex(pWin);
             }
         }
         pSib->drawable.x = pWin->drawable.x + pSib->origin.x;
@@ -2409,6 +2596,7 @@ ConfigureWindow(WindowPtr pWin, Mask mask, XID *vlist, ClientPtr client)
                  (beforeX + wBorderWidth(pWin) == x + (int) bw) &&
                  (beforeY + wBorderWidth(pWin) == y + (int) bw)) {
             action = REBORDER_WIN;
+            InvalidateChildIndex(pWin->parent);
             (*pWin->drawable.pScreen->ChangeBorderWidth) (pWin, bw);
         }
         else
@@ -2580,6 +2768,9 @@ ReparentWindow(WindowPtr pWin, WindowPtr pParent,
         pParent->firstChild = pWin;
     }
 
+    InvalidateChildIndex(pPriorParent);
+    InvalidateChildIndex(pParent);
+
     pWin->origin.x = x + bw;
     pWin->origin.y = y + bw;
     pWin->drawable.x = x + bw + pParent->drawable.x;
@@ -3377,6 +3568,8 @@ CheckWindowOptionalNeed(WindowPtr w)
         return;
     if (optional->inputMasks != NULL)
         return;
+    if (optional->childIndex != NULL)
+        return;
     if (optional->deviceCursors != NULL) {
         DevCursNodePtr pNode = optional->deviceCursors;
 
@@ -3428,6 +3621,9 @@ MakeWindowOptional(WindowPtr pWin)
     optional->inputShape = NULL;
     optional->inputMasks = NULL;
     optional->deviceCursors = NULL;
+    optional->propIndex = NULL;
+    optional->childIndex = NULL;
+    optional->grabIndex = NULL;
 
     parentOptional = FindWindowWithOptional(pWin)->optional;
     optional->visual = parentOptional->visual;
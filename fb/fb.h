@@ -410,6 +410,16 @@ typedef struct {
 #endif
     DevPrivateKeyRec    gcPrivateKeyRec;
     DevPrivateKeyRec    winPrivateKeyRec;
+    DevPrivateKeyRec    pictPrivateKeyRec;
+    /* picture hooks wrapped to drop cached pixman images */
+    DestroyPictureProcPtr DestroyPicture;
+    ChangePictureClipProcPtr ChangePictureClip;
+    DestroyPictureClipProcPtr DestroyPictureClip;
+    ChangePictureProcPtr ChangePicture;
+    ValidatePictureProcPtr ValidatePicture;
+    ChangePictureTransformProcPtr ChangePictureTransform;
+    ChangePictureFilterProcPtr ChangePictureFilter;
+    DevPrivateKeyRec    pixmapPrivateKeyRec;
 } FbScreenPrivRec, *FbScreenPrivPtr;
 
 #define fbGetScreenPrivate(pScreen) ((FbScreenPrivPtr) \
@@ -429,6 +439,18 @@ typedef struct {
 				 dixLookupPrivate(&(pGC)->devPrivates, fbGetGCPrivateKey(pGC)))
 
 #define fbGetCompositeClip(pGC) ((pGC)->pCompositeClip)
+
+/* private field of pixmap */
+typedef struct {
+    void *map;                  /* data mapped apart from the pixmap */
+    size_t mapSize;
+} FbPixmapPrivRec, *FbPixmapPrivPtr;
+
+#define fbGetPixmapPrivateKey(pPixmap)  (&fbGetScreenPrivate((pPixmap)->drawable.pScreen)->pixmapPrivateKeyRec)
+
+#define fbGetPixmapPrivate(pPixmap)	((FbPixmapPrivPtr)\
+				 dixLookupPrivate(&(pPixmap)->devPrivates, fbGetPixmapPrivateKey(pPixmap)))
+
 #define fbGetExpose(pGC)	((pGC)->fExpose)
 
 #define fbGetScreenPixmap(s)	((PixmapPtr) (s)->devPrivate)
@@ -765,6 +787,11 @@ fbInitVisuals(VisualPtr * visualp,
  * fbcopy.c
  */
 
+extern _X_EXPORT Bool
+fbBltCopy(FbBits * src, FbStride srcStride, int srcBpp,
+          FbBits * dst, FbStride dstStride, int dstBpp,
+          int srcX, int srcY, int dstX, int dstY, int width, int height);
+
 extern _X_EXPORT void
 
 fbCopyNtoN(DrawablePtr pSrcDrawable,
@@ -966,6 +993,9 @@ fbCreatePixmap(ScreenPtr pScreen, int width, int height, int depth,
 extern _X_EXPORT Bool
  fbDestroyPixmap(PixmapPtr pPixmap);
 
+extern _X_EXPORT void
+fbDestroyPixmapCache(void);
+
 extern _X_EXPORT RegionPtr
  fbPixmapToRegion(PixmapPtr pPix);
 
@@ -1097,6 +1127,18 @@ fbSolid(FbBits * dst,
         FbStride dstStride,
         int dstX, int bpp, int width, int height, FbBits and, FbBits xor);
 
+/*
+ * fbthread.c
+ */
+
+typedef void (*FbBandProcPtr) (void *closure, int band, int nbands);
+
+extern _X_EXPORT int
+ fbBandCount(int width, int height);
+
+extern _X_EXPORT void
+ fbRunBands(int nbands, FbBandProcPtr proc, void *closure);
+
 /*
  * fbutil.c
  */
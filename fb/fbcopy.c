@@ -24,10 +24,89 @@
 #include <dix-config.h>
 #endif
 
+#include <stdint.h>
 #include <stdlib.h>
 
 #include "fb.h"
 
+#ifndef FB_ACCESS_WRAPPER
+typedef struct {
+    FbBits *src, *dst;
+    FbStride srcStride, dstStride;
+    int srcBpp, dstBpp;
+    int srcX, srcY, dstX, dstY, width, height;
+} FbBltBandsRec;
+
+static void
+fbBltBand(void *closure, int band, int nbands)
+{
+    FbBltBandsRec *blt = closure;
+    int y1 = blt->height * band / nbands;
+    int y2 = blt->height * (band + 1) / nbands;
+
+    if (!pixman_blt((uint32_t *) blt->src, (uint32_t *) blt->dst,
+                    blt->srcStride, blt->dstStride, blt->srcBpp, blt->dstBpp,
+                    blt->srcX, blt->srcY + y1, blt->dstX, blt->dstY + y1,
+                    blt->width, y2 - y1))
+        fbBlt(blt->src + (blt->srcY + y1) * blt->srcStride, blt->srcStride,
+              blt->srcX * blt->srcBpp,
+              blt->dst + (blt->dstY + y1) * blt->dstStride, blt->dstStride,
+              blt->dstX * blt->dstBpp, blt->width * blt->dstBpp, y2 - y1,
+              GXcopy, FB_ALLONES, blt->dstBpp, FALSE, FALSE);
+}
+
+/*
+ * Split large copies between different pixmaps across the render
+ * threads.  Copies within one pixmap may overlap, and then the order of
+ * the rows matters.
+ */
+static Bool
+fbBltBands(FbBits * src, FbBits * dst, FbStride srcStride,
+           FbStride dstStride, int srcBpp, int dstBpp,
+           int srcX, int srcY, int dstX, int dstY, int width, int height)
+{
+    FbBltBandsRec blt = {
+        .src = src, .dst = dst,
+        .srcStride = srcStride, .dstStride = dstStride,
+        .srcBpp = srcBpp, .dstBpp = dstBpp,
+        .srcX = srcX, .srcY = srcY, .dstX = dstX, .dstY = dstY,
+        .width = width, .height = height,
+    };
+    int nbands;
+
+    if (src == dst || srcBpp != dstBpp)
+        return FALSE;
+    nbands = fbBandCount(width, height);
+    if (nbands <= 1)
+        return FALSE;
+    fbRunBands(nbands, fbBltBand, &blt);
+    return TRUE;
+}
+#endif
+
+/*
+ * Plain copy of a rectangle with GXcopy and all planes, using the render
+ * threads or pixman's SIMD blitter.  Returns FALSE when neither applies,
+ * and the caller then falls back to fbBlt.
+ */
+Bool
+fbBltCopy(FbBits * src, FbStride srcStride, int srcBpp,
+          FbBits * dst, FbStride dstStride, int dstBpp,
+          int srcX, int srcY, int dstX, int dstY, int width, int height)
+{
+#ifndef FB_ACCESS_WRAPPER       /* pixman_blt() doesn't support accessors yet */
+    if (((uintptr_t) src | (uintptr_t) dst) & (sizeof(FbBits) - 1))
+        return FALSE;
+    if (fbBltBands(src, dst, srcStride, dstStride, srcBpp, dstBpp,
+                   srcX, srcY, dstX, dstY, width, height))
+        return TRUE;
+    return pixman_blt((uint32_t *) src, (uint32_t *) dst, srcStride, dstStride,
+                      srcBpp, dstBpp, srcX, srcY, dstX, dstY, width, height);
+#else
+    return FALSE;
+#endif
+}
+
 void
 fbCopyNtoN(DrawablePtr pSrcDrawable,
            DrawablePtr pDstDrawable,
@@ -52,20 +131,12 @@ fbCopyNtoN(DrawablePtr pSrcDrawable,
     fbGetDrawable(pDstDrawable, dst, dstStride, dstBpp, dstXoff, dstYoff);
 
     while (nbox--) {
-#ifndef FB_ACCESS_WRAPPER       /* pixman_blt() doesn't support accessors yet */
-        if (pm == FB_ALLONES && alu == GXcopy && !reverse && !upsidedown) {
-            if (!pixman_blt
-                ((uint32_t *) src, (uint32_t *) dst, srcStride, dstStride,
-                 srcBpp, dstBpp, (pbox->x1 + dx + srcXoff),
-                 (pbox->y1 + dy + srcYoff), (pbox->x1 + dstXoff),
-                 (pbox->y1 + dstYoff), (pbox->x2 - pbox->x1),
-                 (pbox->y2 - pbox->y1)))
-                goto fallback;
-            else
-                goto next;
-        }
- fallback:
-#endif
+        if (pm == FB_ALLONES && alu == GXcopy && !reverse && !upsidedown &&
+            fbBltCopy(src, srcStride, srcBpp, dst, dstStride, dstBpp,
+                      (pbox->x1 + dx + srcXoff), (pbox->y1 + dy + srcYoff),
+                      (pbox->x1 + dstXoff), (pbox->y1 + dstYoff),
+                      (pbox->x2 - pbox->x1), (pbox->y2 - pbox->y1)))
+            goto next;
         fbBlt(src + (pbox->y1 + dy + srcYoff) * srcStride,
               srcStride,
               (pbox->x1 + dx + srcXoff) * srcBpp,
@@ -74,9 +145,7 @@ fbCopyNtoN(DrawablePtr pSrcDrawable,
               (pbox->x1 + dstXoff) * dstBpp,
               (pbox->x2 - pbox->x1) * dstBpp,
               (pbox->y2 - pbox->y1), alu, pm, dstBpp, reverse, upsidedown);
-#ifndef FB_ACCESS_WRAPPER
  next:
-#endif
         pbox++;
     }
     fbFinishAccess(pDstDrawable);
@@ -108,6 +108,47 @@ fbStipple(FbBits * dst, FbStride dstStride,
     }
 }
 
+#ifndef FB_ACCESS_WRAPPER
+typedef struct {
+    FbBits *dst;
+    FbStride dstStride;
+    int bpp;
+    int x, y, width, height;
+    FbBits xor;
+} FbFillBandsRec;
+
+static void
+fbFillBand(void *closure, int band, int nbands)
+{
+    FbFillBandsRec *fill = closure;
+    int y1 = fill->height * band / nbands;
+    int y2 = fill->height * (band + 1) / nbands;
+
+    if (!pixman_fill((uint32_t *) fill->dst, fill->dstStride, fill->bpp,
+                     fill->x, fill->y + y1, fill->width, y2 - y1, fill->xor))
+        fbSolid(fill->dst + (fill->y + y1) * fill->dstStride,
+                fill->dstStride, fill->x * fill->bpp, fill->bpp,
+                fill->width * fill->bpp, y2 - y1, 0, fill->xor);
+}
+
+/* Split large solid fills across the render threads */
+static Bool
+fbFillBands(FbBits * dst, FbStride dstStride, int bpp,
+            int x, int y, int width, int height, FbBits xor)
+{
+    FbFillBandsRec fill = {
+        .dst = dst, .dstStride = dstStride, .bpp = bpp,
+        .x = x, .y = y, .width = width, .height = height, .xor = xor,
+    };
+    int nbands = fbBandCount(width, height);
+
+    if (nbands <= 1)
+        return FALSE;
+    fbRunBands(nbands, fbFillBand, &fill);
+    return TRUE;
+}
+#endif
+
 void
 fbFill(DrawablePtr pDrawable, GCPtr pGC, int x, int y, int width, int height)
 {
@@ -122,6 +163,10 @@ fbFill(DrawablePtr pDrawable, GCPtr pGC, int x, int y, int width, int height)
     switch (pGC->fillStyle) {
     case FillSolid:
 #ifndef FB_ACCESS_WRAPPER
+        if (!pPriv->and && fbFillBands(dst, dstStride, dstBpp,
+                                       x + dstXoff, y + dstYoff,
+                                       width, height, pPriv->xor))
+            break;
         if (pPriv->and || !pixman_fill((uint32_t *) dst, dstStride, dstBpp,
                                        x + dstXoff, y + dstYoff,
                                        width, height, pPriv->xor))
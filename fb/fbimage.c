@@ -108,6 +108,13 @@ fbPutZImage(DrawablePtr pDrawable,
             y2 = pbox->y2;
         if (x1 >= x2 || y1 >= y2)
             continue;
+        if (alu == GXcopy && pm == FB_ALLONES &&
+            fbBltCopy((FbBits *) src, FbStipStrideToBitsStride(srcStride),
+                      dstBpp, (FbBits *) dst,
+                      FbStipStrideToBitsStride(dstStride), dstBpp,
+                      x1 - x, y1 - y, x1 + dstXoff, y1 + dstYoff,
+                      x2 - x1, y2 - y1))
+            continue;
         fbBltStip(src + (y1 - y) * srcStride,
                   srcStride,
                   (x1 - x) * dstBpp,
@@ -234,10 +241,14 @@ fbGetImage(DrawablePtr pDrawable,
         pm = fbReplicatePixel(planeMask, srcBpp);
         dstStride = PixmapBytePad(w, pDrawable->depth);
         dstStride /= sizeof(FbStip);
-        fbBltStip((FbStip *) (src + (y + srcYoff) * srcStride),
-                  FbBitsStrideToStipStride(srcStride),
-                  (x + srcXoff) * srcBpp,
-                  dst, dstStride, 0, w * srcBpp, h, GXcopy, FB_ALLONES, srcBpp);
+        if (!fbBltCopy(src, srcStride, srcBpp, (FbBits *) dst,
+                       FbStipStrideToBitsStride(dstStride), srcBpp,
+                       x + srcXoff, y + srcYoff, 0, 0, w, h))
+            fbBltStip((FbStip *) (src + (y + srcYoff) * srcStride),
+                      FbBitsStrideToStipStride(srcStride),
+                      (x + srcXoff) * srcBpp,
+                      dst, dstStride, 0, w * srcBpp, h, GXcopy, FB_ALLONES,
+                      srcBpp);
 
         if (pm != FB_ALLONES) {
             for (int i = 0; i < dstStride * h; i++)
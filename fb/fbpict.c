@@ -35,6 +35,106 @@
 #include "mipict.h"
 #include "fbpict.h"
 
+static pixman_image_t *cached_image_from_pict(PicturePtr pict, Bool has_clip,
+                                              int *xoff, int *yoff);
+
+/*
+ * Large composites are split into bands of destination rows drawn by the
+ * render threads.  Each band gets pixman images of its own, made here on
+ * the main thread, since pixman updates image state while compositing.
+ */
+
+#define FB_COMPOSITE_MAX_BANDS  64
+
+typedef struct {
+    CARD8 op;
+    pixman_image_t *src[FB_COMPOSITE_MAX_BANDS];
+    pixman_image_t *mask[FB_COMPOSITE_MAX_BANDS];
+    pixman_image_t *dest[FB_COMPOSITE_MAX_BANDS];
+    int xSrc, ySrc, xMask, yMask, xDst, yDst;
+    int width, height;
+} FbCompositeBandsRec;
+
+static PixmapPtr
+fbPicturePixmap(PicturePtr pict)
+{
+    PixmapPtr pixmap;
+    _X_UNUSED int xoff, yoff;
+
+    if (!pict || !pict->pDrawable)
+        return NULL;
+    fbGetDrawablePixmap(pict->pDrawable, pixmap, xoff, yoff);
+    return pixmap;
+}
+
+static int
+fbCompositeBandCount(PicturePtr pSrc, PicturePtr pMask, PicturePtr pDst,
+                     int width, int height)
+{
+    int nbands = fbBandCount(width, height);
+    PixmapPtr dst;
+
+    if (nbands <= 1)
+        return 1;
+
+    /* bands drawn out of order would see each other's results */
+    dst = fbPicturePixmap(pDst);
+    if (fbPicturePixmap(pSrc) == dst || (pMask && fbPicturePixmap(pMask) == dst))
+        return 1;
+    if (pSrc->alphaMap || (pMask && pMask->alphaMap) || pDst->alphaMap)
+        return 1;
+
+    return min(nbands, FB_COMPOSITE_MAX_BANDS);
+}
+
+static void
+fbCompositeBand(void *closure, int band, int nbands)
+{
+    FbCompositeBandsRec *bands = closure;
+    int y1 = bands->height * band / nbands;
+    int y2 = bands->height * (band + 1) / nbands;
+
+    pixman_image_composite(bands->op, bands->src[band], bands->mask[band],
+                           bands->dest[band],
+                           bands->xSrc, bands->ySrc + y1,
+                           bands->xMask, bands->yMask + y1,
+                           bands->xDst, bands->yDst + y1,
+                           bands->width, y2 - y1);
+}
+
+static void
+fbCompositeBands(FbCompositeBandsRec *bands, int nbands,
+                 pixman_image_t *src, pixman_image_t *mask,
+                 pixman_image_t *dest,
+                 PicturePtr pSrc, PicturePtr pMask, PicturePtr pDst)
+{
+    int i, n, xoff, yoff;
+
+    bands->src[0] = src;
+    bands->mask[0] = mask;
+    bands->dest[0] = dest;
+    for (n = 1; n < nbands; n++) {
+        bands->src[n] = image_from_pict(pSrc, FALSE, &xoff, &yoff);
+        bands->mask[n] = image_from_pict(pMask, FALSE, &xoff, &yoff);
+        bands->dest[n] = image_from_pict(pDst, TRUE, &xoff, &yoff);
+        if (!bands->src[n] || !bands->dest[n] || (pMask && !bands->mask[n])) {
+            free_pixman_pict(pSrc, bands->src[n]);
+            free_pixman_pict(pMask, bands->mask[n]);
+            free_pixman_pict(pDst, bands->dest[n]);
+            break;
+        }
+    }
+
+    /* n bands have images; the rows are spread over those */
+    fbRunBands(n, fbCompositeBand, bands);
+
+    for (i = 1; i < n; i++) {
+        free_pixman_pict(pSrc, bands->src[i]);
+        free_pixman_pict(pMask, bands->mask[i]);
+        free_pixman_pict(pDst, bands->dest[i]);
+    }
+}
+
 void
 fbComposite(CARD8 op,
             PicturePtr pSrc,
@@ -54,15 +154,28 @@ fbComposite(CARD8 op,
     if (pMask)
         miCompositeSourceValidate(pMask);
 
-    src = image_from_pict(pSrc, FALSE, &src_xoff, &src_yoff);
-    mask = image_from_pict(pMask, FALSE, &msk_xoff, &msk_yoff);
-    dest = image_from_pict(pDst, TRUE, &dst_xoff, &dst_yoff);
+    src = cached_image_from_pict(pSrc, FALSE, &src_xoff, &src_yoff);
+    mask = cached_image_from_pict(pMask, FALSE, &msk_xoff, &msk_yoff);
+    dest = cached_image_from_pict(pDst, TRUE, &dst_xoff, &dst_yoff);
 
     if (src && dest && !(pMask && !mask)) {
-        pixman_image_composite(op, src, mask, dest,
-                               xSrc + src_xoff, ySrc + src_yoff,
-                               xMask + msk_xoff, yMask + msk_yoff,
-                               xDst + dst_xoff, yDst + dst_yoff, width, height);
+        FbCompositeBandsRec bands = {
+            .op = op,
+            .xSrc = xSrc + src_xoff, .ySrc = ySrc + src_yoff,
+            .xMask = xMask + msk_xoff, .yMask = yMask + msk_yoff,
+            .xDst = xDst + dst_xoff, .yDst = yDst + dst_yoff,
+            .width = width, .height = height,
+        };
+        int nbands = fbCompositeBandCount(pSrc, pMask, pDst, width, height);
+
+        if (nbands > 1)
+            fbCompositeBands(&bands, nbands, src, mask, dest,
+                             pSrc, pMask, pDst);
+        else
+            pixman_image_composite(op, src, mask, dest,
+                                   bands.xSrc, bands.ySrc,
+                                   bands.xMask, bands.yMask,
+                                   bands.xDst, bands.yDst, width, height);
     }
 
     free_pixman_pict(pSrc, src);
@@ -72,24 +185,387 @@ fbComposite(CARD8 op,
 
 static pixman_glyph_cache_t *glyphCache;
 
+/*
+ * Glyphs drawn through an a8 or a8r8g8b8 mask are also copied into atlas
+ * pages, a8 for alpha-only glyphs and a8r8g8b8 for colour ones.  When all
+ * the glyphs of a call sit in pages of the mask format, the mask is built
+ * by adding rows straight from the pages, and pixman only runs for the
+ * final composite.  A glyph keeps its place until it is unrealized,
+ * which -glyphmem also does when it evicts the glyph's pictures.
+ *
+ * Pages are filled shelf by shelf and never compacted.  A page that is
+ * no longer being filled is freed once its last glyph is gone, or once
+ * fewer than a quarter of the glyphs it took are left; those are copied
+ * into the open page again the next time they are drawn.
+ */
+
+#define FB_GLYPH_ATLAS_SIZE     512
+#define FB_GLYPH_ATLAS_MAX      128     /* larger glyphs stay out */
+
+typedef struct _FbGlyphAtlas {
+    pixman_image_t *image;
+    int x, y;                   /* next free spot on the open shelf */
+    int shelf;                  /* height of the open shelf */
+    int glyphs;                 /* glyphs still in the page */
+    int placed;                 /* glyphs ever put in the page */
+    struct xorg_list privs;     /* FbGlyphPrivRec of the glyphs in it */
+} FbGlyphAtlasRec, *FbGlyphAtlasPtr;
+
+typedef struct {
+    FbGlyphAtlasPtr atlas;      /* NULL until first drawn through a mask */
+    int x, y;
+    struct xorg_list entry;     /* in atlas->privs */
+} FbGlyphPrivRec, *FbGlyphPrivPtr;
+
+static DevPrivateKeyRec fbGlyphPrivateKeyRec;
+
+static const pixman_format_code_t fbGlyphAtlasFormats[] = {
+    PIXMAN_a8, PIXMAN_a8r8g8b8
+};
+
+/* Pages being filled, one per format above */
+static FbGlyphAtlasPtr fbGlyphAtlas[ARRAY_SIZE(fbGlyphAtlasFormats)];
+
+static int
+fbGlyphAtlasIndex(CARD32 format)
+{
+    switch (format) {
+    case PICT_a1:
+    case PICT_a4:
+    case PICT_a8:
+        return 0;
+    case PICT_a8r8g8b8:
+        return 1;
+    default:
+        return -1;
+    }
+}
+
+static Bool
+fbGlyphAtlasOpen(FbGlyphAtlasPtr atlas)
+{
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(fbGlyphAtlas); i++)
+        if (fbGlyphAtlas[i] == atlas)
+            return TRUE;
+    return FALSE;
+}
+
+static Bool
+fbGlyphAtlasInUse(FbGlyphAtlasPtr atlas)
+{
+    return atlas->glyphs || fbGlyphAtlasOpen(atlas);
+}
+
+static void
+fbGlyphAtlasFree(FbGlyphAtlasPtr atlas)
+{
+    pixman_image_unref(atlas->image);
+    free(atlas);
+}
+
+static void
+fbGlyphAtlasRelease(FbGlyphAtlasPtr atlas)
+{
+    FbGlyphPrivPtr priv, tmp;
+
+    atlas->glyphs--;
+    if (fbGlyphAtlasOpen(atlas))
+        return;
+
+    /* Give up a closed page that is empty or mostly holes */
+    if (atlas->glyphs * 4 < atlas->placed) {
+        xorg_list_for_each_entry_safe(priv, tmp, &atlas->privs, entry) {
+            xorg_list_del(&priv->entry);
+            priv->atlas = NULL;
+        }
+        fbGlyphAtlasFree(atlas);
+    }
+}
+
+static FbGlyphAtlasPtr
+fbGlyphAtlasAlloc(int index, int width, int height, int *x, int *y)
+{
+    FbGlyphAtlasPtr atlas = fbGlyphAtlas[index];
+
+    if (atlas && atlas->x + width > FB_GLYPH_ATLAS_SIZE) {
+        atlas->x = 0;
+        atlas->y += atlas->shelf;
+        atlas->shelf = 0;
+    }
+    if (atlas && atlas->y + height > FB_GLYPH_ATLAS_SIZE) {
+        fbGlyphAtlas[index] = NULL;
+        if (!fbGlyphAtlasInUse(atlas))
+            fbGlyphAtlasFree(atlas);
+        atlas = NULL;
+    }
+    if (!atlas) {
+        atlas = calloc(1, sizeof(FbGlyphAtlasRec));
+        if (!atlas)
+            return NULL;
+        atlas->image = pixman_image_create_bits(fbGlyphAtlasFormats[index],
+                                                FB_GLYPH_ATLAS_SIZE,
+                                                FB_GLYPH_ATLAS_SIZE,
+                                                NULL, 0);
+        if (!atlas->image) {
+            free(atlas);
+            return NULL;
+        }
+        xorg_list_init(&atlas->privs);
+        fbGlyphAtlas[index] = atlas;
+    }
+
+    *x = atlas->x;
+    *y = atlas->y;
+    atlas->x += width;
+    if (atlas->shelf < height)
+        atlas->shelf = height;
+    atlas->glyphs++;
+    atlas->placed++;
+    return atlas;
+}
+
+/*
+ * Find the glyph in the atlas, copying it in from its picture first if
+ * it is not there yet.  NULL if the glyph cannot be kept in a page.
+ */
+static FbGlyphPrivPtr
+fbGlyphAtlasLookup(GlyphPtr glyph, ScreenPtr pScreen)
+{
+    FbGlyphPrivPtr priv = dixGetPrivateAddr(&glyph->devPrivates,
+                                            &fbGlyphPrivateKeyRec);
+    int width = glyph->info.width, height = glyph->info.height;
+    pixman_image_t *glyphImage;
+    PicturePtr pPicture;
+    FbGlyphAtlasPtr atlas;
+    int index, xoff, yoff;
+
+    if (priv->atlas)
+        return priv;
+
+    pPicture = GetGlyphPicture(glyph, pScreen);
+    if (!pPicture ||
+        width > FB_GLYPH_ATLAS_MAX || height > FB_GLYPH_ATLAS_MAX)
+        return NULL;
+    index = fbGlyphAtlasIndex(pPicture->format);
+    if (index < 0)
+        return NULL;
+
+    atlas = fbGlyphAtlasAlloc(index, width, height, &priv->x, &priv->y);
+    if (!atlas)
+        return NULL;
+    if (!(glyphImage = image_from_pict(pPicture, FALSE, &xoff, &yoff))) {
+        fbGlyphAtlasRelease(atlas);
+        return NULL;
+    }
+    pixman_image_composite32(PIXMAN_OP_SRC, glyphImage, NULL, atlas->image,
+                             xoff, yoff, 0, 0, priv->x, priv->y,
+                             width, height);
+    free_pixman_pict(pPicture, glyphImage);
+
+    priv->atlas = atlas;
+    xorg_list_add(&priv->entry, &atlas->privs);
+    return priv;
+}
+
 void
 fbDestroyGlyphCache(void)
 {
+    int i;
+
     if (glyphCache)
     {
 	pixman_glyph_cache_destroy (glyphCache);
 	glyphCache = NULL;
     }
+
+    for (i = 0; i < ARRAY_SIZE(fbGlyphAtlas); i++) {
+        FbGlyphAtlasPtr atlas = fbGlyphAtlas[i];
+
+        fbGlyphAtlas[i] = NULL;
+        if (atlas && !fbGlyphAtlasInUse(atlas))
+            fbGlyphAtlasFree(atlas);
+    }
 }
 
 static void
 fbUnrealizeGlyph(ScreenPtr pScreen,
 		 GlyphPtr pGlyph)
 {
+    FbGlyphPrivPtr priv = dixGetPrivateAddr(&pGlyph->devPrivates,
+                                            &fbGlyphPrivateKeyRec);
+
+    if (priv->atlas) {
+        xorg_list_del(&priv->entry);
+        fbGlyphAtlasRelease(priv->atlas);
+        priv->atlas = NULL;
+    }
+
     if (glyphCache)
 	pixman_glyph_cache_remove (glyphCache, pGlyph, NULL);
 }
 
+#define N_STACK_GLYPHS 512
+
+typedef struct {
+    FbGlyphPrivPtr priv;
+    int x, y;
+    int width, height;
+} FbGlyphRunRec;
+
+/* Compilers turn this into saturating SIMD adds. */
+static void
+fbGlyphAdd(CARD8 *dst, int dstStride, const CARD8 *src, int srcStride,
+           int bytes, int height)
+{
+    int i;
+
+    while (height--) {
+        for (i = 0; i < bytes; i++) {
+            unsigned int t = dst[i] + src[i];
+
+            dst[i] = t > 0xff ? 0xff : t;
+        }
+        dst += dstStride;
+        src += srcStride;
+    }
+}
+
+/*
+ * Draw the glyphs through the mask built from the atlas.  FALSE, before
+ * anything is drawn, if some glyph is not in a page of the mask format.
+ */
+static Bool
+fbGlyphsFromAtlas(CARD8 op,
+                  PicturePtr pSrc,
+                  PicturePtr pDst,
+                  PictFormatPtr maskFormat,
+                  INT16 xSrc,
+                  INT16 ySrc, int nlist,
+                  GlyphListPtr list,
+                  GlyphPtr *glyphs)
+{
+    ScreenPtr pScreen = pDst->pDrawable->pScreen;
+    FbGlyphRunRec stack_run[N_STACK_GLYPHS];
+    FbGlyphRunRec *run = stack_run;
+    pixman_image_t *srcImage, *dstImage, *mask;
+    int srcXoff, srcYoff, dstXoff, dstYoff;
+    int xDst = list->xOff, yDst = list->yOff;
+    int x1 = MAXSHORT, y1 = MAXSHORT, x2 = MINSHORT, y2 = MINSHORT;
+    int index, bpp, n_glyphs, width, height;
+    CARD8 *maskBits;
+    int maskStride;
+    GlyphPtr glyph;
+    Bool done = FALSE;
+    int x, y, i, n;
+
+    if (maskFormat->format == PICT_a8)
+        index = 0;
+    else if (maskFormat->format == PICT_a8r8g8b8)
+        index = 1;
+    else
+        return FALSE;
+    bpp = PIXMAN_FORMAT_BPP(fbGlyphAtlasFormats[index]) / 8;
+
+    n_glyphs = 0;
+    for (i = 0; i < nlist; i++)
+        n_glyphs += list[i].len;
+    if (n_glyphs > N_STACK_GLYPHS &&
+        !(run = xallocarray(n_glyphs, sizeof(FbGlyphRunRec))))
+        return FALSE;
+
+    i = 0;
+    x = y = 0;
+    while (nlist--) {
+        x += list->xOff;
+        y += list->yOff;
+        n = list->len;
+        list++;
+        while (n--) {
+            glyph = *glyphs++;
+
+            if (glyph->info.width && glyph->info.height) {
+                FbGlyphPrivPtr priv = fbGlyphAtlasLookup(glyph, pScreen);
+
+                if (!priv) {
+                    if (GetGlyphPicture(glyph, pScreen))
+                        goto out;
+                    goto next;
+                }
+                if (pixman_image_get_format(priv->atlas->image) !=
+                    fbGlyphAtlasFormats[index])
+                    goto out;
+
+                run[i].priv = priv;
+                run[i].x = x - glyph->info.x;
+                run[i].y = y - glyph->info.y;
+                run[i].width = glyph->info.width;
+                run[i].height = glyph->info.height;
+                x1 = min(x1, run[i].x);
+                y1 = min(y1, run[i].y);
+                x2 = max(x2, run[i].x + run[i].width);
+                y2 = max(y2, run[i].y + run[i].height);
+                i++;
+            }
+
+        next:
+            x += glyph->info.xOff;
+            y += glyph->info.yOff;
+        }
+    }
+
+    if (!i) {
+        done = TRUE;
+        goto out;
+    }
+
+    width = x2 - x1;
+    height = y2 - y1;
+    mask = pixman_image_create_bits(fbGlyphAtlasFormats[index],
+                                    width, height, NULL, 0);
+    if (!mask)
+        goto out;
+    done = TRUE;
+    if (PICT_FORMAT_RGB(maskFormat->format))
+        pixman_image_set_component_alpha(mask, TRUE);
+    maskBits = (CARD8 *) pixman_image_get_data(mask);
+    maskStride = pixman_image_get_stride(mask);
+
+    n_glyphs = i;
+    for (i = 0; i < n_glyphs; i++) {
+        FbGlyphPrivPtr priv = run[i].priv;
+        pixman_image_t *page = priv->atlas->image;
+        int pageStride = pixman_image_get_stride(page);
+        CARD8 *pageBits = (CARD8 *) pixman_image_get_data(page);
+
+        fbGlyphAdd(maskBits + (run[i].y - y1) * maskStride +
+                   (run[i].x - x1) * bpp, maskStride,
+                   pageBits + priv->y * pageStride + priv->x * bpp,
+                   pageStride, run[i].width * bpp, run[i].height);
+    }
+
+    if ((srcImage = cached_image_from_pict(pSrc, FALSE, &srcXoff, &srcYoff))) {
+        if ((dstImage = cached_image_from_pict(pDst, TRUE,
+                                               &dstXoff, &dstYoff))) {
+            pixman_image_composite32(op, srcImage, mask, dstImage,
+                                     xSrc + srcXoff + x1 - xDst,
+                                     ySrc + srcYoff + y1 - yDst,
+                                     0, 0,
+                                     x1 + dstXoff, y1 + dstYoff,
+                                     width, height);
+            free_pixman_pict(pDst, dstImage);
+        }
+        free_pixman_pict(pSrc, srcImage);
+    }
+    pixman_image_unref(mask);
+
+ out:
+    if (run != stack_run)
+        free(run);
+    return done;
+}
+
 void
 fbGlyphs(CARD8 op,
 	 PicturePtr pSrc,
@@ -100,7 +576,6 @@ fbGlyphs(CARD8 op,
 	 GlyphListPtr list,
 	 GlyphPtr *glyphs)
 {
-#define N_STACK_GLYPHS 512
     ScreenPtr pScreen = pDst->pDrawable->pScreen;
     pixman_glyph_t stack_glyphs[N_STACK_GLYPHS];
     pixman_glyph_t *pglyphs = stack_glyphs;
@@ -114,6 +589,10 @@ fbGlyphs(CARD8 op,
 
     miCompositeSourceValidate(pSrc);
 
+    if (maskFormat && fbGlyphsFromAtlas(op, pSrc, pDst, maskFormat,
+                                        xSrc, ySrc, nlist, list, glyphs))
+        return;
+
     n_glyphs = 0;
     for (i = 0; i < nlist; ++i)
 	n_glyphs += list[i].len;
@@ -176,10 +655,10 @@ fbGlyphs(CARD8 op,
 	list++;
     }
 
-    if (!(srcImage = image_from_pict(pSrc, FALSE, &srcXoff, &srcYoff)))
+    if (!(srcImage = cached_image_from_pict(pSrc, FALSE, &srcXoff, &srcYoff)))
 	goto out;
 
-    if (!(dstImage = image_from_pict(pDst, TRUE, &dstXoff, &dstYoff)))
+    if (!(dstImage = cached_image_from_pict(pDst, TRUE, &dstXoff, &dstYoff)))
 	goto out_free_src;
 
     if (maskFormat) {
@@ -484,12 +963,181 @@ free_pixman_pict(PicturePtr pict, pixman_image_t * image)
         pixman_image_unref(image);
 }
 
+/*
+ * Images for pictures with drawables are kept between requests, one for
+ * use as a source and one for use as the destination.  The picture state
+ * baked into them is covered by the ChangePicture, clip, transform, filter
+ * and ValidatePicture hooks below, which drop them; the pixmap geometry is
+ * compared on every use, which catches windows being redirected and
+ * pixmaps being resized underneath the picture.
+ */
+
+typedef struct _fbPictureImage {
+    pixman_image_t *image;
+    PixmapPtr pixmap;
+    FbBits *bits;
+    int stride;
+    int width, height;
+    int x, y;                   /* pixmap offset plus drawable origin */
+    int xoff, yoff;             /* offsets returned with the image */
+} FbPictureImageRec, *FbPictureImagePtr;
+
+typedef struct _fbPicturePriv {
+    FbPictureImageRec image[2]; /* indexed by has_clip */
+} FbPicturePrivRec, *FbPicturePrivPtr;
+
+#define fbGetPicturePriv(pict) ((FbPicturePrivPtr) \
+    dixLookupPrivate(&(pict)->devPrivates, \
+                     &fbGetScreenPrivate((pict)->pDrawable->pScreen)->pictPrivateKeyRec))
+
+static void
+fbFlushPictureImages(PicturePtr pict)
+{
+    FbPicturePrivPtr priv;
+    int i;
+
+    if (!pict->pDrawable)
+        return;
+    priv = fbGetPicturePriv(pict);
+    for (i = 0; i < 2; i++) {
+        if (priv->image[i].image) {
+            pixman_image_unref(priv->image[i].image);
+            priv->image[i].image = NULL;
+        }
+    }
+}
+
+/*
+ * Like image_from_pict, but hands out a new reference to the cached image
+ * when nothing it depends on has changed.  The result is released with
+ * free_pixman_pict as usual.
+ */
+static pixman_image_t *
+cached_image_from_pict(PicturePtr pict, Bool has_clip, int *xoff, int *yoff)
+{
+#ifndef FB_ACCESS_WRAPPER
+    FbPictureImagePtr cache;
+    PixmapPtr pixmap;
+    FbBits *bits;
+    FbStride stride;
+    int bpp, x, y;
+
+    /* the alpha map's state is baked in too, and it has no hooks of ours */
+    if (!pict || !pict->pDrawable || pict->alphaMap)
+        return image_from_pict(pict, has_clip, xoff, yoff);
+
+    fbGetDrawablePixmap(pict->pDrawable, pixmap, x, y);
+    fbGetPixmapBitsData(pixmap, bits, stride, bpp);
+    x += pict->pDrawable->x;
+    y += pict->pDrawable->y;
+
+    cache = &fbGetPicturePriv(pict)->image[has_clip ? 1 : 0];
+    if (!cache->image || cache->pixmap != pixmap || cache->bits != bits ||
+        cache->stride != stride || cache->width != pixmap->drawable.width ||
+        cache->height != pixmap->drawable.height ||
+        cache->x != x || cache->y != y) {
+        if (cache->image)
+            pixman_image_unref(cache->image);
+        cache->image = image_from_pict(pict, has_clip,
+                                       &cache->xoff, &cache->yoff);
+        if (!cache->image)
+            return NULL;
+        cache->pixmap = pixmap;
+        cache->bits = bits;
+        cache->stride = stride;
+        cache->width = pixmap->drawable.width;
+        cache->height = pixmap->drawable.height;
+        cache->x = x;
+        cache->y = y;
+    }
+
+    *xoff = cache->xoff;
+    *yoff = cache->yoff;
+    return pixman_image_ref(cache->image);
+#else
+    return image_from_pict(pict, has_clip, xoff, yoff);
+#endif
+}
+
+static void
+fbDestroyPicture(PicturePtr pPicture)
+{
+    FbScreenPrivPtr pScrPriv = fbGetScreenPrivate(pPicture->pDrawable->pScreen);
+
+    fbFlushPictureImages(pPicture);
+    (*pScrPriv->DestroyPicture) (pPicture);
+}
+
+static int
+fbChangePictureClip(PicturePtr pPicture, int type, void *value, int n)
+{
+    FbScreenPrivPtr pScrPriv = fbGetScreenPrivate(pPicture->pDrawable->pScreen);
+
+    fbFlushPictureImages(pPicture);
+    return (*pScrPriv->ChangePictureClip) (pPicture, type, value, n);
+}
+
+static void
+fbDestroyPictureClip(PicturePtr pPicture)
+{
+    FbScreenPrivPtr pScrPriv = fbGetScreenPrivate(pPicture->pDrawable->pScreen);
+
+    fbFlushPictureImages(pPicture);
+    (*pScrPriv->DestroyPictureClip) (pPicture);
+}
+
+static void
+fbChangePicture(PicturePtr pPicture, Mask mask)
+{
+    FbScreenPrivPtr pScrPriv = fbGetScreenPrivate(pPicture->pDrawable->pScreen);
+
+    fbFlushPictureImages(pPicture);
+    (*pScrPriv->ChangePicture) (pPicture, mask);
+}
+
+static void
+fbValidatePicture(PicturePtr pPicture, Mask mask)
+{
+    FbScreenPrivPtr pScrPriv = fbGetScreenPrivate(pPicture->pDrawable->pScreen);
+
+    fbFlushPictureImages(pPicture);
+    (*pScrPriv->ValidatePicture) (pPicture, mask);
+}
+
+static int
+fbChangePictureTransform(PicturePtr pPicture, PictTransform * transform)
+{
+    FbScreenPrivPtr pScrPriv = fbGetScreenPrivate(pPicture->pDrawable->pScreen);
+
+    fbFlushPictureImages(pPicture);
+    return (*pScrPriv->ChangePictureTransform) (pPicture, transform);
+}
+
+static int
+fbChangePictureFilter(PicturePtr pPicture, int filter, xFixed * params,
+                      int nparams)
+{
+    FbScreenPrivPtr pScrPriv = fbGetScreenPrivate(pPicture->pDrawable->pScreen);
+
+    fbFlushPictureImages(pPicture);
+    return (*pScrPriv->ChangePictureFilter) (pPicture, filter, params,
+                                             nparams);
+}
+
 Bool
 fbPictureInit(ScreenPtr pScreen, PictFormatPtr formats, int nformats)
 {
-
+    FbScreenPrivPtr pScrPriv = fbGetScreenPrivate(pScreen);
     PictureScreenPtr ps;
 
+    if (!dixRegisterScreenSpecificPrivateKey(pScreen,
+                                             &pScrPriv->pictPrivateKeyRec,
+                                             PRIVATE_PICTURE,
+                                             sizeof(FbPicturePrivRec)))
+        return FALSE;
+    if (!dixRegisterPrivateKey(&fbGlyphPrivateKeyRec, PRIVATE_GLYPH,
+                               sizeof(FbGlyphPrivRec)))
+        return FALSE;
     if (!miPictureInit(pScreen, formats, nformats))
         return FALSE;
     ps = GetPictureScreen(pScreen);
@@ -503,5 +1151,20 @@ fbPictureInit(ScreenPtr pScreen, PictFormatPtr formats, int nformats)
     ps->AddTriangles = fbAddTriangles;
     ps->Triangles = fbTriangles;
 
+    pScrPriv->DestroyPicture = ps->DestroyPicture;
+    ps->DestroyPicture = fbDestroyPicture;
+    pScrPriv->ChangePictureClip = ps->ChangePictureClip;
+    ps->ChangePictureClip = fbChangePictureClip;
+    pScrPriv->DestroyPictureClip = ps->DestroyPictureClip;
+    ps->DestroyPictureClip = fbDestroyPictureClip;
+    pScrPriv->ChangePicture = ps->ChangePicture;
+    ps->ChangePicture = fbChangePicture;
+    pScrPriv->ValidatePicture = ps->ValidatePicture;
+    ps->ValidatePicture = fbValidatePicture;
+    pScrPriv->ChangePictureTransform = ps->ChangePictureTransform;
+    ps->ChangePictureTransform = fbChangePictureTransform;
+    pScrPriv->ChangePictureFilter = ps->ChangePictureFilter;
+    ps->ChangePictureFilter = fbChangePictureFilter;
+
     return TRUE;
 }
@@ -25,14 +25,98 @@
 #endif
 
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
 
 #include "fb.h"
 
+/*
+ * Pixmaps with at least FB_PIXMAP_HUGE_SIZE bytes of data get a mapping
+ * of their own, aligned to and rounded up to FB_PIXMAP_HUGE_SIZE so the
+ * kernel can back it with transparent huge pages.  Smaller pixmaps stay
+ * in one malloc with their header; malloc already pools by size.
+ *
+ * A few freed mappings are kept for the next pixmap of the same size,
+ * which saves faulting all of its pages in again when clients churn
+ * through window-sized pixmaps.  A reused mapping is cleared, so that
+ * one client's pixels never show up in another client's new pixmap,
+ * just as they would not in a fresh mapping.
+ */
+#define FB_PIXMAP_HUGE_SIZE     (2 << 20)
+#define FB_PIXMAP_CACHE_ENTRIES 8
+#define FB_PIXMAP_CACHE_SIZE    (64 << 20)
+
+static struct {
+    void *map;
+    size_t size;
+} fbPixmapCache[FB_PIXMAP_CACHE_ENTRIES];
+static int fbPixmapCacheCount;
+static size_t fbPixmapCacheBytes;
+
+static void *
+fbMapPixmapData(size_t size)
+{
+    char *map, *aligned;
+    size_t head;
+    int i;
+
+    for (i = 0; i < fbPixmapCacheCount; i++) {
+        if (fbPixmapCache[i].size == size) {
+            map = fbPixmapCache[i].map;
+            fbPixmapCache[i] = fbPixmapCache[--fbPixmapCacheCount];
+            fbPixmapCacheBytes -= size;
+            memset(map, 0, size);
+            return map;
+        }
+    }
+
+    map = mmap(NULL, size + FB_PIXMAP_HUGE_SIZE, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED)
+        return NULL;
+
+    head = -(uintptr_t) map & (FB_PIXMAP_HUGE_SIZE - 1);
+    aligned = map + head;
+    if (head)
+        munmap(map, head);
+    munmap(aligned + size, FB_PIXMAP_HUGE_SIZE - head);
+#ifdef MADV_HUGEPAGE
+    madvise(aligned, size, MADV_HUGEPAGE);
+#endif
+    return aligned;
+}
+
+static void
+fbUnmapPixmapData(void *map, size_t size)
+{
+    if (fbPixmapCacheCount < FB_PIXMAP_CACHE_ENTRIES &&
+        fbPixmapCacheBytes + size <= FB_PIXMAP_CACHE_SIZE) {
+        fbPixmapCache[fbPixmapCacheCount].map = map;
+        fbPixmapCache[fbPixmapCacheCount].size = size;
+        fbPixmapCacheCount++;
+        fbPixmapCacheBytes += size;
+        return;
+    }
+    munmap(map, size);
+}
+
+void
+fbDestroyPixmapCache(void)
+{
+    while (fbPixmapCacheCount) {
+        fbPixmapCacheCount--;
+        munmap(fbPixmapCache[fbPixmapCacheCount].map,
+               fbPixmapCache[fbPixmapCacheCount].size);
+    }
+    fbPixmapCacheBytes = 0;
+}
+
 PixmapPtr
 fbCreatePixmap(ScreenPtr pScreen, int width, int height, int depth,
                unsigned usage_hint)
 {
-    PixmapPtr pPixmap;
+    PixmapPtr pPixmap = NullPixmap;
     size_t datasize;
     size_t paddedWidth;
     int adjust;
@@ -43,17 +127,39 @@ fbCreatePixmap(ScreenPtr pScreen, int width, int height, int depth,
     if (paddedWidth / 4 > 32767 || height > 32767)
         return NullPixmap;
     datasize = height * paddedWidth;
-    base = pScreen->totalPixmapSize;
-    adjust = 0;
-    if (base & 7)
-        adjust = 8 - (base & 7);
-    datasize += adjust;
+#ifndef FB_DEBUG
+    if (datasize >= FB_PIXMAP_HUGE_SIZE) {
+        size_t mapSize = (datasize + FB_PIXMAP_HUGE_SIZE - 1) &
+            ~((size_t) FB_PIXMAP_HUGE_SIZE - 1);
+        void *map = fbMapPixmapData(mapSize);
+
+        if (map) {
+            pPixmap = AllocatePixmap(pScreen, 0);
+            if (!pPixmap) {
+                fbUnmapPixmapData(map, mapSize);
+                return NullPixmap;
+            }
+            pPixmap->drawable.pScreen = pScreen;
+            fbGetPixmapPrivate(pPixmap)->map = map;
+            fbGetPixmapPrivate(pPixmap)->mapSize = mapSize;
+            pPixmap->devPrivate.ptr = map;
+        }
+    }
+#endif
+    if (!pPixmap) {
+        base = pScreen->totalPixmapSize;
+        adjust = 0;
+        if (base & 7)
+            adjust = 8 - (base & 7);
+        datasize += adjust;
 #ifdef FB_DEBUG
-    datasize += 2 * paddedWidth;
+        datasize += 2 * paddedWidth;
 #endif
-    pPixmap = AllocatePixmap(pScreen, datasize);
-    if (!pPixmap)
-        return NullPixmap;
+        pPixmap = AllocatePixmap(pScreen, datasize);
+        if (!pPixmap)
+            return NullPixmap;
+        pPixmap->devPrivate.ptr = (void *) ((char *) pPixmap + base + adjust);
+    }
     pPixmap->drawable.type = DRAWABLE_PIXMAP;
     pPixmap->drawable.class = 0;
     pPixmap->drawable.pScreen = pScreen;
@@ -67,7 +173,6 @@ fbCreatePixmap(ScreenPtr pScreen, int width, int height, int depth,
     pPixmap->drawable.height = height;
     pPixmap->devKind = paddedWidth;
     pPixmap->refcnt = 1;
-    pPixmap->devPrivate.ptr = (void *) ((char *) pPixmap + base + adjust);
     pPixmap->master_pixmap = NULL;
 
 #ifdef FB_DEBUG
@@ -89,8 +194,13 @@ fbCreatePixmap(ScreenPtr pScreen, int width, int height, int depth,
 Bool
 fbDestroyPixmap(PixmapPtr pPixmap)
 {
+    FbPixmapPrivPtr pPixPriv;
+
     if (--pPixmap->refcnt)
         return TRUE;
+    pPixPriv = fbGetPixmapPrivate(pPixmap);
+    if (pPixPriv->map)
+        fbUnmapPixmapData(pPixPriv->map, pPixPriv->mapSize);
     FreePixmap(pPixmap);
     return TRUE;
 }
@@ -33,6 +33,7 @@ fbCloseScreen(ScreenPtr pScreen)
     DepthPtr depths = pScreen->allowedDepths;
 
     fbDestroyGlyphCache();
+    fbDestroyPixmapCache();
     for (d = 0; d < pScreen->numDepths; d++)
         free(depths[d].vids);
     free(depths);
@@ -0,0 +1,175 @@
+/*
+ * Copyright © 2026 X.Org Foundation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include "fb.h"
+#include "opaque.h"
+
+/*
+ * Large operations are split into horizontal bands of the destination and
+ * the bands run on a pool of RenderThreads threads, the calling thread
+ * being one of them.  fbRunBands returns only once every band is done, so
+ * anything reading the destination afterwards (GetImage, SHM completion,
+ * the next request) sees the finished result without further
+ * synchronization.
+ *
+ * Band procedures may only touch their own rows of the destination and
+ * must not call back into the server.
+ */
+
+#if defined(INPUTTHREAD) && !defined(FB_ACCESS_WRAPPER)
+
+#include <pthread.h>
+#include <signal.h>
+
+#define FB_BAND_MIN_PIXELS      (256 * 256)
+#define FB_BAND_MIN_ROWS        16
+#define FB_BAND_MAX_THREADS     64
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t work;        /* workers wait here for bands */
+    pthread_cond_t done;        /* the caller waits here for the last band */
+    int nworkers;
+    Bool started;
+    FbBandProcPtr proc;
+    void *closure;
+    int nbands;
+    int next;                   /* next band to hand out */
+    int pending;                /* bands not finished yet */
+} fbBandPool = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .work = PTHREAD_COND_INITIALIZER,
+    .done = PTHREAD_COND_INITIALIZER,
+};
+
+static void *
+fbBandWorker(void *arg)
+{
+    int band;
+
+    pthread_mutex_lock(&fbBandPool.lock);
+    for (;;) {
+        while (fbBandPool.next >= fbBandPool.nbands)
+            pthread_cond_wait(&fbBandPool.work, &fbBandPool.lock);
+        band = fbBandPool.next++;
+        pthread_mutex_unlock(&fbBandPool.lock);
+
+        (*fbBandPool.proc) (fbBandPool.closure, band, fbBandPool.nbands);
+
+        pthread_mutex_lock(&fbBandPool.lock);
+        if (--fbBandPool.pending == 0)
+            pthread_cond_signal(&fbBandPool.done);
+    }
+    return NULL;
+}
+
+static void
+fbBandStart(void)
+{
+    int want = min(RenderThreads, FB_BAND_MAX_THREADS) - 1;
+    sigset_t set, old;
+    pthread_t thread;
+
+    fbBandPool.started = TRUE;
+
+    /* The workers must never handle signals */
+    sigfillset(&set);
+    pthread_sigmask(SIG_SETMASK, &set, &old);
+    while (fbBandPool.nworkers < want) {
+        if (pthread_create(&thread, NULL, fbBandWorker, NULL) != 0) {
+            ErrorF("fb: only %d of %d render threads started\n",
+                   fbBandPool.nworkers + 1, want + 1);
+            break;
+        }
+        pthread_detach(thread);
+        fbBandPool.nworkers++;
+    }
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+}
+
+int
+fbBandCount(int width, int height)
+{
+    int nbands;
+
+    if (RenderThreads <= 1 || (long) width * height < FB_BAND_MIN_PIXELS)
+        return 1;
+    if (!fbBandPool.started)
+        fbBandStart();
+
+    nbands = min(fbBandPool.nworkers + 1, height / FB_BAND_MIN_ROWS);
+    return max(nbands, 1);
+}
+
+void
+fbRunBands(int nbands, FbBandProcPtr proc, void *closure)
+{
+    int band;
+
+    if (nbands <= 1) {
+        (*proc) (closure, 0, 1);
+        return;
+    }
+
+    pthread_mutex_lock(&fbBandPool.lock);
+    fbBandPool.proc = proc;
+    fbBandPool.closure = closure;
+    fbBandPool.nbands = nbands;
+    fbBandPool.next = 0;
+    fbBandPool.pending = nbands;
+    pthread_cond_broadcast(&fbBandPool.work);
+
+    /* take bands on this thread too, then wait for the stragglers */
+    while (fbBandPool.next < nbands) {
+        band = fbBandPool.next++;
+        pthread_mutex_unlock(&fbBandPool.lock);
+
+        (*proc) (closure, band, nbands);
+
+        pthread_mutex_lock(&fbBandPool.lock);
+        fbBandPool.pending--;
+    }
+    while (fbBandPool.pending)
+        pthread_cond_wait(&fbBandPool.done, &fbBandPool.lock);
+    pthread_mutex_unlock(&fbBandPool.lock);
+}
+
+#else
+
+int
+fbBandCount(int width, int height)
+{
+    return 1;
+}
+
+void
+fbRunBands(int nbands, FbBandProcPtr proc, void *closure)
+{
+    (*proc) (closure, 0, 1);
+}
+
+#endif
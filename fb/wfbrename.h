@@ -4,7 +4,9 @@
 #define fbArc16 wfbArc16
 #define fbArc32 wfbArc32
 #define fbArc8 wfbArc8
+#define fbBandCount wfbBandCount
 #define fbBlt wfbBlt
+#define fbBltCopy wfbBltCopy
 #define fbBltOne wfbBltOne
 #define fbBltPlane wfbBltPlane
 #define fbBltStip wfbBltStip
@@ -37,6 +39,7 @@
 #define fbCreateWindow wfbCreateWindow
 #define fbDestroyGlyphCache wfbDestroyGlyphCache
 #define fbDestroyPixmap wfbDestroyPixmap
+#define fbDestroyPixmapCache wfbDestroyPixmapCache
 #define fbDestroyWindow wfbDestroyWindow
 #define fbDoCopy wfbDoCopy
 #define fbDots wfbDots
@@ -106,6 +109,7 @@
 #define fbRealizeFont wfbRealizeFont
 #define fbReplicatePixel wfbReplicatePixel
 #define fbResolveColor wfbResolveColor
+#define fbRunBands wfbRunBands
 #define fbScreenPrivateKeyRec wfbScreenPrivateKeyRec
 #define fbSegment wfbSegment
 #define fbSelectBres wfbSelectBres
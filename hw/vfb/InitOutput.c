@@ -67,6 +67,7 @@ from The Open Group.
 #include "miline.h"
 #include "glx_extinit.h"
 #include "randrstr.h"
+#include "damage.h"
 
 #define VFB_DEFAULT_WIDTH      1280
 #define VFB_DEFAULT_HEIGHT     1024
@@ -76,6 +77,34 @@ from The Open Group.
 #define VFB_DEFAULT_LINEBIAS      0
 #define XWD_WINDOW_NAME_LEN      60
 
+/*
+ * With -damagelog, the framebuffer memory is followed by a log of the
+ * rectangles changed since the server started, so consumers of the mmapped
+ * file or shared memory segment can copy just the pixels that changed.  The
+ * log starts at the first 8-byte boundary after the pixels and is in host
+ * byte order.  Every time the server is about to block, the boxes of the
+ * damage accumulated since the last flush are appended to the ring, then
+ * head and frame are advanced.
+ *
+ * A consumer keeps the head it last saw.  If head has moved by more than
+ * nrects, the ring has wrapped and it must copy the whole screen; otherwise
+ * it reads the new entries, copies those pixels and re-reads head, falling
+ * back to a full copy if the server lapped it meanwhile.
+ */
+#define VFB_DAMAGE_LOG_MAGIC    0x4c445658      /* "XVDL" */
+#define VFB_DAMAGE_LOG_VERSION  1
+#define VFB_DAMAGE_LOG_RECTS    4096
+
+typedef struct {
+    CARD32 magic;
+    CARD32 version;
+    CARD32 nrects;              /* slots in rects */
+    CARD32 pad;
+    CARD64 frame;               /* number of flushes that logged damage */
+    CARD64 head;                /* rectangles ever logged */
+    BoxRec rects[];             /* rectangle n is in rects[n % nrects] */
+} vfbDamageLogRec, *vfbDamageLogPtr;
+
 typedef struct {
     int width;
     int paddedBytesWidth;
@@ -92,6 +121,9 @@ typedef struct {
     Pixel whitePixel;
     unsigned int lineBias;
     CloseScreenProcPtr closeScreen;
+    CreateScreenResourcesProcPtr createScreenResources;
+    vfbDamageLogPtr damageLog;
+    DamagePtr damage;
 
 #ifdef HAVE_MMAP
     int mmap_fd;
@@ -124,6 +156,7 @@ typedef enum { NORMAL_MEMORY_FB, SHARED_MEMORY_FB, MMAPPED_FILE_FB } fbMemType;
 static fbMemType fbmemtype = NORMAL_MEMORY_FB;
 static char needswap = 0;
 static Bool Render = TRUE;
+static Bool damageLog = FALSE;
 
 #define swapcopy16(_dst, _src) \
     if (needswap) { CARD16 _s = _src; cpswaps(_s, _dst); } \
@@ -251,6 +284,7 @@ ddxUseMsg(void)
 #ifdef HAS_SHM
     ErrorF("-shmem                 put framebuffers in shared memory\n");
 #endif
+    ErrorF("-damagelog             log changed areas after the framebuffer\n");
 }
 
 int
@@ -378,6 +412,11 @@ ddxProcessArgument(int argc, char *argv[], int i)
     }
 #endif
 
+    if (strcmp(argv[i], "-damagelog") == 0) {   /* -damagelog */
+        damageLog = TRUE;
+        return 1;
+    }
+
     return 0;
 }
 
@@ -604,6 +643,13 @@ vfbAllocateFramebufferMemory(vfbScreenInfoPtr pvfb)
     pvfb->sizeInBytes += SIZEOF(XWDheader) + XWD_WINDOW_NAME_LEN +
         pvfb->ncolors * SIZEOF(XWDColor);
 
+    /* and for the damage log, if any */
+
+    if (damageLog) {
+        pvfb->sizeInBytes = ((pvfb->sizeInBytes + 7) & ~7) +
+            sizeof(vfbDamageLogRec) + VFB_DAMAGE_LOG_RECTS * sizeof(BoxRec);
+    }
+
     pvfb->pXWDHeader = NULL;
     switch (fbmemtype) {
 #ifdef HAVE_MMAP
@@ -635,6 +681,18 @@ vfbAllocateFramebufferMemory(vfbScreenInfoPtr pvfb)
                                        XWD_WINDOW_NAME_LEN);
         pvfb->pfbMemory = (char *) (pvfb->pXWDCmap + pvfb->ncolors);
 
+        if (damageLog) {
+            uintptr_t end = (uintptr_t) pvfb->pfbMemory +
+                pvfb->paddedBytesWidth * pvfb->height;
+
+            pvfb->damageLog = (vfbDamageLogPtr) ((end + 7) & ~(uintptr_t) 7);
+            memset(pvfb->damageLog, 0, sizeof(vfbDamageLogRec));
+            pvfb->damageLog->version = VFB_DAMAGE_LOG_VERSION;
+            pvfb->damageLog->nrects = VFB_DAMAGE_LOG_RECTS;
+            __atomic_store_n(&pvfb->damageLog->magic, VFB_DAMAGE_LOG_MAGIC,
+                             __ATOMIC_RELEASE);
+        }
+
         return pvfb->pfbMemory;
     }
     else
@@ -722,6 +780,69 @@ static miPointerScreenFuncRec vfbPointerCursorFuncs = {
     miPointerWarpCursor
 };
 
+/* append the damage since the last flush to the damage log */
+static void
+vfbDamageBlockHandler(void *blockData, void *timeout)
+{
+    ScreenPtr pScreen = blockData;
+    vfbScreenInfoPtr pvfb = &vfbScreens[pScreen->myNum];
+    vfbDamageLogPtr log = pvfb->damageLog;
+    RegionPtr region = DamageRegion(pvfb->damage);
+    BoxPtr boxes;
+    int nboxes, i;
+    CARD64 head;
+
+    if (!RegionNotEmpty(region))
+        return;
+
+    boxes = RegionRects(region);
+    nboxes = RegionNumRects(region);
+
+    /* one big box beats wrapping the ring in a single frame */
+    if (nboxes > VFB_DAMAGE_LOG_RECTS / 4) {
+        boxes = RegionExtents(region);
+        nboxes = 1;
+    }
+
+    head = log->head;
+    for (i = 0; i < nboxes; i++)
+        log->rects[(head + i) % VFB_DAMAGE_LOG_RECTS] = boxes[i];
+    __atomic_store_n(&log->head, head + nboxes, __ATOMIC_RELEASE);
+    __atomic_store_n(&log->frame, log->frame + 1, __ATOMIC_RELEASE);
+
+    DamageEmpty(pvfb->damage);
+}
+
+static void
+vfbDamageWakeupHandler(void *blockData, int result)
+{
+}
+
+static Bool
+vfbCreateScreenResources(ScreenPtr pScreen)
+{
+    vfbScreenInfoPtr pvfb = &vfbScreens[pScreen->myNum];
+    PixmapPtr pPixmap;
+    Bool ret;
+
+    pScreen->CreateScreenResources = pvfb->createScreenResources;
+    ret = (*pScreen->CreateScreenResources) (pScreen);
+    pScreen->CreateScreenResources = vfbCreateScreenResources;
+    if (!ret)
+        return FALSE;
+
+    pvfb->damage = DamageCreate(NULL, NULL, DamageReportNone, TRUE,
+                                pScreen, pScreen);
+    if (!pvfb->damage)
+        return FALSE;
+
+    pPixmap = (*pScreen->GetScreenPixmap) (pScreen);
+    DamageRegister(&pPixmap->drawable, pvfb->damage);
+
+    return RegisterBlockAndWakeupHandlers(vfbDamageBlockHandler,
+                                          vfbDamageWakeupHandler, pScreen);
+}
+
 static Bool
 vfbCloseScreen(ScreenPtr pScreen)
 {
@@ -729,6 +850,13 @@ vfbCloseScreen(ScreenPtr pScreen)
 
     pScreen->CloseScreen = pvfb->closeScreen;
 
+    if (pvfb->damage) {
+        RemoveBlockAndWakeupHandlers(vfbDamageBlockHandler,
+                                     vfbDamageWakeupHandler, pScreen);
+        DamageDestroy(pvfb->damage);
+        pvfb->damage = NULL;
+    }
+
     /*
      * fb overwrites miCloseScreen, so do this here
      */
@@ -953,6 +1081,13 @@ vfbScreenInit(ScreenPtr pScreen, int argc, char **argv)
     pvfb->closeScreen = pScreen->CloseScreen;
     pScreen->CloseScreen = vfbCloseScreen;
 
+    if (pvfb->damageLog) {
+        if (!DamageSetup(pScreen))
+            return FALSE;
+        pvfb->createScreenResources = pScreen->CreateScreenResources;
+        pScreen->CreateScreenResources = vfbCreateScreenResources;
+    }
+
     return ret;
 
 }                               /* end vfbScreenInit */
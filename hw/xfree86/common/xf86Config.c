@@ -633,6 +633,7 @@ typedef enum {
     FLAG_NOPM,
     FLAG_XINERAMA,
     FLAG_LOG,
+    FLAG_LOG_RATE_LIMIT,
     FLAG_RENDER_COLORMAP_MODE,
     FLAG_IGNORE_ABI,
     FLAG_ALLOW_EMPTY_INPUT,
@@ -681,6 +682,8 @@ static OptionInfoRec FlagOptions[] = {
      {0}, FALSE},
     {FLAG_LOG, "Log", OPTV_STRING,
      {0}, FALSE},
+    {FLAG_LOG_RATE_LIMIT, "LogRateLimit", OPTV_INTEGER,
+     {0}, FALSE},
     {FLAG_RENDER_COLORMAP_MODE, "RenderColormapMode", OPTV_STRING,
      {0}, FALSE},
     {FLAG_IGNORE_ABI, "IgnoreABI", OPTV_BOOLEAN,
@@ -808,10 +811,20 @@ configServerFlags(XF86ConfFlagsPtr flagsconf, XF86OptionPtr layoutopts)
                 LogSetParameter(XLOG_FLUSH, TRUE);
                 LogSetParameter(XLOG_SYNC, TRUE);
             }
+            else if (!xf86NameCmp(s, "async")) {
+                if (LogSetParameter(XLOG_ASYNC, TRUE))
+                    xf86Msg(X_CONFIG, "Writing logfile asynchronously\n");
+                else
+                    xf86Msg(X_WARNING, "Cannot write logfile asynchronously\n");
+            }
             else {
                 xf86Msg(X_WARNING, "Unknown Log option\n");
             }
         }
+        if (xf86GetOptValInteger(FlagOptions, FLAG_LOG_RATE_LIMIT, &i)) {
+            xf86Msg(X_CONFIG, "Logging at most %d messages per second\n", i);
+            LogSetParameter(XLOG_RATE_LIMIT, i);
+        }
     }
 
     {
@@ -74,7 +74,7 @@
  * mask is 0xFFFF0000.
  */
 #define ABI_ANSIC_VERSION	SET_ABI_VERSION(0, 4)
-#define ABI_VIDEODRV_VERSION	SET_ABI_VERSION(24, 0)
+#define ABI_VIDEODRV_VERSION	SET_ABI_VERSION(25, 0)
 #define ABI_XINPUT_VERSION	SET_ABI_VERSION(24, 1)
 #define ABI_EXTENSION_VERSION	SET_ABI_VERSION(10, 0)
 
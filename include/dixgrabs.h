@@ -27,6 +27,15 @@ OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 #define DIXGRABS_H 1
 
 struct _GrabParameters;
+struct _GrabIndexBucket;
+
+typedef struct _GrabIndex *GrabIndexPtr;
+
+typedef struct _PassiveGrabIter {
+    GrabPtr next;               /* without an index */
+    struct _GrabIndexBucket *exact, *any;
+    int exact_pos, any_pos;
+} PassiveGrabIterRec, *PassiveGrabIterPtr;
 
 extern void PrintDeviceGrabInfo(DeviceIntPtr dev);
 extern void UngrabAllDevices(Bool kill_client);
@@ -59,6 +68,11 @@ extern _X_EXPORT int AddPassiveGrabToList(ClientPtr /* client */ ,
 
 extern _X_EXPORT Bool DeletePassiveGrabFromList(GrabPtr /* pMinuendGrab */ );
 
+extern GrabPtr FirstPassiveGrab(WindowPtr pWin, unsigned int detail,
+                                PassiveGrabIterPtr iter);
+extern GrabPtr NextPassiveGrab(PassiveGrabIterPtr iter);
+extern void GrabIndexFree(WindowPtr pWin);
+
 extern Bool GrabIsPointerGrab(GrabPtr grab);
 extern Bool GrabIsKeyboardGrab(GrabPtr grab);
 #endif                          /* DIXGRABS_H */
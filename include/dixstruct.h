@@ -127,6 +127,7 @@ extern long SmartScheduleTime;
 extern long SmartScheduleInterval;
 extern long SmartScheduleSlice;
 extern long SmartScheduleMaxSlice;
+extern Bool SmartScheduleChargeTime;
 #ifdef HAVE_SETITIMER
 extern Bool SmartScheduleSignalEnable;
 #else
@@ -179,6 +180,8 @@ static inline Bool any_output_pending(void) {
 
 extern void SmartScheduleInit(void);
 
+extern void SmartSchedulePenalize(ClientPtr client, long ticks);
+
 /* This prototype is used pervasively in Xext, dix */
 #define DISPATCH_PROC(func) int func(ClientPtr /* client */)
 
@@ -98,6 +98,9 @@ extern void RecordExtensionInit(void);
 extern _X_EXPORT Bool noRenderExtension;
 extern void RenderExtensionInit(void);
 
+extern _X_EXPORT Bool noReqStatsExtension;
+extern void ReqStatsExtensionInit(void);
+
 #if defined(RES)
 extern _X_EXPORT Bool noResExtension;
 extern void ResExtensionInit(void);
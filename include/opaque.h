@@ -37,6 +37,10 @@ extern _X_EXPORT const char *defaultTextFont;
 extern _X_EXPORT const char *defaultCursorFont;
 extern _X_EXPORT int MaxClients;
 extern _X_EXPORT int LimitClients;
+extern _X_EXPORT int RenderThreads;
+extern _X_EXPORT int TimerSlack;
+extern _X_EXPORT int GlyphMemoryLimit;
+extern _X_EXPORT Bool GlyphHashSHA1;
 extern _X_EXPORT volatile char isItTimeToYield;
 extern _X_EXPORT volatile char dispatchException;
 
@@ -125,6 +125,14 @@ extern _X_EXPORT void SetCriticalOutputPending(void);
 extern _X_EXPORT int WriteToClient(ClientPtr /*who */ , int /*count */ ,
                                    const void * /*buf */ );
 
+typedef void (*OutputBufferDoneProcPtr) (void * /*buf */ ,
+                                         void * /*closure */ );
+
+extern _X_EXPORT int WriteBufferToClient(ClientPtr /*who */ , int /*count */ ,
+                                         void * /*buf */ ,
+                                         OutputBufferDoneProcPtr /*done */ ,
+                                         void * /*closure */ );
+
 extern _X_EXPORT void ResetOsBuffers(void);
 
 extern _X_EXPORT void InitConnectionLimits(void);
@@ -607,7 +615,9 @@ typedef enum _LogParameter {
     XLOG_FLUSH,
     XLOG_SYNC,
     XLOG_VERBOSITY,
-    XLOG_FILE_VERBOSITY
+    XLOG_FILE_VERBOSITY,
+    XLOG_ASYNC,
+    XLOG_RATE_LIMIT
 } LogParameter;
 
 /* Flags for log messages. */
@@ -635,6 +645,8 @@ LogClose(enum ExitCode error);
 extern _X_EXPORT Bool
 LogSetParameter(LogParameter param, int value);
 extern _X_EXPORT void
+LogGetDropped(unsigned long *queue_full, unsigned long *rate_limited);
+extern _X_EXPORT void
 LogVWrite(int verb, const char *f, va_list args)
 _X_ATTRIBUTE_PRINTF(2, 0);
 extern _X_EXPORT void
@@ -75,6 +75,10 @@
 #define SERVER_RANDR_MAJOR_VERSION		1
 #define SERVER_RANDR_MINOR_VERSION		6
 
+/* XORG-REQUEST-STATS */
+#define SERVER_REQSTATS_MAJOR_VERSION		1
+#define SERVER_REQSTATS_MINOR_VERSION		0
+
 /* Record */
 #define SERVER_RECORD_MAJOR_VERSION		1
 #define SERVER_RECORD_MINOR_VERSION		13
@@ -0,0 +1,86 @@
+/*
+ * Copyright © 2026 X.Org Foundation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef REQSTATS_H
+#define REQSTATS_H
+
+#include "misc.h"
+#include "dixstruct.h"
+
+/*
+ * Per-request dispatch statistics.
+ *
+ * When enabled (-reqstats, or at runtime through the XORG-REQUEST-STATS
+ * extension), Dispatch() times every request and accumulates the result
+ * per major/minor opcode and per client.  Latencies are kept in a
+ * log-linear histogram: values below REQSTATS_SUB_BUCKETS microseconds get
+ * a bucket each, every power of two above that is split into
+ * REQSTATS_SUB_BUCKETS equally sized buckets.  The last bucket collects
+ * everything that doesn't fit.
+ */
+
+#define REQSTATS_SUB_BITS       2
+#define REQSTATS_SUB_BUCKETS    (1 << REQSTATS_SUB_BITS)
+#define REQSTATS_NUM_BUCKETS    80
+
+typedef struct _ReqStats {
+    CARD64 count;
+    CARD64 errors;
+    CARD64 bytes_in;
+    CARD64 total_us;
+    CARD32 max_us;
+    CARD32 buckets[REQSTATS_NUM_BUCKETS];
+} ReqStatsRec, *ReqStatsPtr;
+
+typedef struct _ClientReqStats {
+    CARD64 requests;
+    CARD64 errors;
+    CARD64 bytes_in;
+    CARD64 bytes_out;
+    CARD64 total_us;
+    CARD32 max_us;
+    CARD32 reads;               /* read calls made for the client's input */
+} ClientReqStatsRec, *ClientReqStatsPtr;
+
+typedef void (*ReqStatsProcPtr) (int major, int minor,
+                                 ReqStatsPtr stats, void *closure);
+
+extern _X_EXPORT Bool reqStatsEnabled;
+
+extern void ReqStatsInit(void);
+extern void ReqStatsReset(void);
+
+extern void ReqStatsRecord(ClientPtr client, int bytes, CARD64 us, int result);
+
+extern void ReqStatsCountOutput(ClientPtr client, int bytes);
+
+extern void ReqStatsCountRead(ClientPtr client);
+
+extern _X_EXPORT int ReqStatsBucket(CARD64 us);
+extern _X_EXPORT CARD64 ReqStatsBucketMin(int bucket);
+
+extern _X_EXPORT ReqStatsPtr ReqStatsLookup(int major, int minor);
+extern _X_EXPORT void ReqStatsForEach(ReqStatsProcPtr proc, void *closure);
+extern _X_EXPORT ClientReqStatsPtr ReqStatsForClient(ClientPtr client);
+
+#endif                          /* REQSTATS_H */
@@ -49,6 +49,7 @@ SOFTWARE.
 
 #include "dixstruct.h"
 #include "privates.h"
+#include "list.h"
 
 /*
  *  Selection data structures
@@ -62,6 +63,7 @@ typedef struct _Selection {
     ClientPtr client;
     struct _Selection *next;
     PrivateRec *devPrivates;
+    struct xorg_list owned;     /* on the owned list while client is set */
 } Selection;
 
 /*
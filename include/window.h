@@ -220,6 +220,18 @@ extern _X_EXPORT void ResizeChildrenWinSize(WindowPtr /*pWin */ ,
                                             int /*dw */ ,
                                             int /*dh */ );
 
+/* children scanned linearly before a window is given a child index */
+#define CHILD_INDEX_THRESHOLD 64
+
+extern _X_EXPORT Bool BuildChildIndex(WindowPtr /*pParent */ );
+
+extern _X_EXPORT void InvalidateChildIndex(WindowPtr /*pParent */ );
+
+extern _X_EXPORT WindowPtr *ChildIndexLookup(WindowPtr /*pParent */ ,
+                                             int /*x */ ,
+                                             int /*y */ ,
+                                             int * /*count */ );
+
 extern _X_EXPORT void SendShapeNotify(WindowPtr /* pWin */ ,
                                       int /* which */);
 
@@ -93,6 +93,9 @@ typedef struct _WindowOpt {
     RegionPtr inputShape;       /* default: NULL */
     struct _OtherInputMasks *inputMasks;        /* default: NULL */
     DevCursorList deviceCursors;        /* default: NULL */
+    struct _PropertyIndex *propIndex;   /* default: NULL */
+    struct _ChildIndex *childIndex;     /* default: NULL */
+    struct _GrabIndex *grabIndex;       /* default: NULL */
 } WindowOptRec, *WindowOptPtr;
 
 #define BackgroundPixel	    2L
@@ -167,6 +170,7 @@ typedef struct _Window {
     unsigned damagedDescendants:1;      /* some descendants are damaged */
     unsigned inhibitBGPaint:1;  /* paint the background? */
 #endif
+    struct _Window *deliverySkip;       /* see UpdateDeliverySkip */
 } WindowRec;
 
 /*
@@ -197,6 +201,7 @@ extern _X_EXPORT Mask DontPropagateMasks[];
 #define wBoundingShape(w)	wUseDefault(w, boundingShape, NULL)
 #define wClipShape(w)		wUseDefault(w, clipShape, NULL)
 #define wInputShape(w)          wUseDefault(w, inputShape, NULL)
+#define wChildIndex(w)          wUseDefault(w, childIndex, NULL)
 #define wClient(w)		(clients[CLIENT_ID((w)->drawable.id)])
 #define wBorderWidth(w)		((int) (w)->borderWidth)
 
@@ -307,6 +307,7 @@ extern _X_EXPORT int XkbEventBase;
 extern _X_EXPORT int XkbKeyboardErrorCode;
 extern _X_EXPORT const char *XkbBaseDirectory;
 extern _X_EXPORT const char *XkbBinDirectory;
+extern _X_EXPORT Bool XkbKeymapCache;
 
 extern _X_EXPORT CARD32 xkbDebugFlags;
 
@@ -896,4 +897,6 @@ extern _X_EXPORT XkbDescPtr XkbCompileKeymapFromString(DeviceIntPtr dev,
 						       const char *keymap,
 						       int keymap_length);
 
+extern _X_EXPORT void XkbPrecompileKeymap(void);
+
 #endif                          /* _XKBSRV_H_ */
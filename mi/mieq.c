@@ -61,112 +61,128 @@ in this Software without prior written authorization from The Open Group.
 
 /* Maximum size should be initial size multiplied by a power of 2 */
 #define QUEUE_INITIAL_SIZE                 512
-#define QUEUE_RESERVED_SIZE                 64
 #define QUEUE_MAXIMUM_SIZE                4096
 #define QUEUE_DROP_BACKTRACE_FREQUENCY     100
 #define QUEUE_DROP_BACKTRACE_MAX            10
 
+/* Events queued and dequeued are counted modulo this */
+#define QUEUE_COUNT_MASK          0x7fffffff
+
+/* Keeps what the producer and the consumer write on separate cache lines */
+#define QUEUE_CACHELINE_SIZE                64
+
 #define EnqueueScreen(dev) dev->spriteInfo->sprite->pEnqueueScreen
 #define DequeueScreen(dev) dev->spriteInfo->sprite->pDequeueScreen
 
+/*
+ * The queue is filled by whoever holds the input lock, usually the input
+ * thread, and emptied by the main thread without taking the lock.
+ *
+ * Events go into a ring buffer.  When it fills up, the producer doesn't
+ * move the events into a bigger one but starts a new ring, twice the size
+ * up to QUEUE_MAXIMUM_SIZE, and links it to the full one.  The consumer
+ * drains the rings in order and frees each one once it has moved on to the
+ * next.  Events are only dropped when no new ring can be allocated.
+ *
+ * Ring positions count up and are masked with the ring size.  The consumer
+ * claims the event at head by advancing head before it reads it, the
+ * producer leaves the slot before head alone so it never overwrites it.
+ * Motion events from the same device are merged into the last queued
+ * event if the consumer hasn't claimed it yet, for that the producer
+ * announces the slot in merging and checks head, while the consumer
+ * advances head and then waits for any merge into that slot to finish.
+ */
+#ifdef INPUTTHREAD
+#define mieqLoad(p)             __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define mieqStore(p, v)         __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#define mieqLoadSync(p)         __atomic_load_n(p, __ATOMIC_SEQ_CST)
+#define mieqStoreSync(p, v)     __atomic_store_n(p, v, __ATOMIC_SEQ_CST)
+#define mieqAddDropped(p)       __atomic_add_fetch(p, 1, __ATOMIC_RELAXED)
+#define mieqTakeDropped(p)      __atomic_exchange_n(p, 0, __ATOMIC_RELAXED)
+#else
+#define mieqLoad(p)             (*(p))
+#define mieqStore(p, v)         (*(p) = (v))
+#define mieqLoadSync(p)         (*(p))
+#define mieqStoreSync(p, v)     (*(p) = (v))
+#define mieqAddDropped(p)       (++*(p))
+static inline size_t
+mieqTakeDropped(size_t *p)
+{
+    size_t dropped = *p;
+
+    *p = 0;
+    return dropped;
+}
+#endif
+
 typedef struct _Event {
-    InternalEvent *events;
     ScreenPtr pScreen;
     DeviceIntPtr pDev;          /* device this event _originated_ from */
+    InternalEvent event;
 } EventRec, *EventPtr;
 
+typedef struct _EventRing {
+    /* Producer */
+    unsigned int tail;
+    struct _EventRing *next;    /* the newer ring, once this one is full */
+    char pad[QUEUE_CACHELINE_SIZE];
+    /* Consumer */
+    unsigned int head;
+    unsigned int size;          /* power of two */
+    EventRec events[];
+} EventRingRec, *EventRingPtr;
+
 typedef struct _EventQueue {
-    HWEventQueueType head, tail;        /* long for SetInputCheck */
+    /* Producer, with input_lock held */
+    HWEventQueueType tail;      /* events queued, for SetInputCheck */
+    EventRingPtr tailRing;
+    EventPtr merging;           /* slot a motion event is merged into */
     CARD32 lastEventTime;       /* to avoid time running backwards */
     int lastMotion;             /* device ID if last event motion? */
-    EventRec *events;           /* our queue as an array */
-    size_t nevents;             /* the number of buckets in our queue */
     size_t dropped;             /* counter for number of consecutive dropped events */
+    char pad[QUEUE_CACHELINE_SIZE];
+    /* Consumer, on the main thread */
+    HWEventQueueType head;      /* events taken off the queue */
+    EventRingPtr headRing;
     mieqHandler handlers[128];  /* custom event handler */
 } EventQueueRec, *EventQueuePtr;
 
 static EventQueueRec miEventQueue;
 
-static size_t
-mieqNumEnqueued(EventQueuePtr eventQueue)
+static EventRingPtr
+mieqAllocRing(unsigned int size)
 {
-    size_t n_enqueued = 0;
+    EventRingPtr ring;
 
-    if (eventQueue->nevents) {
-        /* % is not well-defined with negative numbers... sigh */
-        n_enqueued = eventQueue->tail - eventQueue->head + eventQueue->nevents;
-        if (n_enqueued >= eventQueue->nevents)
-            n_enqueued -= eventQueue->nevents;
-    }
-    return n_enqueued;
+    ring = calloc(1, sizeof(EventRingRec) + size * sizeof(EventRec));
+    if (ring)
+        ring->size = size;
+    return ring;
 }
 
-/* Pre-condition: Called with input_lock held */
-static Bool
-mieqGrowQueue(EventQueuePtr eventQueue, size_t new_nevents)
+static void
+mieqFreeRings(EventQueuePtr eventQueue)
 {
-    size_t i, n_enqueued, first_hunk;
-    EventRec *new_events;
+    EventRingPtr ring, next;
 
-    if (!eventQueue) {
-        ErrorF("[mi] mieqGrowQueue called with a NULL eventQueue\n");
-        return FALSE;
+    for (ring = eventQueue->headRing; ring; ring = next) {
+        next = ring->next;
+        free(ring);
     }
-
-    if (new_nevents <= eventQueue->nevents)
-        return FALSE;
-
-    new_events = calloc(new_nevents, sizeof(EventRec));
-    if (new_events == NULL) {
-        ErrorF("[mi] mieqGrowQueue memory allocation error.\n");
-        return FALSE;
-    }
-
-    n_enqueued = mieqNumEnqueued(eventQueue);
-
-    /* First copy the existing events */
-    first_hunk = eventQueue->nevents - eventQueue->head;
-    memcpy(new_events,
-           &eventQueue->events[eventQueue->head],
-           first_hunk * sizeof(EventRec));
-    memcpy(&new_events[first_hunk],
-           eventQueue->events, eventQueue->head * sizeof(EventRec));
-
-    /* Initialize the new portion */
-    for (i = eventQueue->nevents; i < new_nevents; i++) {
-        InternalEvent *evlist = InitEventList(1);
-
-        if (!evlist) {
-            size_t j;
-
-            for (j = 0; j < i; j++)
-                FreeEventList(new_events[j].events, 1);
-            free(new_events);
-            return FALSE;
-        }
-        new_events[i].events = evlist;
-    }
-
-    /* And update our record */
-    eventQueue->tail = n_enqueued;
-    eventQueue->head = 0;
-    eventQueue->nevents = new_nevents;
-    free(eventQueue->events);
-    eventQueue->events = new_events;
-
-    return TRUE;
+    eventQueue->headRing = eventQueue->tailRing = NULL;
 }
 
 Bool
 mieqInit(void)
 {
+    mieqFreeRings(&miEventQueue);
     memset(&miEventQueue, 0, sizeof(miEventQueue));
     miEventQueue.lastEventTime = GetTimeInMillis();
 
-    input_lock();
-    if (!mieqGrowQueue(&miEventQueue, QUEUE_INITIAL_SIZE))
+    miEventQueue.headRing = miEventQueue.tailRing =
+        mieqAllocRing(QUEUE_INITIAL_SIZE);
+    if (!miEventQueue.headRing)
         FatalError("Could not allocate event queue.\n");
-    input_unlock();
 
     SetInputCheck(&miEventQueue.head, &miEventQueue.tail);
     return TRUE;
@@ -175,15 +191,79 @@ mieqInit(void)
 void
 mieqFini(void)
 {
-    int i;
+    mieqFreeRings(&miEventQueue);
+}
+
+static void
+mieqReportDropped(EventQueuePtr eventQueue)
+{
+    size_t dropped = mieqAddDropped(&eventQueue->dropped);
+
+    /* Toss events which come in late.  Usually this means your server's
+     * stuck in an infinite loop in the main thread.
+     */
+    if (dropped == 1) {
+        ErrorFSigSafe("[mi] EQ overflowing.  Additional events will be "
+                      "discarded until existing events are processed.\n");
+        xorg_backtrace();
+        ErrorFSigSafe("[mi] These backtraces from mieqEnqueue may point to "
+                      "a culprit higher up the stack.\n");
+        ErrorFSigSafe("[mi] mieq is *NOT* the cause.  It is a victim.\n");
+    }
+    else if (dropped % QUEUE_DROP_BACKTRACE_FREQUENCY == 0 &&
+             dropped / QUEUE_DROP_BACKTRACE_FREQUENCY <=
+             QUEUE_DROP_BACKTRACE_MAX) {
+        ErrorFSigSafe("[mi] EQ overflow continuing.  %zu events have been "
+                      "dropped.\n", dropped);
+        if (dropped / QUEUE_DROP_BACKTRACE_FREQUENCY ==
+            QUEUE_DROP_BACKTRACE_MAX) {
+            ErrorFSigSafe("[mi] No further overflow reports will be "
+                          "reported until the clog is cleared.\n");
+        }
+        xorg_backtrace();
+    }
+}
+
+/*
+ * Try to merge a motion event into the last queued event, which must be
+ * motion from the same device.  Fails if the consumer got to it first.
+ */
+static EventPtr
+mieqClaimLast(EventQueuePtr eventQueue)
+{
+    EventRingPtr ring = eventQueue->tailRing;
+    EventPtr slot;
 
-    for (i = 0; i < miEventQueue.nevents; i++) {
-        if (miEventQueue.events[i].events != NULL) {
-            FreeEventList(miEventQueue.events[i].events, 1);
-            miEventQueue.events[i].events = NULL;
+    if (ring->tail == mieqLoad(&ring->head))
+        return NULL;
+
+    slot = &ring->events[(ring->tail - 1) & (ring->size - 1)];
+    mieqStoreSync(&eventQueue->merging, slot);
+    if (mieqLoadSync(&ring->head) == ring->tail) {
+        mieqStore(&eventQueue->merging, NULL);
+        return NULL;
+    }
+    return slot;
+}
+
+/* Get the next free slot, starting a new ring when this one is full */
+static EventPtr
+mieqClaimNext(EventQueuePtr eventQueue)
+{
+    EventRingPtr ring = eventQueue->tailRing, next;
+
+    /* The slot before head may still be read by the consumer */
+    if (ring->tail - mieqLoad(&ring->head) == ring->size - 1) {
+        next = mieqAllocRing(min(ring->size << 1, QUEUE_MAXIMUM_SIZE));
+        if (!next) {
+            ErrorFSigSafe("[mi] mieqEnqueue memory allocation error.\n");
+            return NULL;
         }
+        mieqStore(&ring->next, next);
+        eventQueue->tailRing = ring = next;
     }
-    free(miEventQueue.events);
+
+    return &ring->events[ring->tail & (ring->size - 1)];
 }
 
 /*
@@ -194,58 +274,31 @@ mieqFini(void)
 void
 mieqEnqueue(DeviceIntPtr pDev, InternalEvent *e)
 {
-    unsigned int oldtail = miEventQueue.tail;
+    EventPtr slot = NULL;
     InternalEvent *evt;
     int isMotion = 0;
     int evlen;
     Time time;
-    size_t n_enqueued;
 
     verify_internal_event(e);
 
-    n_enqueued = mieqNumEnqueued(&miEventQueue);
-
     /* avoid merging events from different devices */
     if (e->any.type == ET_Motion)
         isMotion = pDev->id;
 
-    if (isMotion && isMotion == miEventQueue.lastMotion &&
-        oldtail != miEventQueue.head) {
-        oldtail = (oldtail - 1) % miEventQueue.nevents;
-    }
-    else if (n_enqueued + 1 == miEventQueue.nevents) {
-        if (!mieqGrowQueue(&miEventQueue, miEventQueue.nevents << 1)) {
-            /* Toss events which come in late.  Usually this means your server's
-             * stuck in an infinite loop in the main thread.
-             */
-            miEventQueue.dropped++;
-            if (miEventQueue.dropped == 1) {
-                ErrorFSigSafe("[mi] EQ overflowing.  Additional events will be "
-                              "discarded until existing events are processed.\n");
-                xorg_backtrace();
-                ErrorFSigSafe("[mi] These backtraces from mieqEnqueue may point to "
-                              "a culprit higher up the stack.\n");
-                ErrorFSigSafe("[mi] mieq is *NOT* the cause.  It is a victim.\n");
-            }
-            else if (miEventQueue.dropped % QUEUE_DROP_BACKTRACE_FREQUENCY == 0 &&
-                     miEventQueue.dropped / QUEUE_DROP_BACKTRACE_FREQUENCY <=
-                     QUEUE_DROP_BACKTRACE_MAX) {
-                ErrorFSigSafe("[mi] EQ overflow continuing.  %zu events have been "
-                              "dropped.\n", miEventQueue.dropped);
-                if (miEventQueue.dropped / QUEUE_DROP_BACKTRACE_FREQUENCY ==
-                    QUEUE_DROP_BACKTRACE_MAX) {
-                    ErrorFSigSafe("[mi] No further overflow reports will be "
-                                  "reported until the clog is cleared.\n");
-                }
-                xorg_backtrace();
-            }
+    if (isMotion && isMotion == miEventQueue.lastMotion)
+        slot = mieqClaimLast(&miEventQueue);
+
+    if (!slot) {
+        slot = mieqClaimNext(&miEventQueue);
+        if (!slot) {
+            mieqReportDropped(&miEventQueue);
             return;
         }
-        oldtail = miEventQueue.tail;
     }
 
     evlen = e->any.length;
-    evt = miEventQueue.events[oldtail].events;
+    evt = &slot->event;
     memcpy(evt, e, evlen);
 
     time = e->any.time;
@@ -256,11 +309,54 @@ mieqEnqueue(DeviceIntPtr pDev, InternalEvent *e)
         e->any.time = miEventQueue.lastEventTime;
 
     miEventQueue.lastEventTime = evt->any.time;
-    miEventQueue.events[oldtail].pScreen = pDev ? EnqueueScreen(pDev) : NULL;
-    miEventQueue.events[oldtail].pDev = pDev;
+    slot->pScreen = pDev ? EnqueueScreen(pDev) : NULL;
+    slot->pDev = pDev;
 
     miEventQueue.lastMotion = isMotion;
-    miEventQueue.tail = (oldtail + 1) % miEventQueue.nevents;
+
+    if (slot == miEventQueue.merging) {
+        mieqStore(&miEventQueue.merging, NULL);
+    }
+    else {
+        EventRingPtr ring = miEventQueue.tailRing;
+
+        mieqStore(&ring->tail, ring->tail + 1);
+        mieqStore(&miEventQueue.tail,
+                  (miEventQueue.tail + 1) & QUEUE_COUNT_MASK);
+    }
+}
+
+/*
+ * Take the next event off the queue, copying it out so the producer can
+ * reuse the slot.  Main thread only.
+ */
+static Bool
+mieqDequeue(EventQueuePtr eventQueue, EventRec *e)
+{
+    EventRingPtr ring = eventQueue->headRing;
+    unsigned int head = ring->head;
+    EventPtr slot;
+
+    if (head == mieqLoad(&ring->tail)) {
+        EventRingPtr next = mieqLoad(&ring->next);
+
+        /* the producer may have filled this ring before moving on */
+        if (!next || head != mieqLoad(&ring->tail))
+            return FALSE;
+
+        eventQueue->headRing = next;
+        free(ring);
+        return mieqDequeue(eventQueue, e);
+    }
+
+    slot = &ring->events[head & (ring->size - 1)];
+    mieqStoreSync(&ring->head, head + 1);
+    while (mieqLoadSync(&eventQueue->merging) == slot)
+        ;
+
+    *e = *slot;
+    mieqStore(&eventQueue->head, (eventQueue->head + 1) & QUEUE_COUNT_MASK);
+    return TRUE;
 }
 
 /**
@@ -501,14 +597,11 @@ mieqProcessDeviceEvent(DeviceIntPtr dev, InternalEvent *event, ScreenPtr screen)
 void
 mieqProcessInputEvents(void)
 {
-    EventRec *e = NULL;
-    ScreenPtr screen;
-    InternalEvent event;
-    DeviceIntPtr dev = NULL, master = NULL;
+    EventRec e;
+    size_t dropped;
+    DeviceIntPtr master = NULL;
     static Bool inProcessInputEvents = FALSE;
 
-    input_lock();
-
     /*
      * report an error if mieqProcessInputEvents() is called recursively;
      * this can happen, e.g., if something in the mieqProcessDeviceEvent()
@@ -517,26 +610,16 @@ mieqProcessInputEvents(void)
     BUG_WARN_MSG(inProcessInputEvents, "[mi] mieqProcessInputEvents() called recursively.\n");
     inProcessInputEvents = TRUE;
 
-    if (miEventQueue.dropped) {
+    dropped = mieqTakeDropped(&miEventQueue.dropped);
+    if (dropped) {
         ErrorF("[mi] EQ processing has resumed after %lu dropped events.\n",
-               (unsigned long) miEventQueue.dropped);
+               (unsigned long) dropped);
         ErrorF
             ("[mi] This may be caused by a misbehaving driver monopolizing the server's resources.\n");
-        miEventQueue.dropped = 0;
     }
 
-    while (miEventQueue.head != miEventQueue.tail) {
-        e = &miEventQueue.events[miEventQueue.head];
-
-        event = *e->events;
-        dev = e->pDev;
-        screen = e->pScreen;
-
-        miEventQueue.head = (miEventQueue.head + 1) % miEventQueue.nevents;
-
-        input_unlock();
-
-        master = (dev) ? GetMaster(dev, MASTER_ATTACHED) : NULL;
+    while (mieqDequeue(&miEventQueue, &e)) {
+        master = (e.pDev) ? GetMaster(e.pDev, MASTER_ATTACHED) : NULL;
 
         if (screenIsSaved == SCREEN_SAVER_ON)
             dixSaveScreens(serverClient, SCREEN_SAVER_OFF, ScreenSaverReset);
@@ -548,20 +631,16 @@ mieqProcessInputEvents(void)
             DPMSSet(serverClient, DPMSModeOn);
 #endif
 
-        mieqProcessDeviceEvent(dev, &event, screen);
+        mieqProcessDeviceEvent(e.pDev, &e.event, e.pScreen);
 
         /* Update the sprite now. Next event may be from different device. */
         if (master &&
-            (event.any.type == ET_Motion ||
-             ((event.any.type == ET_TouchBegin ||
-               event.any.type == ET_TouchUpdate) &&
-              event.device_event.flags & TOUCH_POINTER_EMULATED)))
-            miPointerUpdateSprite(dev);
-
-        input_lock();
+            (e.event.any.type == ET_Motion ||
+             ((e.event.any.type == ET_TouchBegin ||
+               e.event.any.type == ET_TouchUpdate) &&
+              e.event.device_event.flags & TOUCH_POINTER_EMULATED)))
+            miPointerUpdateSprite(e.pDev);
     }
 
     inProcessInputEvents = FALSE;
-
-    input_unlock();
 }
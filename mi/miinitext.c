@@ -170,6 +170,7 @@ static const ExtensionModule staticExtensions[] = {
 #ifdef RES
     {ResExtensionInit, "X-Resource", &noResExtension},
 #endif
+    {ReqStatsExtensionInit, "XORG-REQUEST-STATS", &noReqStatsExtension},
 #ifdef XV
     {XvExtensionInit, "XVideo", &noXvExtension},
     {XvMCExtensionInit, "XVideo-MotionCompensation", &noXvExtension},
@@ -177,6 +177,60 @@ miShapedWindowIn(RegionPtr universe, RegionPtr bounding,
 				    HasBorder(w) && \
 				    (w)->backgroundState == ParentRelative)
 
+/*
+ * Decide whether pParent's marked subtree keeps its current clipping.
+ * Only geometry-preserving operations qualify; VTOther covers resizes,
+ * shape and border changes and redirection, which are always recomputed.
+ */
+static Bool
+miClipsUnchanged(WindowPtr pParent, RegionPtr universe, VTKind kind,
+                 int dx, int dy, int oldVis, int newVis)
+{
+    if (kind == VTOther || kind == VTBroken)
+        return FALSE;
+    if (dx || dy)
+        return FALSE;
+    if (pParent->valdata->before.resized ||
+        pParent->valdata->before.borderVisible)
+        return FALSE;
+    if (oldVis != newVis || oldVis == VisibilityNotViewable)
+        return FALSE;
+#ifdef COMPOSITE
+    if (pParent->redirectDraw != RedirectDrawNone)
+        return FALSE;
+#endif
+    return RegionEqual(universe, &pParent->borderClip);
+}
+
+/*
+ * Leave the clipping of pParent and its inferiors as it is, but clear the
+ * exposure regions of every marked window so miHandleValidateExposures
+ * finds nothing to paint.
+ */
+static void
+miSkipUnchangedClips(WindowPtr pParent)
+{
+    WindowPtr pChild = pParent;
+
+    while (1) {
+        if (pChild->viewable) {
+            if (pChild->valdata) {
+                RegionNull(&pChild->valdata->after.borderExposed);
+                RegionNull(&pChild->valdata->after.exposed);
+            }
+            if (pChild->firstChild) {
+                pChild = pChild->firstChild;
+                continue;
+            }
+        }
+        while (!pChild->nextSib && (pChild != pParent))
+            pChild = pChild->parent;
+        if (pChild == pParent)
+            break;
+        pChild = pChild->nextSib;
+    }
+}
+
 /*
  *-----------------------------------------------------------------------
  * miComputeClips --
@@ -278,6 +332,17 @@ miComputeClips(WindowPtr pParent,
     dx = pParent->drawable.x - pParent->valdata->before.oldAbsCorner.x;
     dy = pParent->drawable.y - pParent->valdata->before.oldAbsCorner.y;
 
+    /*
+     * A window marked only because it overlaps the area being changed
+     * often ends up with exactly the borderClip it had before. If it
+     * neither moved nor changed shape, none of its inferiors can have
+     * changed either, so the whole subtree can be left alone.
+     */
+    if (miClipsUnchanged(pParent, universe, kind, dx, dy, oldVis, newVis)) {
+        miSkipUnchangedClips(pParent);
+        return;
+    }
+
     /*
      * avoid computations when dealing with simple operations
      */
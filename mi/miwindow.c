@@ -745,46 +745,71 @@ miMarkUnrealizedWindow(WindowPtr pChild, WindowPtr pWin, Bool fromConfigure)
     }
 }
 
+static Bool
+miSpriteHit(WindowPtr pWin, int x, int y)
+{
+    BoxRec box;
+
+    return (pWin->mapped) &&
+        (x >= pWin->drawable.x - wBorderWidth(pWin)) &&
+        (x < pWin->drawable.x + (int) pWin->drawable.width +
+         wBorderWidth(pWin)) &&
+        (y >= pWin->drawable.y - wBorderWidth(pWin)) &&
+        (y < pWin->drawable.y + (int) pWin->drawable.height +
+         wBorderWidth(pWin))
+        /* When a window is shaped, a further check
+         * is made to see if the point is inside
+         * borderSize
+         */
+        && (!wBoundingShape(pWin) || PointInBorderSize(pWin, x, y))
+        && (!wInputShape(pWin) ||
+            RegionContainsPoint(wInputShape(pWin),
+                                x - pWin->drawable.x,
+                                y - pWin->drawable.y, &box))
+        /* In rootless mode windows may be offscreen, even when
+         * they're in X's stack. (E.g. if the native window system
+         * implements some form of virtual desktop system).
+         */
+        && !pWin->unhittable;
+}
+
 WindowPtr
 miSpriteTrace(SpritePtr pSprite, int x, int y)
 {
-    WindowPtr pWin;
-    BoxRec box;
+    WindowPtr pParent, pWin, *candidates;
+    int i, count;
 
-    pWin = DeepestSpriteWin(pSprite)->firstChild;
-    while (pWin) {
-        if ((pWin->mapped) &&
-            (x >= pWin->drawable.x - wBorderWidth(pWin)) &&
-            (x < pWin->drawable.x + (int) pWin->drawable.width +
-             wBorderWidth(pWin)) &&
-            (y >= pWin->drawable.y - wBorderWidth(pWin)) &&
-            (y < pWin->drawable.y + (int) pWin->drawable.height +
-             wBorderWidth(pWin))
-            /* When a window is shaped, a further check
-             * is made to see if the point is inside
-             * borderSize
-             */
-            && (!wBoundingShape(pWin) || PointInBorderSize(pWin, x, y))
-            && (!wInputShape(pWin) ||
-                RegionContainsPoint(wInputShape(pWin),
-                                    x - pWin->drawable.x,
-                                    y - pWin->drawable.y, &box))
-            /* In rootless mode windows may be offscreen, even when
-             * they're in X's stack. (E.g. if the native window system
-             * implements some form of virtual desktop system).
-             */
-            && !pWin->unhittable) {
-            if (pSprite->spriteTraceGood >= pSprite->spriteTraceSize) {
-                pSprite->spriteTraceSize += 10;
-                pSprite->spriteTrace = reallocarray(pSprite->spriteTrace,
-                                                    pSprite->spriteTraceSize,
-                                                    sizeof(WindowPtr));
+    pParent = DeepestSpriteWin(pSprite);
+    while (1) {
+        if (wChildIndex(pParent)) {
+            candidates = ChildIndexLookup(pParent, x, y, &count);
+            for (i = 0; i < count; i++)
+                if (miSpriteHit(candidates[i], x, y))
+                    break;
+            pWin = i < count ? candidates[i] : NullWindow;
+        }
+        else {
+            /* index levels whose linear walk turns out to be long */
+            count = 0;
+            for (pWin = pParent->firstChild; pWin; pWin = pWin->nextSib) {
+                if (miSpriteHit(pWin, x, y))
+                    break;
+                count++;
             }
-            pSprite->spriteTrace[pSprite->spriteTraceGood++] = pWin;
-            pWin = pWin->firstChild;
+            if (count > CHILD_INDEX_THRESHOLD)
+                BuildChildIndex(pParent);
         }
-        else
-            pWin = pWin->nextSib;
+        if (!pWin)
+            break;
+
+        if (pSprite->spriteTraceGood >= pSprite->spriteTraceSize) {
+            pSprite->spriteTraceSize += 10;
+            pSprite->spriteTrace = reallocarray(pSprite->spriteTrace,
+                                                pSprite->spriteTraceSize,
+                                                sizeof(WindowPtr));
+        }
+        pSprite->spriteTrace[pSprite->spriteTraceGood++] = pWin;
+        pParent = pWin;
     }
     return DeepestSpriteWin(pSprite);
 }
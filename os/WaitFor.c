@@ -95,7 +95,8 @@ SOFTWARE.
 #endif
 
 struct _OsTimerRec {
-    struct xorg_list list;
+    int index;                  /* slot in timer_heap, -1 when not pending */
+    CARD32 order;               /* keeps equal expiry times in arming order */
     CARD32 expires;
     CARD32 delta;
     OsTimerCallback callback;
@@ -105,15 +106,97 @@ struct _OsTimerRec {
 static void DoTimer(OsTimerPtr timer, CARD32 now);
 static void DoTimers(CARD32 now);
 static void CheckAllTimers(void);
-static volatile struct xorg_list timers;
+
+/*
+ * Pending timers are kept in a binary min-heap ordered by expiry time, so
+ * arming and cancelling a timer are O(log n) however many are pending.
+ * The heap always has room for every allocated timer, which means arming
+ * one never has to allocate.  All of it is protected by the input lock.
+ */
+static OsTimerPtr *timer_heap;
+static int timer_count;         /* pending timers */
+static int timer_size;          /* allocated slots */
+static int timer_allocated;     /* timers in existence */
+static CARD32 timer_order;
+
+static inline Bool
+timer_before(OsTimerPtr a, OsTimerPtr b)
+{
+    if (a->expires != b->expires)
+        return (int) (a->expires - b->expires) < 0;
+    return (int) (a->order - b->order) < 0;
+}
+
+static inline void
+timer_heap_place(OsTimerPtr timer, int index)
+{
+    timer_heap[index] = timer;
+    timer->index = index;
+}
+
+static void
+timer_heap_up(OsTimerPtr timer, int index)
+{
+    while (index > 0) {
+        int parent = (index - 1) / 2;
+
+        if (!timer_before(timer, timer_heap[parent]))
+            break;
+        timer_heap_place(timer_heap[parent], index);
+        index = parent;
+    }
+    timer_heap_place(timer, index);
+}
+
+static void
+timer_heap_down(OsTimerPtr timer, int index)
+{
+    for (;;) {
+        int child = 2 * index + 1;
+
+        if (child >= timer_count)
+            break;
+        if (child + 1 < timer_count &&
+            timer_before(timer_heap[child + 1], timer_heap[child]))
+            child++;
+        if (!timer_before(timer_heap[child], timer))
+            break;
+        timer_heap_place(timer_heap[child], index);
+        index = child;
+    }
+    timer_heap_place(timer, index);
+}
+
+static void
+timer_heap_insert(OsTimerPtr timer)
+{
+    timer->order = timer_order++;
+    timer_heap_up(timer, timer_count++);
+}
+
+static void
+timer_heap_remove(OsTimerPtr timer)
+{
+    int index = timer->index;
+    OsTimerPtr last;
+
+    if (index < 0)
+        return;
+    timer->index = -1;
+
+    last = timer_heap[--timer_count];
+    if (last == timer)
+        return;
+    if (index > 0 && timer_before(last, timer_heap[(index - 1) / 2]))
+        timer_heap_up(last, index);
+    else
+        timer_heap_down(last, index);
+}
 
 static inline OsTimerPtr
 first_timer(void)
 {
-    /* inline xorg_list_is_empty which can't handle volatile */
-    if (timers.next == &timers)
-        return NULL;
-    return xorg_list_first_entry(&timers, struct _OsTimerRec, list);
+    return timer_count ? timer_heap[0] : NULL;
 }
 
 /*
@@ -124,17 +207,26 @@ static int
 check_timers(void)
 {
     OsTimerPtr timer;
+    CARD32 expires, delta;
 
-    if ((timer = first_timer()) != NULL) {
+    input_lock();
+    timer = first_timer();
+    if (timer) {
+        expires = timer->expires;
+        delta = timer->delta;
+    }
+    input_unlock();
+
+    if (timer) {
         CARD32 now = GetTimeInMillis();
-        int timeout = timer->expires - now;
+        int timeout = expires - now;
 
         if (timeout <= 0) {
             DoTimers(now);
         } else {
             /* Make sure the timeout is sane */
-            if (timeout < timer->delta + 250)
-                return timeout;
+            if (timeout < delta + 250)
+                return timeout + TimerSlack;
 
             /* time has rewound.  reset the timers. */
             CheckAllTimers();
@@ -243,7 +335,7 @@ AdjustWaitForDelay(void *waitTime, int newdelay)
 }
 
 static inline Bool timer_pending(OsTimerPtr timer) {
-    return !xorg_list_is_empty(&timer->list);
+    return timer->index >= 0;
 }
 
 /* If time has rewound, re-run every affected timer.
@@ -253,12 +345,14 @@ CheckAllTimers(void)
 {
     OsTimerPtr timer;
     CARD32 now;
+    int i;
 
     input_lock();
  start:
     now = GetTimeInMillis();
 
-    xorg_list_for_each_entry(timer, &timers, list) {
+    for (i = 0; i < timer_count; i++) {
+        timer = timer_heap[i];
         if (timer->expires - now > timer->delta + 250) {
             DoTimer(timer, now);
             goto start;
@@ -272,7 +366,7 @@ DoTimer(OsTimerPtr timer, CARD32 now)
 {
     CARD32 newTime;
 
-    xorg_list_del(&timer->list);
+    timer_heap_remove(timer);
     newTime = (*timer->callback) (timer, now, timer->arg);
     if (newTime)
         TimerSet(timer, 0, newTime, timer->callback, timer->arg);
@@ -296,19 +390,35 @@ OsTimerPtr
 TimerSet(OsTimerPtr timer, int flags, CARD32 millis,
          OsTimerCallback func, void *arg)
 {
-    OsTimerPtr existing;
     CARD32 now = GetTimeInMillis();
 
     if (!timer) {
         timer = calloc(1, sizeof(struct _OsTimerRec));
         if (!timer)
             return NULL;
-        xorg_list_init(&timer->list);
+        timer->index = -1;
+
+        input_lock();
+        if (timer_allocated == timer_size) {
+            int size = timer_size ? timer_size * 2 : 32;
+            OsTimerPtr *heap = reallocarray(timer_heap, size,
+                                            sizeof(OsTimerPtr));
+
+            if (!heap) {
+                input_unlock();
+                free(timer);
+                return NULL;
+            }
+            timer_heap = heap;
+            timer_size = size;
+        }
+        timer_allocated++;
+        input_unlock();
     }
     else {
         input_lock();
         if (timer_pending(timer)) {
-            xorg_list_del(&timer->list);
+            timer_heap_remove(timer);
             if (flags & TimerForceOld)
                 (void) (*timer->callback) (timer, now, timer->arg);
         }
@@ -328,12 +438,7 @@ TimerSet(OsTimerPtr timer, int flags, CARD32 millis,
     timer->arg = arg;
     input_lock();
 
-    /* Sort into list */
-    xorg_list_for_each_entry(existing, &timers, list)
-        if ((int) (existing->expires - millis) > 0)
-            break;
-    /* This even works at the end of the list -- existing->list will be timers */
-    xorg_list_append(&timer->list, &existing->list);
+    timer_heap_insert(timer);
 
     /* Check to see if the timer is ready to run now */
     if ((int) (millis - now) <= 0)
@@ -362,7 +467,7 @@ TimerCancel(OsTimerPtr timer)
     if (!timer)
         return;
     input_lock();
-    xorg_list_del(&timer->list);
+    timer_heap_remove(timer);
     input_unlock();
 }
 
@@ -371,7 +476,10 @@ TimerFree(OsTimerPtr timer)
 {
     if (!timer)
         return;
-    TimerCancel(timer);
+    input_lock();
+    timer_heap_remove(timer);
+    timer_allocated--;
+    input_unlock();
     free(timer);
 }
 
@@ -384,18 +492,15 @@ TimerCheck(void)
 void
 TimerInit(void)
 {
-    static Bool been_here;
-    OsTimerPtr timer, tmp;
-
-    if (!been_here) {
-        been_here = TRUE;
-        xorg_list_init((struct xorg_list*) &timers);
-    }
+    OsTimerPtr timer;
 
-    xorg_list_for_each_entry_safe(timer, tmp, &timers, list) {
-        xorg_list_del(&timer->list);
+    input_lock();
+    while ((timer = first_timer())) {
+        timer_heap_remove(timer);
+        timer_allocated--;
         free(timer);
     }
+    input_unlock();
 }
 
 #ifdef DPMSExtension
@@ -626,6 +626,7 @@ AllocNewConnection(XtransConnInfo trans_conn, int fd, CARD32 conn_time)
     oc->auth_id = None;
     oc->conn_time = conn_time;
     oc->flags = 0;
+    oc->input_size = 0;
     if (!(client = NextAvailableClient((void *) oc))) {
         free(oc);
         return NullClient;
@@ -77,6 +77,7 @@ SOFTWARE.
 #include "opaque.h"
 #include "dixstruct.h"
 #include "misc.h"
+#include "reqstats.h"
 
 CallbackListPtr ReplyCallback;
 CallbackListPtr FlushCallback;
@@ -91,11 +92,31 @@ typedef struct _connectionInput {
     unsigned int ignoreBytes;   /* bytes to ignore before the next request */
 } ConnectionInput;
 
+/*
+ * Output that couldn't be written right away is kept in buf, followed by a
+ * queue of chunks.  Chunks either reference a buffer handed over by
+ * WriteBufferToClient, or, once such a buffer is queued, hold copies of
+ * whatever else gets written until the queue drains.
+ */
+typedef struct _connectionOutputChunk {
+    struct _connectionOutputChunk *next;
+    char *data;
+    int count;                  /* bytes of data to write */
+    int pad;                    /* zero bytes to write after data */
+    int written;                /* bytes of data and pad already written */
+    int size;                   /* size of data if it is a copy, else 0 */
+    OutputBufferDoneProcPtr done;       /* NULL to free data */
+    void *closure;
+} ConnectionOutputChunk, *ConnectionOutputChunkPtr;
+
 typedef struct _connectionOutput {
     struct _connectionOutput *next;
     unsigned char *buf;
     int size;
     int count;
+    ConnectionOutputChunkPtr chunks;
+    ConnectionOutputChunkPtr chunkTail;
+    long queued;                /* bytes left to write from chunks */
 } ConnectionOutput;
 
 static ConnectionInputPtr AllocateInputBuffer(void);
@@ -119,6 +140,12 @@ static OsCommPtr AvailableInput = (OsCommPtr) NULL;
 #define BUFSIZE 16384
 #define BUFWATERMARK 32768
 
+/* maximum number of pieces handed to a single writev */
+#define OUTPUT_IOV 16
+
+/* largest input buffer grown for a client streaming small requests */
+#define INPUT_BUFMAX (256 * 1024)
+
 /*
  *   A lot of the code in this file manipulates a ConnectionInputPtr:
  *
@@ -209,20 +236,53 @@ NextAvailableInput(OsCommPtr oc)
         if (AvailableInput != oc) {
             ConnectionInputPtr aci = AvailableInput->input;
 
-            if (aci->size > BUFWATERMARK) {
+            if (aci->size > BUFWATERMARK &&
+                aci->size <= min(AvailableInput->input_size, INPUT_BUFMAX)) {
+                /* still the size this client needs, let it keep it */
+            }
+            else if (aci->size > BUFWATERMARK) {
                 free(aci->buffer);
                 free(aci);
+                AvailableInput->input = NULL;
             }
             else {
                 aci->next = FreeInputs;
                 FreeInputs = aci;
+                AvailableInput->input = NULL;
             }
-            AvailableInput->input = NULL;
         }
         AvailableInput = NULL;
     }
 }
 
+/*
+ * The input buffer size a client gets follows the way it sends requests.
+ * A read filling all the space it was given suggests more is waiting, so
+ * the size doubles, up to INPUT_BUFMAX, to get by with fewer reads.  A
+ * request larger than the size raises it as well, but never past
+ * INPUT_BUFMAX: a buffer grown beyond that for a huge request is shrunk
+ * back once the request has been consumed.  Reads of small requests using
+ * little of it halve it again.
+ */
+static int
+InputBufferSize(OsCommPtr oc)
+{
+    return max(oc->input_size, BUFSIZE);
+}
+
+static void
+AdaptInputBufferSize(OsCommPtr oc, int result, int space, int needed)
+{
+    int size = InputBufferSize(oc);
+
+    if (needed > size)
+        oc->input_size = min(needed, INPUT_BUFMAX);
+    else if (result == space && size < INPUT_BUFMAX)
+        oc->input_size = min(size * 2, INPUT_BUFMAX);
+    else if (result < size / 4 && needed < size / 4)
+        oc->input_size = max(size / 2, BUFSIZE);
+}
+
 int
 ReadRequestFromClient(ClientPtr client)
 {
@@ -233,6 +293,7 @@ ReadRequestFromClient(ClientPtr client)
     register xReq *request;
     Bool need_header;
     Bool move_header;
+    int space;
 
     NextAvailableInput(oc);
 
@@ -322,16 +383,18 @@ ReadRequestFromClient(ClientPtr client)
             if ((gotnow > 0) && (oci->bufptr != oci->buffer))
                 /* save the data we've already read */
                 memmove(oci->buffer, oci->bufptr, gotnow);
-            if (needed > oci->size) {
-                /* make buffer bigger to accomodate request */
+            if (needed > oci->size || InputBufferSize(oc) > oci->size) {
+                /* make buffer bigger to accomodate request, or the amount
+                 * of data the client has been sending */
+                int size = max(needed, InputBufferSize(oc));
                 char *ibuf;
 
-                ibuf = (char *) realloc(oci->buffer, needed);
+                ibuf = (char *) realloc(oci->buffer, size);
                 if (!ibuf) {
                     YieldControlDeath();
                     return -1;
                 }
-                oci->size = needed;
+                oci->size = size;
                 oci->buffer = ibuf;
             }
             oci->bufptr = oci->buffer;
@@ -349,8 +412,11 @@ ReadRequestFromClient(ClientPtr client)
             YieldControlDeath();
             return -1;
         }
+        space = oci->size - oci->bufcnt;
         result = _XSERVTransRead(oc->trans_conn, oci->buffer + oci->bufcnt,
-                                 oci->size - oci->bufcnt);
+                                 space);
+        if (reqStatsEnabled)
+            ReqStatsCountRead(client);
         if (result <= 0) {
             if ((result < 0) && ETEST(errno)) {
                 mark_client_not_ready(client);
@@ -367,14 +433,17 @@ ReadRequestFromClient(ClientPtr client)
         }
         oci->bufcnt += result;
         gotnow += result;
+        AdaptInputBufferSize(oc, result, space, needed);
         /* free up some space after huge requests */
         if ((oci->size > BUFWATERMARK) &&
-            (oci->bufcnt < BUFSIZE) && (needed < BUFSIZE)) {
+            (oci->size > 2 * InputBufferSize(oc)) &&
+            (oci->bufcnt < InputBufferSize(oc)) &&
+            (needed < InputBufferSize(oc))) {
             char *ibuf;
 
-            ibuf = (char *) realloc(oci->buffer, BUFSIZE);
+            ibuf = (char *) realloc(oci->buffer, InputBufferSize(oc));
             if (ibuf) {
-                oci->size = BUFSIZE;
+                oci->size = InputBufferSize(oc);
                 oci->buffer = ibuf;
                 oci->bufptr = ibuf + oci->bufcnt - gotnow;
             }
@@ -661,36 +730,142 @@ AbortClient(ClientPtr client)
     }
 }
 
-/*****************
- * WriteToClient
- *    Copies buf into ClientPtr.buf if it fits (with padding), else
- *    flushes ClientPtr.buf and buf to client.  As of this writing,
- *    every use of WriteToClient is cast to void, and the result
- *    is ignored.  Potentially, this could be used by requests
- *    that are sending several chunks of data and want to break
- *    out of a loop on error.  Thus, we will leave the type of
- *    this routine as int.
- *****************/
+static void
+FreeOutputChunk(ConnectionOutputChunkPtr chunk)
+{
+    if (chunk->done)
+        (*chunk->done) (chunk->data, chunk->closure);
+    else
+        free(chunk->data);
+    free(chunk);
+}
 
-int
-WriteToClient(ClientPtr who, int count, const void *__buf)
+static void
+AppendOutputChunk(ConnectionOutputPtr oco, ConnectionOutputChunkPtr chunk)
 {
-    OsCommPtr oc;
-    ConnectionOutputPtr oco;
-    int padBytes;
-    const char *buf = __buf;
+    if (oco->chunkTail)
+        oco->chunkTail->next = chunk;
+    else
+        oco->chunks = chunk;
+    oco->chunkTail = chunk;
+    oco->queued += chunk->count - chunk->written + chunk->pad;
+}
 
-    BUG_RETURN_VAL_MSG(in_input_thread(), 0,
-                       "******** %s called from input thread *********\n", __func__);
+/* Throw away everything still waiting to be written */
+static void
+DiscardOutput(ConnectionOutputPtr oco)
+{
+    ConnectionOutputChunkPtr chunk;
 
+    while ((chunk = oco->chunks)) {
+        oco->chunks = chunk->next;
+        FreeOutputChunk(chunk);
+    }
+    oco->chunkTail = NULL;
+    oco->queued = 0;
+    oco->count = 0;
+}
+
+/* Append a copy of data, followed by pad zero bytes, to the pending output */
+static Bool
+QueueOutput(ConnectionOutputPtr oco, const char *data, long count, long pad)
+{
+    ConnectionOutputChunkPtr chunk = oco->chunkTail;
+    char *dst;
+
+    if (!chunk) {
+        if (oco->count + count + pad > oco->size) {
+            unsigned char *obuf = NULL;
+            long size = oco->count + count + pad + BUFSIZE;
+
+            if (size <= INT_MAX)
+                obuf = realloc(oco->buf, size);
+            if (!obuf)
+                return FALSE;
+            oco->size = size;
+            oco->buf = obuf;
+        }
+        dst = (char *) oco->buf + oco->count;
+        oco->count += count + pad;
+    }
+    else {
+        if (chunk->size - chunk->count < count + pad) {
+            long size = max(count + pad, BUFSIZE);
+
+            if (size > INT_MAX ||
+                !(chunk = calloc(1, sizeof(ConnectionOutputChunk))))
+                return FALSE;
+            if (!(chunk->data = malloc(size))) {
+                free(chunk);
+                return FALSE;
+            }
+            chunk->size = size;
+            AppendOutputChunk(oco, chunk);
+        }
+        dst = chunk->data + chunk->count;
+        chunk->count += count + pad;
+        oco->queued += count + pad;
+    }
+    memmove(dst, data, count);
+    memset(dst + count, 0, pad);
+    return TRUE;
+}
+
+/* Drop len written bytes from the front of the pending output, returns the
+ * number of them that went past its end */
+static long
+ConsumeOutput(ConnectionOutputPtr oco, long len)
+{
+    ConnectionOutputChunkPtr chunk;
+    long n;
+
+    if (oco->count) {
+        n = min(len, oco->count);
+        oco->count -= n;
+        memmove(oco->buf, oco->buf + n, oco->count);
+        len -= n;
+    }
+    while (len && (chunk = oco->chunks)) {
+        n = min(len, chunk->count + chunk->pad - chunk->written);
+        chunk->written += n;
+        oco->queued -= n;
+        len -= n;
+        if (chunk->written < chunk->count + chunk->pad)
+            break;
+        if (!(oco->chunks = chunk->next))
+            oco->chunkTail = NULL;
+        FreeOutputChunk(chunk);
+    }
+    return len;
+}
+
+static ConnectionOutputPtr
+ClientOutputBuffer(ClientPtr who)
+{
+    OsCommPtr oc = who->osPrivate;
+    ConnectionOutputPtr oco = oc->output;
+
+    if (!oco) {
+        if ((oco = FreeOutputs)) {
+            FreeOutputs = oco->next;
+        }
+        else if (!(oco = AllocateOutputBuffer())) {
+            AbortClient(who);
+            MarkClientException(who);
+            return NULL;
+        }
+        oc->output = oco;
+    }
+    return oco;
+}
+
+/* Account for output about to be sent to a client */
+static void
+NoteClientOutput(ClientPtr who, int count, int padBytes, const char *buf)
+{
 #ifdef DEBUG_COMMUNICATION
     Bool multicount = FALSE;
-#endif
-    if (!count || !who || who == serverClient || who->clientGone)
-        return 0;
-    oc = who->osPrivate;
-    oco = oc->output;
-#ifdef DEBUG_COMMUNICATION
+
     {
         char info[128];
         xError *err;
@@ -731,19 +906,8 @@ WriteToClient(ClientPtr who, int count, const void *__buf)
     }
 #endif
 
-    if (!oco) {
-        if ((oco = FreeOutputs)) {
-            FreeOutputs = oco->next;
-        }
-        else if (!(oco = AllocateOutputBuffer())) {
-            AbortClient(who);
-            MarkClientException(who);
-            return -1;
-        }
-        oc->output = oco;
-    }
-
-    padBytes = padding_for_int32(count);
+    if (reqStatsEnabled)
+        ReqStatsCountOutput(who, count + padBytes);
 
     if (ReplyCallback) {
         ReplyInfoRec replyinfo;
@@ -785,7 +949,43 @@ WriteToClient(ClientPtr who, int count, const void *__buf)
         }
     }
 #endif
-    if (oco->count == 0 || oco->count + count + padBytes > oco->size) {
+}
+
+/*****************
+ * WriteToClient
+ *    Copies buf into ClientPtr.buf if it fits (with padding), else
+ *    flushes ClientPtr.buf and buf to client.  As of this writing,
+ *    every use of WriteToClient is cast to void, and the result
+ *    is ignored.  Potentially, this could be used by requests
+ *    that are sending several chunks of data and want to break
+ *    out of a loop on error.  Thus, we will leave the type of
+ *    this routine as int.
+ *****************/
+
+int
+WriteToClient(ClientPtr who, int count, const void *__buf)
+{
+    OsCommPtr oc;
+    ConnectionOutputPtr oco;
+    int padBytes;
+    const char *buf = __buf;
+
+    BUG_RETURN_VAL_MSG(in_input_thread(), 0,
+                       "******** %s called from input thread *********\n", __func__);
+
+    if (!count || !who || who == serverClient || who->clientGone)
+        return 0;
+    oc = who->osPrivate;
+    if (!(oco = ClientOutputBuffer(who)))
+        return -1;
+
+    padBytes = padding_for_int32(count);
+    NoteClientOutput(who, count, padBytes, buf);
+
+    /* Once buffers handed over by WriteBufferToClient are queued, the
+     * client isn't keeping up and everything has to wait behind them */
+    if (!oco->chunks &&
+        (oco->count == 0 || oco->count + count + padBytes > oco->size)) {
         output_pending_clear(who);
         if (!any_output_pending()) {
             CriticalOutputPending = FALSE;
@@ -797,15 +997,81 @@ WriteToClient(ClientPtr who, int count, const void *__buf)
 
     NewOutputPending = TRUE;
     output_pending_mark(who);
-    memmove((char *) oco->buf + oco->count, buf, count);
-    oco->count += count;
-    if (padBytes) {
-        memset(oco->buf + oco->count, '\0', padBytes);
-        oco->count += padBytes;
+    if (!QueueOutput(oco, buf, count, padBytes)) {
+        AbortClient(who);
+        MarkClientException(who);
+        DiscardOutput(oco);
+        return -1;
     }
     return count;
 }
 
+/*****************
+ * WriteBufferToClient
+ *    Like WriteToClient, but takes over buf instead of copying it.
+ *    Large buffers are written to the client straight from buf, and
+ *    when the client can't take all of it at once, the rest stays
+ *    queued in place rather than being copied into ClientPtr.buf.
+ *    done(buf, closure) is called once buf is no longer needed, which
+ *    may happen before this returns; if done is NULL, buf is freed.
+ *    Until then, buf must not be modified.
+ *****************/
+
+int
+WriteBufferToClient(ClientPtr who, int count, void *buf,
+                    OutputBufferDoneProcPtr done, void *closure)
+{
+    ConnectionOutputPtr oco;
+    ConnectionOutputChunkPtr chunk = NULL;
+    Bool blocked;
+    int result;
+
+    /* small buffers are cheaper to copy than to queue */
+    if (count >= BUFSIZE && who && who != serverClient && !who->clientGone &&
+        !in_input_thread())
+        chunk = calloc(1, sizeof(ConnectionOutputChunk));
+
+    if (!chunk) {
+        result = WriteToClient(who, count, buf);
+        if (done)
+            (*done) (buf, closure);
+        else
+            free(buf);
+        return result;
+    }
+
+    chunk->data = buf;
+    chunk->count = count;
+    chunk->pad = padding_for_int32(count);
+    chunk->done = done;
+    chunk->closure = closure;
+
+    if (!(oco = ClientOutputBuffer(who))) {
+        FreeOutputChunk(chunk);
+        return -1;
+    }
+
+    NoteClientOutput(who, count, chunk->pad, buf);
+
+    blocked = oco->chunks != NULL;
+    AppendOutputChunk(oco, chunk);
+
+    if (blocked) {
+        NewOutputPending = TRUE;
+        output_pending_mark(who);
+        return count;
+    }
+
+    output_pending_clear(who);
+    if (!any_output_pending()) {
+        CriticalOutputPending = FALSE;
+        NewOutputPending = FALSE;
+    }
+
+    result = FlushClient(who, who->osPrivate, NULL, 0);
+    return result < 0 ? result : count;
+}
+
  /********************
  * FlushClient()
  *    If the client isn't keeping up with us, then we try to continue
@@ -821,10 +1087,11 @@ FlushClient(ClientPtr who, OsCommPtr oc, const void *__extraBuf, int extraCount)
 {
     ConnectionOutputPtr oco = oc->output;
     XtransConnInfo trans_conn = oc->trans_conn;
-    struct iovec iov[3];
+    struct iovec iov[OUTPUT_IOV];
     static char padBuffer[3];
     const char *extraBuf = __extraBuf;
-    long written;
+    ConnectionOutputChunkPtr chunk;
+    long written;               /* amount of extraBuf and its pad written */
     long padsize;
     long notWritten;
     long todo;
@@ -833,7 +1100,7 @@ FlushClient(ClientPtr who, OsCommPtr oc, const void *__extraBuf, int extraCount)
 	return 0;
     written = 0;
     padsize = padding_for_int32(extraCount);
-    notWritten = oco->count + extraCount + padsize;
+    notWritten = oco->count + oco->queued + extraCount + padsize;
     if (!notWritten)
         return 0;
 
@@ -842,46 +1109,40 @@ FlushClient(ClientPtr who, OsCommPtr oc, const void *__extraBuf, int extraCount)
 
     todo = notWritten;
     while (notWritten) {
-        long before = written;  /* amount of whole thing written */
         long remain = todo;     /* amount to try this time, <= notWritten */
         int i = 0;
         long len;
 
-        /* You could be very general here and have "in" and "out" iovecs
-         * and write a loop without using a macro, but what the heck.  This
-         * translates to:
-         *
-         *     how much of this piece is new?
-         *     if more new then we are trying this time, clamp
-         *     if nothing new
-         *         then bump down amount already written, for next piece
-         *         else put new stuff in iovec, will need all of next piece
+        /* Gather the pending output, then extraBuf and its padding, into
+         * at most OUTPUT_IOV pieces adding up to at most todo bytes.
+         * Whatever has been written already comes out with a length of
+         * zero or less and is skipped.
          *
          * Note that todo had better be at least 1 or else we'll end up
          * writing 0 iovecs.
          */
 #define InsertIOV(pointer, length) \
-	len = (length) - before; \
-	if (len > remain) \
-	    len = remain; \
-	if (len <= 0) { \
-	    before = (-len); \
-	} else { \
+	len = min((long) (length), remain); \
+	if (len > 0) { \
 	    iov[i].iov_len = len; \
-	    iov[i].iov_base = (pointer) + before;	\
-	    i++; \
-	    remain -= len; \
-	    before = 0; \
+	    iov[i].iov_base = (pointer); \
+	    remain = (++i < OUTPUT_IOV) ? remain - len : 0; \
 	}
 
         InsertIOV((char *) oco->buf, oco->count)
-            InsertIOV((char *) extraBuf, extraCount)
-            InsertIOV(padBuffer, padsize)
+        for (chunk = oco->chunks; chunk && remain; chunk = chunk->next) {
+            InsertIOV(chunk->data + chunk->written,
+                      chunk->count - chunk->written)
+            InsertIOV(padBuffer, chunk->count + chunk->pad -
+                      max(chunk->written, chunk->count))
+        }
+        InsertIOV((char *) extraBuf + written, extraCount - written)
+        InsertIOV(padBuffer, extraCount + padsize - max(written, extraCount))
 
-            errno = 0;
+        errno = 0;
         if (trans_conn && (len = _XSERVTransWritev(trans_conn, iov, i)) >= 0) {
-            written += len;
             notWritten -= len;
+            written += ConsumeOutput(oco, len);
             todo = notWritten;
         }
         else if (ETEST(errno)
@@ -895,44 +1156,25 @@ FlushClient(ClientPtr who, OsCommPtr oc, const void *__extraBuf, int extraCount)
             /* If we've arrived here, then the client is stuffed to the gills
                and not ready to accept more.  Make a note of it and buffer
                the rest. */
-            output_pending_mark(who);
+            Bool queued = TRUE;
 
-            if (written < oco->count) {
-                if (written > 0) {
-                    oco->count -= written;
-                    memmove((char *) oco->buf,
-                            (char *) oco->buf + written, oco->count);
-                    written = 0;
-                }
-            }
-            else {
-                written -= oco->count;
-                oco->count = 0;
-            }
-
-            if (notWritten > oco->size) {
-                unsigned char *obuf = NULL;
-
-                if (notWritten + BUFSIZE <= INT_MAX) {
-                    obuf = realloc(oco->buf, notWritten + BUFSIZE);
-                }
-                if (!obuf) {
-                    AbortClient(who);
-                    MarkClientException(who);
-                    oco->count = 0;
-                    return -1;
-                }
-                oco->size = notWritten + BUFSIZE;
-                oco->buf = obuf;
-            }
+            output_pending_mark(who);
 
             /* If the amount written extended into the padBuffer, then the
                difference "extraCount - written" may be less than 0 */
-            if ((len = extraCount - written) > 0)
-                memmove((char *) oco->buf + oco->count,
-                        extraBuf + written, len);
+            if (written < extraCount)
+                queued = QueueOutput(oco, extraBuf + written,
+                                     extraCount - written, padsize);
+            else if (written < extraCount + padsize)
+                queued = QueueOutput(oco, padBuffer, 0,
+                                     extraCount + padsize - written);
+            if (!queued) {
+                AbortClient(who);
+                MarkClientException(who);
+                DiscardOutput(oco);
+                return -1;
+            }
 
-            oco->count = notWritten;    /* this will include the pad */
             ospoll_listen(server_poll, oc->fd, X_NOTIFY_WRITE);
 
             /* return only the amount explicitly requested */
@@ -946,7 +1188,7 @@ FlushClient(ClientPtr who, OsCommPtr oc, const void *__extraBuf, int extraCount)
         else {
             AbortClient(who);
             MarkClientException(who);
-            oco->count = 0;
+            DiscardOutput(oco);
             return -1;
         }
     }
@@ -1003,6 +1245,9 @@ AllocateOutputBuffer(void)
     }
     oco->size = BUFSIZE;
     oco->count = 0;
+    oco->chunks = NULL;
+    oco->chunkTail = NULL;
+    oco->queued = 0;
     return oco;
 }
 
@@ -1015,7 +1260,7 @@ FreeOsBuffers(OsCommPtr oc)
     if (AvailableInput == oc)
         AvailableInput = (OsCommPtr) NULL;
     if ((oci = oc->input)) {
-        if (FreeInputs) {
+        if (FreeInputs || oci->size > BUFWATERMARK) {
             free(oci->buffer);
             free(oci);
         }
@@ -1029,6 +1274,7 @@ FreeOsBuffers(OsCommPtr oc)
         }
     }
     if ((oco = oc->output)) {
+        DiscardOutput(oco);
         if (FreeOutputs) {
             free(oco->buf);
             free(oco);
@@ -1036,7 +1282,6 @@ FreeOsBuffers(OsCommPtr oc)
         else {
             FreeOutputs = oco;
             oco->next = (ConnectionOutputPtr) NULL;
-            oco->count = 0;
         }
     }
 }
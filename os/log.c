@@ -96,6 +96,11 @@ OR PERFORMANCE OF THIS SOFTWARE.
 #define getpid(x) _getpid(x)
 #endif
 
+#ifdef INPUTTHREAD
+#include <pthread.h>
+#include <signal.h>
+#endif
+
 #ifdef XF86BIGFONT
 #include "xf86bigfontsrv.h"
 #endif
@@ -120,6 +125,17 @@ static char *saveBuffer = NULL;
 static int bufferSize = 0, bufferUnused = 0, bufferPos = 0;
 static Bool needBuffer = TRUE;
 
+/* Whether to start the log writer thread once the log file is open. */
+static Bool logAsyncWanted = FALSE;
+
+/* Messages per second allowed through, 0 for no limit. */
+static int logRateLimit = 0;
+static unsigned long logRateLimited = 0;
+static unsigned long logQueueFull = 0;
+#ifdef INPUTTHREAD
+static pthread_mutex_t logRateLock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
 #ifdef __APPLE__
 #include <AvailabilityMacros.h>
 
@@ -237,6 +253,246 @@ LogFilePrep(const char *fname, const char *backup, const char *idstring)
  * string (or to a string containing the pid if the display is not yet set).
  */
 
+#ifdef INPUTTHREAD
+
+/*
+ * With XLOG_ASYNC, what goes to the log file is copied into a ring buffer
+ * and written out by a thread of its own, so a slow disk never stalls the
+ * thread that logged.  Messages are still formatted by the caller; only
+ * the write() moves.  Loggers serialize on logAsync.lock, and when the ring
+ * is full the line is dropped and counted rather than waited for.
+ *
+ * Signal handlers can't take the lock.  The first thing logged in signal
+ * context abandons the writer and writes out whatever is still queued
+ * itself, so a crash never loses the lines leading up to it; a line the
+ * writer was busy with at that moment may appear twice.
+ */
+
+#define LOG_RING_SIZE   (256 * 1024)
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_t thread;
+    Bool running;
+    Bool sleeping;
+    Bool stop;
+    Bool dropping;              /* rest of the current line is dropped */
+    int abandoned;
+    unsigned long unreported;   /* drops not yet noted in the log */
+    char *ring;
+    uint64_t head;              /* bytes ever queued */
+    uint64_t tail;              /* bytes ever written */
+} logAsync = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+};
+
+/* This must be signal safe. */
+static void
+LogAsyncWriteOut(uint64_t from, uint64_t to)
+{
+    while (from != to) {
+        size_t offset = from % LOG_RING_SIZE;
+        size_t len = min(to - from, LOG_RING_SIZE - offset);
+        ssize_t ret = write(logFileFd, logAsync.ring + offset, len);
+
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret <= 0)
+            break;
+        from += ret;
+    }
+}
+
+static void *
+LogAsyncThread(void *arg)
+{
+    uint64_t head, tail;
+
+    pthread_mutex_lock(&logAsync.lock);
+    for (;;) {
+        head = logAsync.head;
+        tail = logAsync.tail;
+        if (head == tail) {
+            if (logAsync.stop)
+                break;
+            logAsync.sleeping = TRUE;
+            pthread_cond_wait(&logAsync.wake, &logAsync.lock);
+            logAsync.sleeping = FALSE;
+            continue;
+        }
+        pthread_mutex_unlock(&logAsync.lock);
+
+        if (__atomic_load_n(&logAsync.abandoned, __ATOMIC_ACQUIRE))
+            return NULL;
+        LogAsyncWriteOut(tail, head);
+#ifndef WIN32
+        if (logFlush && logSync)
+            fsync(logFileFd);
+#endif
+
+        pthread_mutex_lock(&logAsync.lock);
+        __atomic_store_n(&logAsync.tail, head, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&logAsync.lock);
+    return NULL;
+}
+
+static Bool
+LogAsyncStart(void)
+{
+    sigset_t set, old;
+    int ret;
+
+    logAsyncWanted = TRUE;
+    if (logAsync.running || !logFile)
+        return TRUE;
+
+    if (!logAsync.ring && !(logAsync.ring = malloc(LOG_RING_SIZE)))
+        return FALSE;
+    logAsync.head = logAsync.tail = 0;
+    logAsync.stop = FALSE;
+    logAsync.dropping = FALSE;
+    logAsync.abandoned = FALSE;
+
+    /* The writer must never handle signals */
+    sigfillset(&set);
+    pthread_sigmask(SIG_SETMASK, &set, &old);
+    ret = pthread_create(&logAsync.thread, NULL, LogAsyncThread, NULL);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (ret != 0)
+        return FALSE;
+
+    logAsync.running = TRUE;
+    return TRUE;
+}
+
+/* Waits for everything queued to be written, unless in signal context */
+static void
+LogAsyncStop(Bool forget)
+{
+    if (forget)
+        logAsyncWanted = FALSE;
+    if (!logAsync.running || inSignalContext ||
+        __atomic_load_n(&logAsync.abandoned, __ATOMIC_ACQUIRE))
+        return;
+
+    pthread_mutex_lock(&logAsync.lock);
+    logAsync.stop = TRUE;
+    pthread_cond_signal(&logAsync.wake);
+    pthread_mutex_unlock(&logAsync.lock);
+    pthread_join(logAsync.thread, NULL);
+    logAsync.running = FALSE;
+}
+
+/* This must be signal safe. */
+static void
+LogAsyncAbandon(void)
+{
+    if (!logAsync.running ||
+        __atomic_exchange_n(&logAsync.abandoned, TRUE, __ATOMIC_ACQ_REL))
+        return;
+
+    LogAsyncWriteOut(__atomic_load_n(&logAsync.tail, __ATOMIC_ACQUIRE),
+                     __atomic_load_n(&logAsync.head, __ATOMIC_ACQUIRE));
+}
+
+/* Called with logAsync.lock held */
+static Bool
+LogAsyncCopy(const char *buf, size_t len)
+{
+    uint64_t head = logAsync.head;
+    size_t offset = head % LOG_RING_SIZE;
+    size_t first = min(len, LOG_RING_SIZE - offset);
+
+    if (len > LOG_RING_SIZE - (head - logAsync.tail))
+        return FALSE;
+
+    memcpy(logAsync.ring + offset, buf, first);
+    memcpy(logAsync.ring, buf + first, len - first);
+    __atomic_store_n(&logAsync.head, head + len, __ATOMIC_RELEASE);
+    return TRUE;
+}
+
+/*
+ * Queue part of a log line, with prefix being the timestamp if this starts
+ * a line.  Returns FALSE if the writer isn't running, in which case the
+ * caller writes to the log file itself.
+ */
+static Bool
+LogAsyncQueue(const char *prefix, const char *buf, size_t len)
+{
+    char note[64];
+    int note_len;
+
+    if (!logAsync.running ||
+        __atomic_load_n(&logAsync.abandoned, __ATOMIC_ACQUIRE))
+        return FALSE;
+
+    pthread_mutex_lock(&logAsync.lock);
+    if (prefix) {
+        logAsync.dropping = FALSE;
+        if (logAsync.unreported) {
+            note_len = snprintf(note, sizeof(note),
+                                "%s(WW) %lu log messages dropped\n", prefix,
+                                logAsync.unreported);
+            if (LogAsyncCopy(note, note_len))
+                logAsync.unreported = 0;
+            else
+                logAsync.dropping = TRUE;
+        }
+        if (!logAsync.dropping &&
+            LOG_RING_SIZE - (logAsync.head - logAsync.tail) <
+            strlen(prefix) + len)
+            logAsync.dropping = TRUE;
+        if (!logAsync.dropping)
+            LogAsyncCopy(prefix, strlen(prefix));
+        else {
+            logAsync.unreported++;
+            logQueueFull++;
+        }
+    }
+    if (!logAsync.dropping && !LogAsyncCopy(buf, len)) {
+        /* cut the line short rather than run it into the next one */
+        LogAsyncCopy("\n", 1);
+        logAsync.dropping = TRUE;
+        logAsync.unreported++;
+        logQueueFull++;
+    }
+    if (logAsync.sleeping)
+        pthread_cond_signal(&logAsync.wake);
+    pthread_mutex_unlock(&logAsync.lock);
+
+    return TRUE;
+}
+
+#else
+
+static Bool
+LogAsyncStart(void)
+{
+    return FALSE;
+}
+
+static void
+LogAsyncStop(Bool forget)
+{
+}
+
+static void
+LogAsyncAbandon(void)
+{
+}
+
+static Bool
+LogAsyncQueue(const char *prefix, const char *buf, size_t len)
+{
+    return FALSE;
+}
+
+#endif
+
 static char *saved_log_fname;
 static char *saved_log_backup;
 static char *saved_log_tempname;
@@ -277,6 +533,9 @@ LogInit(const char *fname, const char *backup)
             fsync(fileno(logFile));
 #endif
         }
+
+        if (logAsyncWanted && !LogAsyncStart())
+            ErrorF("Cannot start the log writer thread, logging synchronously\n");
     }
 
     /*
@@ -328,6 +587,12 @@ LogClose(enum ExitCode error)
 {
     if (logFile) {
         int msgtype = (error == EXIT_NO_ERROR) ? X_INFO : X_ERROR;
+
+        LogAsyncStop(FALSE);
+        if (logQueueFull || logRateLimited)
+            LogMessageVerbSigSafe(X_WARNING, -1,
+                    "%lu log messages dropped, %lu rate limited\n",
+                    logQueueFull, logRateLimited);
         LogMessageVerbSigSafe(msgtype, -1,
                 "Server terminated %s (%d). Closing log file.\n",
                 (error == EXIT_NO_ERROR) ? "successfully" : "with error",
@@ -354,11 +619,27 @@ LogSetParameter(LogParameter param, int value)
     case XLOG_FILE_VERBOSITY:
         logFileVerbosity = value;
         return TRUE;
+    case XLOG_ASYNC:
+        if (value)
+            return LogAsyncStart();
+        LogAsyncStop(TRUE);
+        return TRUE;
+    case XLOG_RATE_LIMIT:
+        logRateLimit = max(value, 0);
+        return TRUE;
     default:
         return FALSE;
     }
 }
 
+/* Counts of messages lost to a full log queue and to XLOG_RATE_LIMIT */
+void
+LogGetDropped(unsigned long *queue_full, unsigned long *rate_limited)
+{
+    *queue_full = logQueueFull;
+    *rate_limited = logRateLimited;
+}
+
 enum {
     LMOD_LONG     = 0x1,
     LMOD_LONGLONG = 0x2,
@@ -603,6 +884,7 @@ LogSWrite(int verb, const char *buf, size_t len, Bool end_line)
 
     if (verb < 0 || logFileVerbosity >= verb) {
         if (inSignalContext && logFileFd >= 0) {
+            LogAsyncAbandon();
             ret = write(logFileFd, buf, len);
 #ifndef WIN32
             if (logFlush && logSync)
@@ -610,17 +892,24 @@ LogSWrite(int verb, const char *buf, size_t len, Bool end_line)
 #endif
         }
         else if (!inSignalContext && logFile) {
+            char stamp[32];
+
             if (newline)
-                fprintf(logFile, "[%10.3f] ", GetTimeInMillis() / 1000.0);
-            newline = end_line;
-            fwrite(buf, len, 1, logFile);
-            if (logFlush) {
-                fflush(logFile);
+                snprintf(stamp, sizeof(stamp), "[%10.3f] ",
+                         GetTimeInMillis() / 1000.0);
+            if (!LogAsyncQueue(newline ? stamp : NULL, buf, len)) {
+                if (newline)
+                    fputs(stamp, logFile);
+                fwrite(buf, len, 1, logFile);
+                if (logFlush) {
+                    fflush(logFile);
 #ifndef WIN32
-                if (logSync)
-                    fsync(fileno(logFile));
+                    if (logSync)
+                        fsync(fileno(logFile));
 #endif
+                }
             }
+            newline = end_line;
         }
         else if (!inSignalContext && needBuffer) {
             if (len > bufferUnused) {
@@ -658,6 +947,56 @@ LogWrite(int verb, const char *f, ...)
     va_end(args);
 }
 
+/*
+ * Token bucket for XLOG_RATE_LIMIT: up to logRateLimit messages a second
+ * get through, in bursts of as many.  Errors and messages logged at
+ * verbosity 0 or below are never held back.  The first message let
+ * through after some were held back is preceded by a count of them.
+ * The bucket has a lock of its own, so that logging from the input thread
+ * never waits for the input lock.
+ */
+static Bool
+LogRateLimited(MessageType type, int verb)
+{
+    static CARD32 last;
+    static int tokens;
+    unsigned long suppressed = 0;
+    Bool limited = FALSE;
+    CARD32 now, refill;
+
+    if (!logRateLimit || type == X_ERROR || verb <= 0)
+        return FALSE;
+
+#ifdef INPUTTHREAD
+    pthread_mutex_lock(&logRateLock);
+#endif
+    now = GetTimeInMillis();
+    refill = (CARD64) (now - last) * logRateLimit / 1000;
+    if (refill > 0) {
+        tokens = min((CARD64) tokens + refill, logRateLimit);
+        last = now;
+    }
+    if (tokens > 0) {
+        static unsigned long reported;
+
+        tokens--;
+        suppressed = logRateLimited - reported;
+        reported = logRateLimited;
+    }
+    else {
+        logRateLimited++;
+        limited = TRUE;
+    }
+#ifdef INPUTTHREAD
+    pthread_mutex_unlock(&logRateLock);
+#endif
+
+    if (suppressed)
+        LogMessageVerb(X_WARNING, 0, "%lu log messages held back by the "
+                       "rate limit\n", suppressed);
+    return limited;
+}
+
 /* Returns the Message Type string to prepend to a logging message, or NULL
  * if the message will be dropped due to insufficient verbosity. */
 static const char *
@@ -714,7 +1053,7 @@ LogVMessageVerb(MessageType type, int verb, const char *format, va_list args)
     }
 
     type_str = LogMessageTypeVerbString(type, verb);
-    if (!type_str)
+    if (!type_str || LogRateLimited(type, verb))
         return;
 
     /* if type_str is not "", prepend it and ' ', to message */
@@ -814,6 +1153,8 @@ LogVHdrMessageVerb(MessageType type, int verb, const char *msg_format,
         vprintf_func = vpnprintf;
         printf_func = pnprintf;
     } else {
+        if (LogRateLimited(type, verb))
+            return;
         vprintf_func = Xvscnprintf;
         printf_func = Xscnprintf;
     }
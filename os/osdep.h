@@ -119,6 +119,7 @@ typedef struct _osComm {
     CARD32 conn_time;           /* timestamp if not established, else 0  */
     struct _XtransConnInfo *trans_conn; /* transport connection object */
     int flags;
+    int input_size;             /* input buffer size for recent traffic */
 } OsCommRec, *OsCommPtr;
 
 #define OS_COMM_GRAB_IMPERVIOUS 1
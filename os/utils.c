@@ -103,8 +103,10 @@ __stdcall unsigned long GetTickCount(void);
 #endif
 
 #include "opaque.h"
+#include "site.h"
 
 #include "dixstruct.h"
+#include "reqstats.h"
 
 #include "xkbsrv.h"
 
@@ -139,6 +141,7 @@ Bool noMITShmExtension = FALSE;
 Bool noRRExtension = FALSE;
 #endif
 Bool noRenderExtension = FALSE;
+Bool noReqStatsExtension = FALSE;
 
 #ifdef XCSECURITY
 Bool noSecurityExtension = FALSE;
@@ -185,6 +188,14 @@ Bool CoreDump;
 
 Bool enableIndirectGLX = FALSE;
 
+int RenderThreads = 0;
+
+int TimerSlack = 0;
+
+int GlyphMemoryLimit = 0;
+
+Bool GlyphHashSHA1 = FALSE;
+
 #ifdef PANORAMIX
 Bool PanoramiXExtensionDisabledHack = FALSE;
 #endif
@@ -528,6 +539,8 @@ UseMsg(void)
     ErrorF("-fc string             cursor font\n");
     ErrorF("-fn string             default font name\n");
     ErrorF("-fp string             default font path\n");
+    ErrorF("-glyphhash xxh64|sha1  hash used to share identical glyphs\n");
+    ErrorF("-glyphmem kilobytes    per-screen memory budget for glyph pictures\n");
     ErrorF("-help                  prints message with these options\n");
     ErrorF("+iglx                  Allow creating indirect GLX contexts\n");
     ErrorF("-iglx                  Prohibit creating indirect GLX contexts (default)\n");
@@ -554,18 +567,22 @@ UseMsg(void)
     ErrorF("-pn                    accept failure to listen on all ports\n");
     ErrorF("-nopn                  reject failure to listen on all ports\n");
     ErrorF("-r                     turns off auto-repeat\n");
+    ErrorF("-reqstats              collect per-request dispatch statistics\n");
     ErrorF("r                      turns on auto-repeat \n");
     ErrorF("-render [default|mono|gray|color] set render color alloc policy\n");
+    ErrorF("-renderthreads n       split large software rendering across n threads\n");
     ErrorF("-retro                 start with classic stipple and cursor\n");
     ErrorF("-s #                   screen-saver timeout (minutes)\n");
     ErrorF("-seat string           seat to run on\n");
     ErrorF("-t #                   default pointer threshold (pixels/t)\n");
     ErrorF("-terminate             terminate at server reset\n");
+    ErrorF("-timerslack ms         let timers run up to ms late to share wakeups\n");
     ErrorF("-to #                  connection time out\n");
     ErrorF("-tst                   disable testing extensions\n");
     ErrorF("ttyxx                  server started from init on /dev/ttyxx\n");
     ErrorF("v                      video blanking for screen-saver\n");
     ErrorF("-v                     screen-saver without video blanking\n");
+    ErrorF("-verbose [n]           verbose startup messages\n");
     ErrorF("-wm                    WhenMapped default backing-store\n");
     ErrorF("-wr                    create root window with white background\n");
     ErrorF("-maxbigreqsize         set maximal bigrequest size \n");
@@ -576,6 +593,7 @@ UseMsg(void)
     ErrorF
         ("-dumbSched             Disable smart scheduling and threaded input, enable old behavior\n");
     ErrorF("-schedInterval int     Set scheduler interval in msec\n");
+    ErrorF("-schedChargeTime       Penalize clients for every slice their requests take\n");
     ErrorF("-sigstop               Enable SIGSTOP based startup\n");
     ErrorF("+extension name        Enable extension\n");
     ErrorF("-extension name        Disable extension\n");
@@ -794,6 +812,24 @@ ProcessCommandLine(int argc, char *argv[])
             else
                 UseMsg();
         }
+        else if (strcmp(argv[i], "-glyphhash") == 0) {
+            if (++i < argc) {
+                if (!strcmp(argv[i], "sha1"))
+                    GlyphHashSHA1 = TRUE;
+                else if (!strcmp(argv[i], "xxh64"))
+                    GlyphHashSHA1 = FALSE;
+                else
+                    UseMsg();
+            }
+            else
+                UseMsg();
+        }
+        else if (strcmp(argv[i], "-glyphmem") == 0) {
+            if (++i < argc)
+                GlyphMemoryLimit = max(atoi(argv[i]), 0);
+            else
+                UseMsg();
+        }
         else if (strcmp(argv[i], "-help") == 0) {
             UseMsg();
             exit(0);
@@ -930,6 +966,12 @@ ProcessCommandLine(int argc, char *argv[])
         else if (strcmp(argv[i], "-terminate") == 0) {
             dispatchExceptionAtReset = DE_TERMINATE;
         }
+        else if (strcmp(argv[i], "-timerslack") == 0) {
+            if (++i < argc)
+                TimerSlack = max(atoi(argv[i]), 0);
+            else
+                UseMsg();
+        }
         else if (strcmp(argv[i], "-to") == 0) {
             if (++i < argc)
                 TimeOutValue = ((CARD32) atoi(argv[i])) * MILLI_PER_SECOND;
@@ -943,6 +985,15 @@ ProcessCommandLine(int argc, char *argv[])
             defaultScreenSaverBlanking = PreferBlanking;
         else if (strcmp(argv[i], "-v") == 0)
             defaultScreenSaverBlanking = DontPreferBlanking;
+        else if (strcmp(argv[i], "-verbose") == 0) {
+            static int verbosity = DEFAULT_LOG_VERBOSITY;
+
+            if (i + 1 < argc && isdigit(argv[i + 1][0]))
+                verbosity = atoi(argv[++i]);
+            else
+                verbosity++;
+            LogSetParameter(XLOG_VERBOSITY, verbosity);
+        }
         else if (strcmp(argv[i], "-wm") == 0)
             defaultBackingStore = WhenMapped;
         else if (strcmp(argv[i], "-wr") == 0)
@@ -1008,6 +1059,9 @@ ProcessCommandLine(int argc, char *argv[])
             else
                 UseMsg();
         }
+        else if (strcmp(argv[i], "-schedChargeTime") == 0) {
+            SmartScheduleChargeTime = TRUE;
+        }
         else if (strcmp(argv[i], "-schedMax") == 0) {
             if (++i < argc) {
                 SmartScheduleMaxSlice = atoi(argv[i]);
@@ -1027,6 +1081,15 @@ ProcessCommandLine(int argc, char *argv[])
             else
                 UseMsg();
         }
+        else if (strcmp(argv[i], "-renderthreads") == 0) {
+            if (++i < argc)
+                RenderThreads = atoi(argv[i]);
+            else
+                UseMsg();
+        }
+        else if (strcmp(argv[i], "-reqstats") == 0) {
+            reqStatsEnabled = TRUE;
+        }
         else if (strcmp(argv[i], "-sigstop") == 0) {
             RunFromSigStopParent = TRUE;
         }
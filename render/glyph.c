@@ -44,6 +44,7 @@
 #include "picturestr.h"
 #include "glyphstr.h"
 #include "mipict.h"
+#include "opaque.h"
 
 /*
  * From Knuth -- a good choice for hash/rehash values is p, p-2 where
@@ -82,6 +83,23 @@ static GlyphHashSetRec glyphHashSets[] = {
 
 static GlyphHashRec globalGlyphs[GlyphFormatNum];
 
+/*
+ * Glyphs holding pictures, most recently drawn first, and the bytes of
+ * picture storage they use on each screen.  With -glyphmem, the coldest
+ * glyphs give up their pictures whenever a screen goes over the budget;
+ * the image is kept in glyph->bits until the glyph is drawn again.
+ */
+static struct xorg_list glyphLRU = { &glyphLRU, &glyphLRU };
+static unsigned long glyphPictureBytes[MAXSCREENS];
+
+static unsigned long
+GlyphPictureBytes(GlyphPtr glyph)
+{
+    return (unsigned long) PixmapBytePad(glyph->info.width,
+                                         glyph->format->depth) *
+        glyph->info.height;
+}
+
 void
 GlyphUninit(ScreenPtr pScreen)
 {
@@ -99,8 +117,12 @@ GlyphUninit(ScreenPtr pScreen)
                 if (GetGlyphPicture(glyph, pScreen)) {
                     FreePicture((void *) GetGlyphPicture(glyph, pScreen), 0);
                     SetGlyphPicture(glyph, pScreen, NULL);
+                    glyphPictureBytes[pScreen->myNum] -=
+                        GlyphPictureBytes(glyph);
                 }
-                (*ps->UnrealizeGlyph) (pScreen, glyph);
+                xorg_list_del(&glyph->lru);
+                if (!glyph->evicted)
+                    (*ps->UnrealizeGlyph) (pScreen, glyph);
             }
         }
     }
@@ -200,6 +222,268 @@ FindGlyphByHash(unsigned char sha1[20], int format)
         return NULL;
 }
 
+/*
+ * Unless -glyphhash sha1 is given, glyphs are keyed by XXH64, which is
+ * several times cheaper than SHA1 but makes no promise about
+ * collisions.  A hash match is therefore only trusted once the images
+ * compare equal, the stored one being read back from the glyph's
+ * picture unless it was evicted to glyph->bits.  A glyph that collides
+ * with a different one is keyed by the next hash in a chain seeded by
+ * its own hash; lookups walk the same chain.  The 20 bytes of
+ * glyph->sha1 hold the hash in use, its position in the chain and the
+ * hash the chain started from, so that equal images always end up with
+ * equal keys.
+ */
+#define XXH_PRIME64_1   0x9E3779B185EBCA87ULL
+#define XXH_PRIME64_2   0xC2B2AE3D27D4EB4FULL
+#define XXH_PRIME64_3   0x165667B19E3779F9ULL
+#define XXH_PRIME64_4   0x85EBCA77C2B2AE63ULL
+#define XXH_PRIME64_5   0x27D4EB2F165667C5ULL
+
+static inline uint64_t
+xxh64_rotl(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t
+xxh64_read64(const CARD8 *p)
+{
+    uint64_t v;
+
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t
+xxh64_read32(const CARD8 *p)
+{
+    uint32_t v;
+
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t
+xxh64_round(uint64_t acc, uint64_t input)
+{
+    acc += input * XXH_PRIME64_2;
+    acc = xxh64_rotl(acc, 31);
+    return acc * XXH_PRIME64_1;
+}
+
+static inline uint64_t
+xxh64_merge(uint64_t acc, uint64_t val)
+{
+    acc ^= xxh64_round(0, val);
+    return acc * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+static uint64_t
+xxh64(const void *data, size_t len, uint64_t seed)
+{
+    const CARD8 *p = data;
+    const CARD8 *end = p + len;
+    uint64_t h;
+
+    if (len >= 32) {
+        const CARD8 *limit = end - 32;
+        uint64_t v1 = seed + XXH_PRIME64_1 + XXH_PRIME64_2;
+        uint64_t v2 = seed + XXH_PRIME64_2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - XXH_PRIME64_1;
+
+        do {
+            v1 = xxh64_round(v1, xxh64_read64(p));
+            v2 = xxh64_round(v2, xxh64_read64(p + 8));
+            v3 = xxh64_round(v3, xxh64_read64(p + 16));
+            v4 = xxh64_round(v4, xxh64_read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+
+        h = xxh64_rotl(v1, 1) + xxh64_rotl(v2, 7) +
+            xxh64_rotl(v3, 12) + xxh64_rotl(v4, 18);
+        h = xxh64_merge(h, v1);
+        h = xxh64_merge(h, v2);
+        h = xxh64_merge(h, v3);
+        h = xxh64_merge(h, v4);
+    }
+    else
+        h = seed + XXH_PRIME64_5;
+
+    h += len;
+    for (; p + 8 <= end; p += 8) {
+        h ^= xxh64_round(0, xxh64_read64(p));
+        h = xxh64_rotl(h, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+    }
+    if (p + 4 <= end) {
+        h ^= xxh64_read32(p) * XXH_PRIME64_1;
+        h = xxh64_rotl(h, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+        p += 4;
+    }
+    for (; p < end; p++) {
+        h ^= *p * XXH_PRIME64_5;
+        h = xxh64_rotl(h, 11) * XXH_PRIME64_1;
+    }
+
+    h ^= h >> 33;
+    h *= XXH_PRIME64_2;
+    h ^= h >> 29;
+    h *= XXH_PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+static void
+SetGlyphHash(unsigned char hash[20], uint64_t start, CARD32 step)
+{
+    uint64_t h = step ? xxh64(&start, sizeof(start), step) : start;
+
+    memcpy(hash, &h, sizeof(h));
+    memcpy(hash + 8, &step, sizeof(step));
+    memcpy(hash + 12, &start, sizeof(start));
+}
+
+static void
+NextGlyphHash(unsigned char hash[20])
+{
+    uint64_t start;
+    CARD32 step;
+
+    memcpy(&step, hash + 8, sizeof(step));
+    memcpy(&start, hash + 12, sizeof(start));
+    SetGlyphHash(hash, start, step + 1);
+}
+
+/* Copy the image of a glyph with a format and a non-empty size. */
+static Bool
+GetGlyphImage(GlyphPtr glyph, CARD8 *bits)
+{
+    PicturePtr pPicture = NULL;
+    DrawablePtr pDrawable;
+    int i;
+
+    if (glyph->bits) {
+        memcpy(bits, glyph->bits, GlyphPictureBytes(glyph));
+        return TRUE;
+    }
+
+    for (i = 0; i < screenInfo.numScreens && !pPicture; i++)
+        pPicture = GetGlyphPicture(glyph, screenInfo.screens[i]);
+    if (!pPicture)
+        return FALSE;
+
+    pDrawable = pPicture->pDrawable;
+    (*pDrawable->pScreen->GetImage) (pDrawable, 0, 0,
+                                     glyph->info.width, glyph->info.height,
+                                     ZPixmap, ~0, (char *) bits);
+    return TRUE;
+}
+
+/* Compare two images of the glyph, ignoring the padding of each row. */
+static Bool
+GlyphImageEqual(GlyphPtr glyph, const CARD8 *a, const CARD8 *b)
+{
+    int depth = glyph->format->depth;
+    int stride = PixmapBytePad(glyph->info.width, depth);
+    int rowbits = glyph->info.width * BitsPerPixel(depth);
+    int whole = rowbits >> 3, rest = rowbits & 7;
+    CARD8 mask = 0;
+    int y;
+
+    if (rest) {
+        int order = BitsPerPixel(depth) == 1 ? screenInfo.bitmapBitOrder :
+            screenInfo.imageByteOrder;
+
+        mask = order == MSBFirst ? 0xff << (8 - rest) : (1 << rest) - 1;
+    }
+
+    for (y = 0; y < glyph->info.height; y++) {
+        if (memcmp(a, b, whole) != 0)
+            return FALSE;
+        if (rest && ((a[whole] ^ b[whole]) & mask))
+            return FALSE;
+        a += stride;
+        b += stride;
+    }
+    return TRUE;
+}
+
+/*
+ * Whether the glyph has this info and image.  Anything that stops the
+ * comparison counts as a mismatch, which costs a duplicate glyph at
+ * worst.
+ */
+static Bool
+GlyphMatchesImage(GlyphPtr glyph, xGlyphInfo * gi, CARD8 *bits)
+{
+    CARD8 *image;
+    Bool match;
+
+    if (memcmp(&glyph->info, gi, sizeof(xGlyphInfo)) != 0)
+        return FALSE;
+    if (!glyph->format || !gi->width || !gi->height)
+        return TRUE;
+    if (glyph->bits)
+        return GlyphImageEqual(glyph, glyph->bits, bits);
+
+    image = malloc(GlyphPictureBytes(glyph));
+    if (!image)
+        return FALSE;
+    match = GetGlyphImage(glyph, image) &&
+        GlyphImageEqual(glyph, image, bits);
+    free(image);
+    return match;
+}
+
+static Bool
+GlyphsMatch(GlyphPtr a, GlyphPtr b)
+{
+    CARD8 *image;
+    Bool match;
+
+    if (a->format && b->format && a->format->depth != b->format->depth)
+        return FALSE;
+    if (!b->format || !b->info.width || !b->info.height)
+        return memcmp(&a->info, &b->info, sizeof(xGlyphInfo)) == 0;
+
+    image = malloc(GlyphPictureBytes(b));
+    if (!image)
+        return FALSE;
+    match = GetGlyphImage(b, image) && GlyphMatchesImage(a, &b->info, image);
+    free(image);
+    return match;
+}
+
+/*
+ * Look for a glyph in the global table with this info and image.  If
+ * there is none, hash is left holding the key a new glyph should use.
+ */
+int
+FindGlyphByImage(xGlyphInfo * gi, CARD8 *bits, unsigned long size,
+                 int format, unsigned char hash[20], GlyphPtr *glyph_return)
+{
+    GlyphPtr glyph;
+    int err;
+
+    if (GlyphHashSHA1) {
+        err = HashGlyph(gi, bits, size, hash);
+        if (err)
+            return err;
+        *glyph_return = FindGlyphByHash(hash, format);
+        return Success;
+    }
+
+    SetGlyphHash(hash, xxh64(bits, size,
+                             xxh64(gi, sizeof(xGlyphInfo), 0)), 0);
+    while ((glyph = FindGlyphByHash(hash, format)) &&
+           !GlyphMatchesImage(glyph, gi, bits))
+        NextGlyphHash(hash);
+
+    *glyph_return = glyph;
+    return Success;
+}
+
 #ifdef CHECK_DUPLICATES
 void
 DuplicateRef(GlyphPtr glyph, char *where)
@@ -227,7 +511,7 @@ CheckDuplicates(GlyphHashPtr hash, char *where)
 #define DuplicateRef(a,b)
 #endif
 
-static void
+void
 FreeGlyphPicture(GlyphPtr glyph)
 {
     PictureScreenPtr ps;
@@ -236,13 +520,18 @@ FreeGlyphPicture(GlyphPtr glyph)
     for (i = 0; i < screenInfo.numScreens; i++) {
         ScreenPtr pScreen = screenInfo.screens[i];
 
-        if (GetGlyphPicture(glyph, pScreen))
+        if (GetGlyphPicture(glyph, pScreen)) {
             FreePicture((void *) GetGlyphPicture(glyph, pScreen), 0);
+            glyphPictureBytes[i] -= GlyphPictureBytes(glyph);
+        }
 
         ps = GetPictureScreenIfSet(pScreen);
-        if (ps)
+        if (ps && !glyph->evicted)
             (*ps->UnrealizeGlyph) (pScreen, glyph);
     }
+    xorg_list_del(&glyph->lru);
+    free(glyph->bits);
+    glyph->bits = NULL;
 }
 
 static void
@@ -289,6 +578,15 @@ AddGlyph(GlyphSetPtr glyphSet, GlyphPtr glyph, Glyph id)
     signature = *(CARD32 *) glyph->sha1;
     gr = FindGlyphRef(&globalGlyphs[glyphSet->fdepth], signature,
                       TRUE, glyph->sha1);
+    /* Two new glyphs in one request may collide without matching */
+    while (!GlyphHashSHA1 &&
+           gr->glyph && gr->glyph != DeletedGlyph && gr->glyph != glyph &&
+           !GlyphsMatch(gr->glyph, glyph)) {
+        NextGlyphHash(glyph->sha1);
+        signature = *(CARD32 *) glyph->sha1;
+        gr = FindGlyphRef(&globalGlyphs[glyphSet->fdepth], signature,
+                          TRUE, glyph->sha1);
+    }
     if (gr->glyph && gr->glyph != DeletedGlyph && gr->glyph != glyph) {
         FreeGlyphPicture(glyph);
         dixFreeObjectWithPrivates(glyph, PRIVATE_GLYPH);
@@ -303,10 +601,13 @@ AddGlyph(GlyphSetPtr glyphSet, GlyphPtr glyph, Glyph id)
     /* Insert/replace glyphset value */
     gr = FindGlyphRef(&glyphSet->hash, id, FALSE, 0);
     ++glyph->refcnt;
-    if (gr->glyph && gr->glyph != DeletedGlyph)
+    if (gr->glyph && gr->glyph != DeletedGlyph) {
+        glyphSet->bytes -= gr->glyph->size;
         FreeGlyph(gr->glyph, glyphSet->fdepth);
+    }
     else
         glyphSet->hash.tableEntries++;
+    glyphSet->bytes += glyph->size;
     gr->glyph = glyph;
     gr->signature = id;
     CheckDuplicates(&globalGlyphs[glyphSet->fdepth], "AddGlyph bottom");
@@ -323,6 +624,7 @@ DeleteGlyph(GlyphSetPtr glyphSet, Glyph id)
     if (glyph && glyph != DeletedGlyph) {
         gr->glyph = DeletedGlyph;
         glyphSet->hash.tableEntries--;
+        glyphSet->bytes -= glyph->size;
         FreeGlyph(glyph, glyphSet->fdepth);
         return TRUE;
     }
@@ -357,6 +659,10 @@ AllocateGlyph(xGlyphInfo * gi, int fdepth)
     glyph->refcnt = 0;
     glyph->size = size + sizeof(xGlyphInfo);
     glyph->info = *gi;
+    glyph->format = NULL;
+    glyph->bits = NULL;
+    xorg_list_init(&glyph->lru);
+    glyph->evicted = FALSE;
     dixInitPrivates(glyph, (char *) glyph + head_size, PRIVATE_GLYPH);
 
     for (i = 0; i < screenInfo.numScreens; i++) {
@@ -463,6 +769,7 @@ AllocateGlyphSet(int fdepth, PictFormatPtr format)
     glyphSet->refcnt = 1;
     glyphSet->fdepth = fdepth;
     glyphSet->format = format;
+    glyphSet->bytes = 0;
     return glyphSet;
 }
 
@@ -543,6 +850,213 @@ GlyphExtents(int nlist, GlyphListPtr list, GlyphPtr * glyphs, BoxPtr extents)
 
 #define NeedsComponent(f) (PICT_FORMAT_A(f) != 0 && PICT_FORMAT_RGB(f) != 0)
 
+/*
+ * Create the glyph's picture on every screen from an image laid out as
+ * in an AddGlyphs request.  On failure, no pictures are left behind.
+ */
+Bool
+RealizeGlyphPictures(GlyphPtr glyph, PictFormatPtr format, CARD8 *bits)
+{
+    int width = glyph->info.width;
+    int height = glyph->info.height;
+    int depth = format->depth;
+    CARD32 component_alpha = NeedsComponent(format->format);
+    unsigned long size;
+    int i, error;
+
+    glyph->format = format;
+
+    /* Skip work if it's invisibly small anyway */
+    if (!width || !height)
+        return TRUE;
+
+    size = GlyphPictureBytes(glyph);
+    for (i = 0; i < screenInfo.numScreens; i++) {
+        ScreenPtr pScreen = screenInfo.screens[i];
+        PixmapPtr pSrcPix, pDstPix;
+        PicturePtr pSrc, pDst = NULL;
+
+        pSrcPix = GetScratchPixmapHeader(pScreen, width, height,
+                                         depth, depth, -1, bits);
+        if (!pSrcPix)
+            goto bail;
+
+        pSrc = CreatePicture(0, &pSrcPix->drawable, format, 0, NULL,
+                             serverClient, &error);
+        if (!pSrc) {
+            FreeScratchPixmapHeader(pSrcPix);
+            goto bail;
+        }
+
+        pDstPix = (*pScreen->CreatePixmap) (pScreen, width, height, depth,
+                                            CREATE_PIXMAP_USAGE_GLYPH_PICTURE);
+        if (pDstPix) {
+            pDst = CreatePicture(0, &pDstPix->drawable, format,
+                                 CPComponentAlpha, &component_alpha,
+                                 serverClient, &error);
+            /* The picture takes a reference to the pixmap, so we
+               drop ours. */
+            (*pScreen->DestroyPixmap) (pDstPix);
+        }
+        if (pDst)
+            CompositePicture(PictOpSrc, pSrc, None, pDst,
+                             0, 0, 0, 0, 0, 0, width, height);
+
+        FreePicture((void *) pSrc, 0);
+        FreeScratchPixmapHeader(pSrcPix);
+        if (!pDst)
+            goto bail;
+
+        SetGlyphPicture(glyph, pScreen, pDst);
+        glyphPictureBytes[i] += size;
+    }
+    xorg_list_add(&glyph->lru, &glyphLRU);
+    return TRUE;
+
+ bail:
+    while (i--) {
+        ScreenPtr pScreen = screenInfo.screens[i];
+
+        FreePicture((void *) GetGlyphPicture(glyph, pScreen), 0);
+        SetGlyphPicture(glyph, pScreen, NULL);
+        glyphPictureBytes[i] -= size;
+    }
+    return FALSE;
+}
+
+static void
+UnrealizeGlyphScreens(GlyphPtr glyph, int nscreens)
+{
+    while (nscreens--) {
+        ScreenPtr pScreen = screenInfo.screens[nscreens];
+        PictureScreenPtr ps = GetPictureScreenIfSet(pScreen);
+
+        if (ps)
+            (*ps->UnrealizeGlyph) (pScreen, glyph);
+    }
+}
+
+static Bool
+RealizeGlyphScreens(GlyphPtr glyph)
+{
+    int i;
+
+    for (i = 0; i < screenInfo.numScreens; i++) {
+        ScreenPtr pScreen = screenInfo.screens[i];
+        PictureScreenPtr ps = GetPictureScreenIfSet(pScreen);
+
+        if (ps && !(*ps->RealizeGlyph) (pScreen, glyph)) {
+            UnrealizeGlyphScreens(glyph, i);
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/*
+ * Free the glyph's pictures, reading the image back into glyph->bits
+ * first.  The screens are told to unrealize the glyph too, so that
+ * whatever copies they keep, like fb's glyph atlas, go with the
+ * pictures; only the glyph's metadata and glyph->bits stay.
+ */
+static Bool
+EvictGlyphPictures(GlyphPtr glyph)
+{
+    unsigned long size = GlyphPictureBytes(glyph);
+    CARD8 *bits;
+    int i;
+
+    bits = malloc(size);
+    if (!bits)
+        return FALSE;
+    if (!GetGlyphImage(glyph, bits)) {
+        free(bits);
+        xorg_list_del(&glyph->lru);
+        return TRUE;
+    }
+    glyph->bits = bits;
+
+    for (i = 0; i < screenInfo.numScreens; i++) {
+        ScreenPtr pScreen = screenInfo.screens[i];
+
+        if (GetGlyphPicture(glyph, pScreen)) {
+            FreePicture((void *) GetGlyphPicture(glyph, pScreen), 0);
+            SetGlyphPicture(glyph, pScreen, NULL);
+            glyphPictureBytes[i] -= size;
+        }
+    }
+    xorg_list_del(&glyph->lru);
+    UnrealizeGlyphScreens(glyph, screenInfo.numScreens);
+    glyph->evicted = TRUE;
+    return TRUE;
+}
+
+static Bool
+GlyphCacheOverBudget(void)
+{
+    unsigned long limit = (unsigned long) GlyphMemoryLimit * 1024;
+    int i;
+
+    for (i = 0; i < screenInfo.numScreens; i++)
+        if (glyphPictureBytes[i] > limit)
+            return TRUE;
+    return FALSE;
+}
+
+/*
+ * Evict the least recently drawn glyphs until every screen is back
+ * within -glyphmem.  Only called between requests, never while a
+ * glyph picture may be in use.
+ */
+void
+TrimGlyphCache(void)
+{
+    if (!GlyphMemoryLimit)
+        return;
+
+    while (GlyphCacheOverBudget() && !xorg_list_is_empty(&glyphLRU)) {
+        GlyphPtr glyph = xorg_list_last_entry(&glyphLRU, GlyphRec, lru);
+
+        if (!EvictGlyphPictures(glyph))
+            break;
+    }
+}
+
+/*
+ * Move the glyphs about to be drawn to the hot end of the LRU, bringing
+ * back the pictures of any that were evicted.  Should that fail, the
+ * glyph is skipped like any other glyph without a picture.
+ */
+static void
+UseGlyphs(int nlist, GlyphListPtr list, GlyphPtr * glyphs)
+{
+    GlyphPtr glyph;
+    int n;
+
+    while (nlist--) {
+        n = list->len;
+        list++;
+        while (n--) {
+            glyph = *glyphs++;
+            if (glyph->evicted) {
+                if (!RealizeGlyphScreens(glyph))
+                    continue;
+                if (!RealizeGlyphPictures(glyph, glyph->format, glyph->bits)) {
+                    UnrealizeGlyphScreens(glyph, screenInfo.numScreens);
+                    continue;
+                }
+                glyph->evicted = FALSE;
+                free(glyph->bits);
+                glyph->bits = NULL;
+            }
+            else if (!xorg_list_is_empty(&glyph->lru)) {
+                xorg_list_del(&glyph->lru);
+                xorg_list_add(&glyph->lru, &glyphLRU);
+            }
+        }
+    }
+}
+
 void
 CompositeGlyphs(CARD8 op,
                 PicturePtr pSrc,
@@ -553,10 +1067,47 @@ CompositeGlyphs(CARD8 op,
 {
     PictureScreenPtr ps = GetPictureScreen(pDst->pDrawable->pScreen);
 
+    if (GlyphMemoryLimit)
+        UseGlyphs(nlist, lists, glyphs);
     ValidatePicture(pSrc);
     ValidatePicture(pDst);
     (*ps->Glyphs) (op, pSrc, pDst, maskFormat, xSrc, ySrc, nlist, lists,
                    glyphs);
+    TrimGlyphCache();
+}
+
+/*
+ * A glyph set is charged the full size of every glyph added to it, as
+ * kept up to date by AddGlyph and DeleteGlyph, so that X-Resource can
+ * add up what each client's glyph sets pin.  The live glyph pictures
+ * are split evenly between the glyph sets that share a glyph.
+ *
+ * @see GetDefaultBytes
+ */
+void
+GetGlyphSetBytes(void *value, XID id, ResourceSizePtr size)
+{
+    GlyphSetPtr glyphSet = value;
+    GlyphRefPtr table = glyphSet->hash.table;
+    CARD32 i;
+    int screen;
+
+    size->resourceSize = glyphSet->bytes;
+    size->pixmapRefSize = 0;
+    size->refCnt = glyphSet->refcnt;
+
+    for (i = 0; i < glyphSet->hash.hashSet->size; i++) {
+        GlyphPtr glyph = table[i].glyph;
+        unsigned long bytes;
+
+        if (!glyph || glyph == DeletedGlyph || !glyph->format)
+            continue;
+
+        bytes = GlyphPictureBytes(glyph) / glyph->refcnt;
+        for (screen = 0; screen < screenInfo.numScreens; screen++)
+            if (GetGlyphPicture(glyph, screenInfo.screens[screen]))
+                size->pixmapRefSize += bytes;
+    }
 }
 
 Bool
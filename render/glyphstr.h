@@ -31,6 +31,8 @@
 #include "regionstr.h"
 #include "miscstruct.h"
 #include "privates.h"
+#include "resource.h"
+#include "list.h"
 
 #define GlyphFormat1	0
 #define GlyphFormat4	1
@@ -42,9 +44,13 @@
 typedef struct _Glyph {
     CARD32 refcnt;
     PrivateRec *devPrivates;
-    unsigned char sha1[20];
+    unsigned char sha1[20];     /* key in the global glyph table */
     CARD32 size;                /* info + bitmap */
     xGlyphInfo info;
+    PictFormatPtr format;       /* format of the glyph pictures */
+    CARD8 *bits;                /* image while the pictures are evicted */
+    struct xorg_list lru;       /* glyphs with pictures, most recent first */
+    Bool evicted;               /* pictures and screen state dropped */
     /* per-screen pixmaps follow */
 } GlyphRec, *GlyphPtr;
 
@@ -75,6 +81,7 @@ typedef struct _GlyphSet {
     PictFormatPtr format;
     GlyphHashRec hash;
     PrivateRec *devPrivates;
+    unsigned long bytes;        /* size of the glyphs added to the set */
 } GlyphSetRec, *GlyphSetPtr;
 
 #define GlyphSetGetPrivate(pGlyphSet,k)					\
@@ -95,6 +102,10 @@ extern void
 
 extern GlyphPtr FindGlyphByHash(unsigned char sha1[20], int format);
 
+extern int
+FindGlyphByImage(xGlyphInfo * gi, CARD8 *bits, unsigned long size,
+                 int format, unsigned char hash[20], GlyphPtr *glyph_return);
+
 extern int
 HashGlyph(xGlyphInfo * gi,
           CARD8 *bits, unsigned long size, unsigned char sha1[20]);
@@ -109,6 +120,15 @@ extern GlyphPtr FindGlyph(GlyphSetPtr glyphSet, Glyph id);
 
 extern GlyphPtr AllocateGlyph(xGlyphInfo * gi, int format);
 
+extern Bool
+ RealizeGlyphPictures(GlyphPtr glyph, PictFormatPtr format, CARD8 *bits);
+
+extern void
+ FreeGlyphPicture(GlyphPtr glyph);
+
+extern void
+ TrimGlyphCache(void);
+
 extern Bool
  ResizeGlyphSet(GlyphSetPtr glyphSet, CARD32 change);
 
@@ -117,6 +137,9 @@ extern GlyphSetPtr AllocateGlyphSet(int fdepth, PictFormatPtr format);
 extern int
  FreeGlyphSet(void *value, XID gid);
 
+extern void
+ GetGlyphSetBytes(void *value, XID id, ResourceSizePtr size);
+
 #define GLYPH_HAS_GLYPH_PICTURE_ACCESSOR 1 /* used for api compat */
 extern _X_EXPORT PicturePtr
  GetGlyphPicture(GlyphPtr glyph, ScreenPtr pScreen);
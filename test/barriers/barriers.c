@@ -0,0 +1,129 @@
+/*
+ * Copyright © 2026 X.Org Foundation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+/*
+ * Moves the pointer with many pointer barriers on the screen: 1000
+ * barriers the pointer never reaches, and one it runs into.  The pointer
+ * must end up stopped by the barrier in its path.  With
+ * XSERVER_BARRIERS_BENCH set, the motion is timed over 8000 XTest events,
+ * one second of an 8 kHz mouse.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <xcb/xcb.h>
+#include <xcb/xfixes.h>
+#include <xcb/xtest.h>
+
+#define NUM_BARRIERS 1000
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+motion(xcb_connection_t *c, xcb_window_t root, int x, int y)
+{
+    xcb_test_fake_input(c, XCB_MOTION_NOTIFY, 0, XCB_CURRENT_TIME, root,
+                        x, y, 0);
+}
+
+static xcb_query_pointer_reply_t *
+query_pointer(xcb_connection_t *c, xcb_window_t root)
+{
+    xcb_query_pointer_reply_t *reply =
+        xcb_query_pointer_reply(c, xcb_query_pointer(c, root), NULL);
+
+    assert(reply);
+    return reply;
+}
+
+int
+main(int argc, char **argv)
+{
+    xcb_connection_t *c = xcb_connect(NULL, NULL);
+    xcb_xfixes_query_version_reply_t *version;
+    xcb_query_pointer_reply_t *pointer;
+    xcb_screen_t *screen;
+    int bench = getenv("XSERVER_BARRIERS_BENCH") != NULL;
+    int num_motions = bench ? 8000 : 400;
+    double start, elapsed;
+    int i;
+
+    if (!c || xcb_connection_has_error(c)) {
+        fprintf(stderr, "Failed to connect to X server\n");
+        return 1;
+    }
+    screen = xcb_setup_roots_iterator(xcb_get_setup(c)).data;
+    assert(screen->width_in_pixels >= 1024 && screen->height_in_pixels >= 768);
+
+    version = xcb_xfixes_query_version_reply(c,
+                                             xcb_xfixes_query_version(c, 5, 0),
+                                             NULL);
+    assert(version && version->major_version >= 5);
+    free(version);
+
+    /* Vertical barriers in the bottom half, the pointer stays in the top */
+    for (i = 0; i < NUM_BARRIERS; i++) {
+        xcb_xfixes_create_pointer_barrier(c, xcb_generate_id(c), screen->root,
+                                          i + 1, 400, i + 1, 760,
+                                          0, 0, NULL);
+    }
+    /* The one in the way, blocking both directions */
+    xcb_xfixes_create_pointer_barrier(c, xcb_generate_id(c), screen->root,
+                                      1010, 0, 1010, 300, 0, 0, NULL);
+
+    motion(c, screen->root, 100, 100);
+    start = now();
+    for (i = 0; i < num_motions; i++) {
+        int step = i % 200;
+
+        motion(c, screen->root, 100 + 4 * (step < 100 ? step : 200 - step),
+               100 + (i & 7));
+    }
+    free(query_pointer(c, screen->root));
+    elapsed = now() - start;
+    if (bench)
+        printf("motion: %.2f us/event, %.0f events/s with %d barriers\n",
+               elapsed * 1e6 / num_motions, num_motions / elapsed,
+               NUM_BARRIERS + 1);
+
+    motion(c, screen->root, 1005, 100);
+    motion(c, screen->root, 1020, 100);
+    pointer = query_pointer(c, screen->root);
+    assert(pointer->root_x == 1009 && pointer->root_y == 100);
+    free(pointer);
+
+    assert(!xcb_connection_has_error(c));
+    xcb_disconnect(c);
+
+    return 0;
+}
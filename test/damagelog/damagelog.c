@@ -0,0 +1,144 @@
+/*
+ * Copyright © 2026 X.Org Foundation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+/*
+ * Checks the Xvfb -damagelog log: a rectangle drawn on the root window
+ * must show up in the mmapped framebuffer file, with a logged rectangle
+ * covering it.  The first argument is the -fbdir directory.
+ */
+
+#include <arpa/inet.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <xcb/xcb.h>
+#include <X11/XWDFile.h>
+
+#define DAMAGE_LOG_MAGIC 0x4c445658
+
+struct damage_log {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t nrects;
+    uint32_t pad;
+    uint64_t frame;
+    uint64_t head;
+    struct { int16_t x1, y1, x2, y2; } rects[];
+};
+
+static void
+round_trip(xcb_connection_t *c)
+{
+    free(xcb_get_input_focus_reply(c, xcb_get_input_focus(c), NULL));
+}
+
+int
+main(int argc, char **argv)
+{
+    xcb_connection_t *c = xcb_connect(NULL, NULL);
+    xcb_screen_t *screen;
+    xcb_gcontext_t gc;
+    xcb_rectangle_t rect = { 100, 50, 10, 10 };
+    uint32_t pixel = 0x123456;
+    XWDFileHeader *xwd;
+    struct damage_log *log;
+    char path[4096];
+    struct stat st;
+    size_t offset;
+    uint64_t head, i;
+    char *file;
+    int fd, tries, found = 0;
+
+    if (!c || xcb_connection_has_error(c)) {
+        fprintf(stderr, "Failed to connect to X server\n");
+        return 1;
+    }
+    screen = xcb_setup_roots_iterator(xcb_get_setup(c)).data;
+    assert(argc > 1);
+
+    snprintf(path, sizeof(path), "%s/Xvfb_screen0", argv[1]);
+    fd = open(path, O_RDONLY);
+    assert(fd >= 0);
+    assert(fstat(fd, &st) == 0);
+    file = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    assert(file != MAP_FAILED);
+
+    /* the xwd header is always most significant byte first */
+    xwd = (XWDFileHeader *) file;
+    assert(ntohl(xwd->bits_per_pixel) == 32);
+    offset = ntohl(xwd->header_size) + ntohl(xwd->ncolors) * sz_XWDColor +
+        (size_t) ntohl(xwd->bytes_per_line) * ntohl(xwd->pixmap_height);
+    offset = (offset + 7) & ~7;
+    assert(offset + sizeof(*log) <= st.st_size);
+    log = (struct damage_log *) (file + offset);
+    assert(log->magic == DAMAGE_LOG_MAGIC);
+    assert(log->version == 1);
+    assert(offset + sizeof(*log) + log->nrects * sizeof(log->rects[0]) <=
+           st.st_size);
+
+    round_trip(c);
+    head = __atomic_load_n(&log->head, __ATOMIC_ACQUIRE);
+
+    gc = xcb_generate_id(c);
+    xcb_create_gc(c, gc, screen->root, XCB_GC_FOREGROUND, &pixel);
+    xcb_poly_fill_rectangle(c, screen->root, gc, 1, &rect);
+    round_trip(c);
+
+    /* the log is written when the server next goes idle */
+    for (tries = 0; tries < 1000; tries++) {
+        if (__atomic_load_n(&log->head, __ATOMIC_ACQUIRE) != head)
+            break;
+        usleep(1000);
+    }
+
+    for (i = head; i < log->head; i++) {
+        assert(log->head - head <= log->nrects);
+        if (log->rects[i % log->nrects].x1 <= rect.x &&
+            log->rects[i % log->nrects].y1 <= rect.y &&
+            log->rects[i % log->nrects].x2 >= rect.x + rect.width &&
+            log->rects[i % log->nrects].y2 >= rect.y + rect.height)
+            found = 1;
+    }
+    assert(found);
+    assert(log->frame > 0);
+
+    assert((*(uint32_t *) (file + ntohl(xwd->header_size) +
+                           ntohl(xwd->ncolors) * sz_XWDColor +
+                           rect.y * ntohl(xwd->bytes_per_line) +
+                           rect.x * 4) & 0xffffff) == pixel);
+
+    munmap(file, st.st_size);
+    close(fd);
+
+    assert(!xcb_connection_has_error(c));
+    xcb_disconnect(c);
+
+    return 0;
+}
@@ -0,0 +1,128 @@
+/*
+ * Copyright © 2026 X.Org Foundation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+/*
+ * Sends pointer motion over a 30 deep stack of windows, as toolkits build
+ * them.  Only the outermost window selects motion; the others select
+ * nothing or only exposure and structure events, so every event propagates
+ * through all of them, and each must arrive at the outermost window.
+ * With XSERVER_DEEPMOTION_BENCH set, the motion is timed over 8000 XTest
+ * events, one second of an 8 kHz mouse.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <xcb/xcb.h>
+#include <xcb/xtest.h>
+
+#define DEPTH 30
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+motion(xcb_connection_t *c, xcb_window_t root, int x, int y)
+{
+    xcb_test_fake_input(c, XCB_MOTION_NOTIFY, 0, XCB_CURRENT_TIME, root,
+                        x, y, 0);
+}
+
+static void
+sync_server(xcb_connection_t *c)
+{
+    free(xcb_get_input_focus_reply(c, xcb_get_input_focus(c), NULL));
+}
+
+int
+main(int argc, char **argv)
+{
+    xcb_connection_t *c = xcb_connect(NULL, NULL);
+    xcb_window_t windows[DEPTH], parent;
+    xcb_generic_event_t *ev;
+    xcb_motion_notify_event_t last = { 0 };
+    xcb_screen_t *screen;
+    int bench = getenv("XSERVER_DEEPMOTION_BENCH") != NULL;
+    int num_motions = bench ? 8000 : 400;
+    double start, elapsed;
+    int i, received = 0;
+
+    if (!c || xcb_connection_has_error(c)) {
+        fprintf(stderr, "Failed to connect to X server\n");
+        return 1;
+    }
+    screen = xcb_setup_roots_iterator(xcb_get_setup(c)).data;
+
+    parent = screen->root;
+    for (i = 0; i < DEPTH; i++) {
+        uint32_t mask = i == 0 ? XCB_EVENT_MASK_POINTER_MOTION :
+            i % 3 == 0 ? XCB_EVENT_MASK_EXPOSURE |
+            XCB_EVENT_MASK_STRUCTURE_NOTIFY : 0;
+
+        windows[i] = xcb_generate_id(c);
+        xcb_create_window(c, XCB_COPY_FROM_PARENT, windows[i], parent,
+                          0, 0, screen->width_in_pixels,
+                          screen->height_in_pixels, 0,
+                          XCB_WINDOW_CLASS_INPUT_OUTPUT,
+                          XCB_COPY_FROM_PARENT, XCB_CW_EVENT_MASK, &mask);
+        xcb_map_window(c, windows[i]);
+        parent = windows[i];
+    }
+
+    motion(c, screen->root, 100, 100);
+    sync_server(c);
+    while ((ev = xcb_poll_for_event(c)))
+        free(ev);
+
+    start = now();
+    for (i = 0; i < num_motions; i++)
+        motion(c, screen->root, 101 + (i & 1), 100 + (i & 7));
+    sync_server(c);
+    elapsed = now() - start;
+    if (bench)
+        printf("motion: %.2f us/event, %.0f events/s through %d windows\n",
+               elapsed * 1e6 / num_motions, num_motions / elapsed, DEPTH);
+
+    while ((ev = xcb_poll_for_event(c))) {
+        if ((ev->response_type & 0x7f) == XCB_MOTION_NOTIFY) {
+            last = *(xcb_motion_notify_event_t *) ev;
+            received++;
+        }
+        free(ev);
+    }
+    assert(received == num_motions);
+    assert(last.event == windows[0] && last.child == windows[1]);
+
+    assert(!xcb_connection_has_error(c));
+    xcb_disconnect(c);
+
+    return 0;
+}
@@ -0,0 +1,242 @@
+/*
+ * Copyright © 2026 X.Org Foundation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+/*
+ * Checks fb's glyph atlas against its pixman glyph cache path.  Strings
+ * of overlapping A8 glyphs are drawn through an A8 mask, once as they
+ * are, which fb builds from its atlas pages, and once with an extra
+ * glyph too large for the atlas, which sends the whole call down the
+ * pixman path.  The extra glyph is transparent, so with OVER and ADD
+ * both calls must produce the same pixels.
+ *
+ * Atlas pages are 512x512 and filled shelf by shelf.  The glyph sizes
+ * are picked so that glyphs end right at and wrap around the edges of
+ * shelves and pages, and the strings use several pages.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <xcb/xcb.h>
+#include <xcb/render.h>
+
+#define WIDTH 1024
+#define HEIGHT 768
+#define NGLYPHS 240
+#define PER_LINE 12
+#define BIG NGLYPHS             /* id of the transparent oversized glyph */
+#define BIG_SIZE 160
+
+static xcb_render_pictformat_t
+find_format(xcb_connection_t *c, int depth, int alpha_mask)
+{
+    xcb_render_query_pict_formats_reply_t *reply =
+        xcb_render_query_pict_formats_reply(c,
+                                            xcb_render_query_pict_formats(c),
+                                            NULL);
+    xcb_render_pictforminfo_iterator_t i;
+    xcb_render_pictformat_t format = 0;
+
+    assert(reply);
+    for (i = xcb_render_query_pict_formats_formats_iterator(reply);
+         i.rem; xcb_render_pictforminfo_next(&i)) {
+        if (i.data->type == XCB_RENDER_PICT_TYPE_DIRECT &&
+            i.data->depth == depth &&
+            i.data->direct.alpha_mask == alpha_mask &&
+            (depth == 8 || i.data->direct.red_mask == 0xff)) {
+            format = i.data->id;
+            break;
+        }
+    }
+    free(reply);
+    assert(format);
+    return format;
+}
+
+/*
+ * The first four widths fill a 512 pixel shelf exactly, as do the next
+ * five; the rest leave a shelf part full.  Heights run from 24 to 128.
+ */
+static void
+glyph_size(uint32_t id, int *width, int *height)
+{
+    static const int widths[] = {
+        128, 128, 128, 128, 100, 100, 100, 100, 112, 57, 93, 16
+    };
+
+    *width = widths[id % 12];
+    *height = 24 + (id * 37) % 105;
+}
+
+static void
+upload(xcb_connection_t *c, xcb_render_glyphset_t glyphset)
+{
+    static uint8_t data[BIG_SIZE * BIG_SIZE];
+    xcb_render_glyphinfo_t info;
+    uint32_t id;
+    int width, height, stride, x, y;
+
+    for (id = 0; id < NGLYPHS; id++) {
+        glyph_size(id, &width, &height);
+        stride = (width + 3) & ~3;
+        for (y = 0; y < height; y++)
+            for (x = 0; x < stride; x++)
+                data[y * stride + x] = (x * 7 + y * 13 + id * 29) & 0xff;
+        /* Advance by less than the width, so glyphs overlap */
+        info = (xcb_render_glyphinfo_t) { width, height, 0, 0,
+                                          width * 3 / 4, 0 };
+        xcb_render_add_glyphs(c, glyphset, 1, &id, &info,
+                              stride * height, data);
+    }
+
+    id = BIG;
+    memset(data, 0, sizeof(data));
+    info = (xcb_render_glyphinfo_t) { BIG_SIZE, BIG_SIZE, 0, 0, 0, 0 };
+    xcb_render_add_glyphs(c, glyphset, 1, &id, &info, sizeof(data), data);
+}
+
+/* Draw every glyph, PER_LINE to a CompositeGlyphs, and read it back. */
+static uint8_t *
+draw(xcb_connection_t *c, xcb_render_glyphset_t glyphset, uint8_t op,
+     xcb_render_pictformat_t a8, xcb_render_picture_t src,
+     xcb_render_picture_t dst, xcb_pixmap_t pixmap, int fallback)
+{
+    xcb_render_color_t background = { 0x3000, 0x6000, 0x9000, 0xc000 };
+    xcb_rectangle_t rect = { 0, 0, WIDTH, HEIGHT };
+    uint8_t cmd[8 + PER_LINE * 4 + 8 + 4];
+    xcb_get_image_reply_t *reply;
+    uint8_t *pixels;
+    uint32_t id;
+    int16_t dx, dy;
+    int line, i, len;
+
+    xcb_render_fill_rectangles(c, XCB_RENDER_PICT_OP_SRC, dst, background,
+                               1, &rect);
+
+    for (line = 0; line * PER_LINE < NGLYPHS; line++) {
+        memset(cmd, 0, sizeof(cmd));
+        cmd[0] = PER_LINE;
+        dx = (line * 41) % 64;
+        dy = (line * 47) % (HEIGHT - 128);
+        memcpy(cmd + 4, &dx, sizeof(dx));
+        memcpy(cmd + 6, &dy, sizeof(dy));
+        for (i = 0; i < PER_LINE; i++) {
+            id = line * PER_LINE + i;
+            memcpy(cmd + 8 + i * 4, &id, sizeof(id));
+        }
+        len = 8 + PER_LINE * 4;
+        if (fallback) {
+            cmd[len] = 1;
+            id = BIG;
+            memcpy(cmd + len + 8, &id, sizeof(id));
+            len += 8 + 4;
+        }
+        xcb_render_composite_glyphs_32(c, op, src, dst, a8, glyphset,
+                                       0, 0, len, cmd);
+    }
+
+    reply = xcb_get_image_reply(c, xcb_get_image(c, XCB_IMAGE_FORMAT_Z_PIXMAP,
+                                                 pixmap, 0, 0, WIDTH, HEIGHT,
+                                                 ~0),
+                                NULL);
+    assert(reply);
+    pixels = malloc(xcb_get_image_data_length(reply));
+    assert(pixels);
+    memcpy(pixels, xcb_get_image_data(reply),
+           xcb_get_image_data_length(reply));
+    free(reply);
+    return pixels;
+}
+
+static int
+check(xcb_connection_t *c, xcb_render_glyphset_t glyphset, uint8_t op,
+      const char *name, xcb_render_pictformat_t a8,
+      xcb_render_picture_t src, xcb_render_picture_t dst,
+      xcb_pixmap_t pixmap)
+{
+    uint8_t *atlas, *fallback;
+    int i, ret = 0;
+
+    fallback = draw(c, glyphset, op, a8, src, dst, pixmap, 1);
+    atlas = draw(c, glyphset, op, a8, src, dst, pixmap, 0);
+
+    for (i = 0; i < WIDTH * HEIGHT * 4; i++) {
+        if (atlas[i] != fallback[i]) {
+            fprintf(stderr, "%s: pixel %d,%d differs: %02x, expected %02x\n",
+                    name, i / 4 % WIDTH, i / 4 / WIDTH, atlas[i],
+                    fallback[i]);
+            ret = 1;
+            break;
+        }
+    }
+    if (!ret)
+        printf("%s: ok\n", name);
+
+    free(atlas);
+    free(fallback);
+    return ret;
+}
+
+int
+main(int argc, char **argv)
+{
+    xcb_connection_t *c = xcb_connect(NULL, NULL);
+    xcb_screen_t *screen;
+    xcb_render_pictformat_t a8, argb32;
+    xcb_render_glyphset_t glyphset;
+    xcb_render_picture_t src, dst;
+    xcb_render_color_t color = { 0x8000, 0x4000, 0xc000, 0xc000 };
+    xcb_pixmap_t pixmap;
+    int ret = 0;
+
+    if (!c || xcb_connection_has_error(c)) {
+        fprintf(stderr, "Failed to connect to X server\n");
+        return 1;
+    }
+    screen = xcb_setup_roots_iterator(xcb_get_setup(c)).data;
+    a8 = find_format(c, 8, 0xff);
+    argb32 = find_format(c, 32, 0xff);
+
+    glyphset = xcb_generate_id(c);
+    xcb_render_create_glyph_set(c, glyphset, a8);
+    upload(c, glyphset);
+
+    pixmap = xcb_generate_id(c);
+    xcb_create_pixmap(c, 32, pixmap, screen->root, WIDTH, HEIGHT);
+    dst = xcb_generate_id(c);
+    xcb_render_create_picture(c, dst, pixmap, argb32, 0, NULL);
+    src = xcb_generate_id(c);
+    xcb_render_create_solid_fill(c, src, color);
+
+    ret |= check(c, glyphset, XCB_RENDER_PICT_OP_OVER, "over",
+                 a8, src, dst, pixmap);
+    ret |= check(c, glyphset, XCB_RENDER_PICT_OP_ADD, "add",
+                 a8, src, dst, pixmap);
+
+    assert(!xcb_connection_has_error(c));
+    xcb_disconnect(c);
+
+    return ret;
+}
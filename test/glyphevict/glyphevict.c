@@ -0,0 +1,221 @@
+/*
+ * Copyright © 2026 X.Org Foundation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+/*
+ * Run against a server started with a small -glyphmem.  Uploads far more
+ * A8 glyphs than fit in the budget and draws all of them, so that most
+ * are drawn after their pictures were evicted and must be re-created
+ * from the saved image.  Every drawing is read back and compared with
+ * the uploaded images.  The same glyphs are then uploaded into a second
+ * glyph set, which matches them against the evicted images, and drawn
+ * from there after the first set dropped some of them.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <xcb/xcb.h>
+#include <xcb/render.h>
+
+#define SIZE 16
+#define COLUMNS 32
+#define ROWS 32
+#define NGLYPHS (COLUMNS * ROWS)
+#define BATCH 64
+
+static void
+sync_server(xcb_connection_t *c)
+{
+    free(xcb_get_input_focus_reply(c, xcb_get_input_focus(c), NULL));
+}
+
+static xcb_render_pictformat_t
+find_a8_format(xcb_connection_t *c)
+{
+    xcb_render_query_pict_formats_reply_t *reply =
+        xcb_render_query_pict_formats_reply(c,
+                                            xcb_render_query_pict_formats(c),
+                                            NULL);
+    xcb_render_pictforminfo_iterator_t i;
+    xcb_render_pictformat_t format = 0;
+
+    assert(reply);
+    for (i = xcb_render_query_pict_formats_formats_iterator(reply);
+         i.rem; xcb_render_pictforminfo_next(&i)) {
+        if (i.data->type == XCB_RENDER_PICT_TYPE_DIRECT &&
+            i.data->depth == 8 &&
+            i.data->direct.alpha_mask == 0xff) {
+            format = i.data->id;
+            break;
+        }
+    }
+    free(reply);
+    assert(format);
+    return format;
+}
+
+/* Every glyph is different: its number is in the first pixels. */
+static void
+glyph_image(uint32_t id, uint8_t *image)
+{
+    int i;
+
+    for (i = 0; i < SIZE * SIZE; i++)
+        image[i] = (i * 13 + id) & 0xff;
+    memcpy(image, &id, sizeof(id));
+}
+
+static void
+upload(xcb_connection_t *c, xcb_render_glyphset_t glyphset)
+{
+    static uint32_t ids[BATCH];
+    static xcb_render_glyphinfo_t info[BATCH];
+    static uint8_t data[BATCH * SIZE * SIZE];
+    uint32_t id, n;
+
+    for (id = 0; id < NGLYPHS; id += n) {
+        for (n = 0; n < BATCH && id + n < NGLYPHS; n++) {
+            ids[n] = id + n;
+            info[n] = (xcb_render_glyphinfo_t) { SIZE, SIZE, 0, 0, SIZE, 0 };
+            glyph_image(id + n, data + n * SIZE * SIZE);
+        }
+        xcb_render_add_glyphs(c, glyphset, n, ids, info,
+                              n * SIZE * SIZE, data);
+    }
+    sync_server(c);
+}
+
+/* Draw the glyphs of one row with a single CompositeGlyphs. */
+static void
+draw_row(xcb_connection_t *c, xcb_render_glyphset_t glyphset,
+         xcb_render_picture_t src, xcb_render_picture_t dst, int row)
+{
+    uint8_t cmd[8 + COLUMNS * 4] = { COLUMNS };
+    int16_t dy = row * SIZE;
+    uint32_t id;
+    int i;
+
+    memcpy(cmd + 6, &dy, sizeof(dy));
+    for (i = 0; i < COLUMNS; i++) {
+        id = row * COLUMNS + i;
+        memcpy(cmd + 8 + i * 4, &id, sizeof(id));
+    }
+    xcb_render_composite_glyphs_32(c, XCB_RENDER_PICT_OP_OVER, src, dst, 0,
+                                   glyphset, 0, 0, sizeof(cmd), cmd);
+}
+
+/* Draw every glyph, rows in the given order, and check the result. */
+static void
+draw_and_check(xcb_connection_t *c, xcb_render_glyphset_t glyphset,
+               xcb_render_picture_t src, xcb_render_picture_t dst,
+               xcb_pixmap_t pixmap, int reverse, const char *what)
+{
+    xcb_render_color_t clear = { 0, 0, 0, 0 };
+    xcb_rectangle_t rect = { 0, 0, COLUMNS * SIZE, ROWS * SIZE };
+    xcb_get_image_reply_t *reply;
+    uint8_t expected[SIZE * SIZE], *pixels;
+    int stride = COLUMNS * SIZE;
+    int row, col, y;
+
+    xcb_render_fill_rectangles(c, XCB_RENDER_PICT_OP_SRC, dst, clear,
+                               1, &rect);
+    for (row = 0; row < ROWS; row++)
+        draw_row(c, glyphset, src, dst, reverse ? ROWS - 1 - row : row);
+
+    reply = xcb_get_image_reply(c, xcb_get_image(c, XCB_IMAGE_FORMAT_Z_PIXMAP,
+                                                 pixmap, 0, 0,
+                                                 COLUMNS * SIZE, ROWS * SIZE,
+                                                 ~0),
+                                NULL);
+    assert(reply);
+    pixels = xcb_get_image_data(reply);
+    for (row = 0; row < ROWS; row++) {
+        for (col = 0; col < COLUMNS; col++) {
+            glyph_image(row * COLUMNS + col, expected);
+            for (y = 0; y < SIZE; y++) {
+                if (memcmp(pixels + (row * SIZE + y) * stride + col * SIZE,
+                           expected + y * SIZE, SIZE) != 0) {
+                    fprintf(stderr, "%s: glyph %d drawn wrong\n",
+                            what, row * COLUMNS + col);
+                    exit(1);
+                }
+            }
+        }
+    }
+    free(reply);
+    printf("%s: ok\n", what);
+}
+
+int
+main(int argc, char **argv)
+{
+    xcb_connection_t *c = xcb_connect(NULL, NULL);
+    xcb_screen_t *screen;
+    xcb_render_pictformat_t a8;
+    xcb_render_glyphset_t first, second;
+    xcb_render_picture_t src, dst;
+    xcb_render_color_t white = { 0xffff, 0xffff, 0xffff, 0xffff };
+    xcb_pixmap_t pixmap;
+    uint32_t dropped[ROWS];
+    int i;
+
+    if (!c || xcb_connection_has_error(c)) {
+        fprintf(stderr, "Failed to connect to X server\n");
+        return 1;
+    }
+    screen = xcb_setup_roots_iterator(xcb_get_setup(c)).data;
+    a8 = find_a8_format(c);
+
+    pixmap = xcb_generate_id(c);
+    xcb_create_pixmap(c, 8, pixmap, screen->root,
+                      COLUMNS * SIZE, ROWS * SIZE);
+    dst = xcb_generate_id(c);
+    xcb_render_create_picture(c, dst, pixmap, a8, 0, NULL);
+    src = xcb_generate_id(c);
+    xcb_render_create_solid_fill(c, src, white);
+
+    /* Only the last few batches are still realized after the upload */
+    first = xcb_generate_id(c);
+    xcb_render_create_glyph_set(c, first, a8);
+    upload(c, first);
+
+    draw_and_check(c, first, src, dst, pixmap, 0, "after upload");
+    /* The rows drawn first were evicted by the rows drawn last */
+    draw_and_check(c, first, src, dst, pixmap, 1, "after eviction");
+
+    /* Shared glyphs are found by comparing against the evicted images */
+    second = xcb_generate_id(c);
+    xcb_render_create_glyph_set(c, second, a8);
+    upload(c, second);
+    for (i = 0; i < ROWS; i++)
+        dropped[i] = i * COLUMNS + i;
+    xcb_render_free_glyphs(c, first, ROWS, dropped);
+    draw_and_check(c, second, src, dst, pixmap, 0, "shared glyphs");
+
+    assert(!xcb_connection_has_error(c));
+    xcb_disconnect(c);
+
+    return 0;
+}
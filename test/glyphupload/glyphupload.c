@@ -0,0 +1,197 @@
+/*
+ * Copyright © 2026 X.Org Foundation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Uploads distinct A8 glyphs with RenderAddGlyphs, then the same glyphs
+ * again into a second glyph set, where every glyph is shared with the
+ * first.  Run against servers started with different -glyphhash values.
+ * Finally draws one glyph from each set, which must come out with the
+ * image it was uploaded with.  With XSERVER_GLYPHUPLOAD_BENCH set, 100k
+ * glyphs are uploaded and both uploads are timed.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <xcb/xcb.h>
+#include <xcb/render.h>
+
+#define BATCH 256
+#define SIZE 16
+
+static uint32_t nglyphs = 4096;
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+sync_server(xcb_connection_t *c)
+{
+    free(xcb_get_input_focus_reply(c, xcb_get_input_focus(c), NULL));
+}
+
+static xcb_render_pictformat_t
+find_a8_format(xcb_connection_t *c)
+{
+    xcb_render_query_pict_formats_reply_t *reply =
+        xcb_render_query_pict_formats_reply(c,
+                                            xcb_render_query_pict_formats(c),
+                                            NULL);
+    xcb_render_pictforminfo_iterator_t i;
+    xcb_render_pictformat_t format = 0;
+
+    assert(reply);
+    for (i = xcb_render_query_pict_formats_formats_iterator(reply);
+         i.rem; xcb_render_pictforminfo_next(&i)) {
+        if (i.data->type == XCB_RENDER_PICT_TYPE_DIRECT &&
+            i.data->depth == 8 &&
+            i.data->direct.alpha_mask == 0xff) {
+            format = i.data->id;
+            break;
+        }
+    }
+    free(reply);
+    assert(format);
+    return format;
+}
+
+/* Every glyph is different: its number is in the first pixels. */
+static void
+glyph_image(uint32_t id, uint8_t *image)
+{
+    int i;
+
+    for (i = 0; i < SIZE * SIZE; i++)
+        image[i] = (i * 7 + (id >> 12)) & 0xff;
+    memcpy(image, &id, sizeof(id));
+}
+
+static void
+upload(xcb_connection_t *c, xcb_render_glyphset_t glyphset)
+{
+    static uint32_t ids[BATCH];
+    static xcb_render_glyphinfo_t info[BATCH];
+    static uint8_t data[BATCH * SIZE * SIZE];
+    uint32_t id, n;
+
+    for (id = 0; id < nglyphs; id += n) {
+        for (n = 0; n < BATCH && id + n < nglyphs; n++) {
+            ids[n] = id + n;
+            info[n] = (xcb_render_glyphinfo_t) { SIZE, SIZE, 0, 0, SIZE, 0 };
+            glyph_image(id + n, data + n * SIZE * SIZE);
+        }
+        xcb_render_add_glyphs(c, glyphset, n, ids, info,
+                              n * SIZE * SIZE, data);
+    }
+    sync_server(c);
+}
+
+static void
+check_glyph(xcb_connection_t *c, xcb_render_glyphset_t glyphset,
+            xcb_render_picture_t src, xcb_render_picture_t dst,
+            xcb_pixmap_t pixmap, uint32_t id)
+{
+    xcb_render_color_t clear = { 0, 0, 0, 0 };
+    xcb_rectangle_t rect = { 0, 0, SIZE, SIZE };
+    xcb_get_image_reply_t *reply;
+    uint8_t cmd[12] = { 1 }, expected[SIZE * SIZE], *pixels;
+    int y;
+
+    memcpy(cmd + 8, &id, sizeof(id));
+    xcb_render_fill_rectangles(c, XCB_RENDER_PICT_OP_SRC, dst, clear,
+                               1, &rect);
+    xcb_render_composite_glyphs_32(c, XCB_RENDER_PICT_OP_OVER, src, dst, 0,
+                                   glyphset, 0, 0, sizeof(cmd), cmd);
+
+    reply = xcb_get_image_reply(c, xcb_get_image(c, XCB_IMAGE_FORMAT_Z_PIXMAP,
+                                                 pixmap, 0, 0, SIZE, SIZE,
+                                                 ~0),
+                                NULL);
+    assert(reply);
+    pixels = xcb_get_image_data(reply);
+    glyph_image(id, expected);
+    for (y = 0; y < SIZE; y++)
+        assert(memcmp(pixels + y * SIZE, expected + y * SIZE, SIZE) == 0);
+    free(reply);
+}
+
+int
+main(int argc, char **argv)
+{
+    xcb_connection_t *c = xcb_connect(NULL, NULL);
+    xcb_screen_t *screen;
+    xcb_render_pictformat_t a8;
+    xcb_render_glyphset_t first, second;
+    xcb_render_picture_t src, dst;
+    xcb_render_color_t white = { 0xffff, 0xffff, 0xffff, 0xffff };
+    xcb_pixmap_t pixmap;
+    int bench = getenv("XSERVER_GLYPHUPLOAD_BENCH") != NULL;
+    double start;
+
+    if (!c || xcb_connection_has_error(c)) {
+        fprintf(stderr, "Failed to connect to X server\n");
+        return 1;
+    }
+    screen = xcb_setup_roots_iterator(xcb_get_setup(c)).data;
+    a8 = find_a8_format(c);
+    if (bench)
+        nglyphs = 100000;
+
+    first = xcb_generate_id(c);
+    xcb_render_create_glyph_set(c, first, a8);
+    second = xcb_generate_id(c);
+    xcb_render_create_glyph_set(c, second, a8);
+
+    start = now();
+    upload(c, first);
+    if (bench)
+        printf("new glyphs: %.0f glyphs/s\n", nglyphs / (now() - start));
+
+    start = now();
+    upload(c, second);
+    if (bench)
+        printf("shared glyphs: %.0f glyphs/s\n", nglyphs / (now() - start));
+
+    pixmap = xcb_generate_id(c);
+    xcb_create_pixmap(c, 8, pixmap, screen->root, SIZE, SIZE);
+    dst = xcb_generate_id(c);
+    xcb_render_create_picture(c, dst, pixmap, a8, 0, NULL);
+    src = xcb_generate_id(c);
+    xcb_render_create_solid_fill(c, src, white);
+
+    check_glyph(c, first, src, dst, pixmap, nglyphs / 3);
+    check_glyph(c, second, src, dst, pixmap, nglyphs - 1);
+
+    assert(!xcb_connection_has_error(c));
+    xcb_disconnect(c);
+
+    return 0;
+}
@@ -26,6 +26,10 @@
 #endif
 
 #include <stdint.h>
+#include <time.h>
+#ifdef INPUTTHREAD
+#include <pthread.h>
+#endif
 #include <X11/X.h>
 #include "misc.h"
 #include "resource.h"
@@ -1329,6 +1333,53 @@ dix_input_valuator_masks(void)
     assert(mask == NULL);
 }
 
+/**
+ * FirstPassiveGrab/NextPassiveGrab must return the grabs for a detail and
+ * the AnyKey grabs in list order, with or without the index.
+ */
+static void
+dix_passive_grab_index(void)
+{
+#define NGRABS 100
+    WindowRec win;
+    WindowOptRec optional;
+    GrabRec grabs[NGRABS];
+    PassiveGrabIterRec iter;
+    GrabPtr grab, expect;
+    int i, detail;
+
+    memset(&win, 0, sizeof(win));
+    memset(&optional, 0, sizeof(optional));
+    memset(grabs, 0, sizeof(grabs));
+    win.optional = &optional;
+
+    for (i = 0; i < NGRABS; i++) {
+        grabs[i].detail.exact = (i * 7) % 11;
+        grabs[i].next = (i + 1 < NGRABS) ? &grabs[i + 1] : NULL;
+    }
+    optional.passiveGrabs = &grabs[0];
+
+    for (detail = 0; detail < 12; detail++) {
+        expect = &grabs[0];
+        for (grab = FirstPassiveGrab(&win, detail, &iter); grab;
+             grab = NextPassiveGrab(&iter)) {
+            while (detail && expect->detail.exact != detail &&
+                   expect->detail.exact != 0)
+                expect = expect->next;
+            assert(grab == expect);
+            expect = expect->next;
+        }
+        while (detail && expect && expect->detail.exact != detail &&
+               expect->detail.exact != 0)
+            expect = expect->next;
+        assert(expect == NULL);
+    }
+    assert(optional.grabIndex);
+
+    GrabIndexFree(&win);
+    assert(!optional.grabIndex);
+}
+
 static void
 dix_valuator_mode(void)
 {
@@ -1841,6 +1892,141 @@ mieq_test(void)
     mieqFini();
 }
 
+#ifdef INPUTTHREAD
+/*
+ * Fill the queue from another thread while the main thread empties it, the
+ * way the input thread and the main thread share it.  Every millisecond
+ * four 8 kHz mice report 8 motion events each and a touchscreen floods
+ * updates for ten touches, only the rate per millisecond is simulated, not
+ * the timing.  A stalled main thread only gets to the events afterwards,
+ * half a second of them must fit into the queue.  The run with the main
+ * thread keeping up, and the timings, are only done with XSERVER_MIEQ_BENCH
+ * set.
+ */
+#define MIEQ_BENCH_MSECS        2000
+#define MIEQ_BENCH_STALL_MSECS  500
+#define MIEQ_BENCH_MICE         4
+#define MIEQ_BENCH_MOUSE_RATE   8
+#define MIEQ_BENCH_TOUCHES      10
+
+static DeviceIntRec mieq_bench_devs[MIEQ_BENCH_MICE + 1];
+static SpriteInfoRec mieq_bench_sprite_info;
+static SpriteRec mieq_bench_sprite;
+static uint32_t mieq_bench_seq[MIEQ_BENCH_MICE + 1];
+static uint32_t mieq_bench_last[MIEQ_BENCH_MICE + 1];
+static int mieq_bench_msecs;
+static int mieq_bench_sent;
+static int mieq_bench_processed;
+static int mieq_bench_done;
+
+static void
+mieq_bench_handler(int screenNum, InternalEvent *ie, DeviceIntPtr dev)
+{
+    int idx = dev - mieq_bench_devs;
+
+    /* merged motion skips numbers, but nothing may come out of order */
+    assert(ie->device_event.flags > mieq_bench_last[idx]);
+    mieq_bench_last[idx] = ie->device_event.flags;
+    mieq_bench_processed++;
+}
+
+static void
+mieq_bench_enqueue(int idx, int type, CARD32 time)
+{
+    DeviceEvent e = {
+        .header = ET_Internal,
+        .type = type,
+        .length = sizeof(e),
+        .time = time,
+        .deviceid = mieq_bench_devs[idx].id,
+        .flags = ++mieq_bench_seq[idx],
+    };
+
+    mieqEnqueue(&mieq_bench_devs[idx], (InternalEvent *) &e);
+}
+
+static void *
+mieq_bench_input_thread(void *unused)
+{
+    CARD32 time = GetTimeInMillis();
+    int ms, i, j;
+
+    for (ms = 0; ms < mieq_bench_msecs; ms++) {
+        input_lock();
+        for (j = 0; j < MIEQ_BENCH_MOUSE_RATE; j++)
+            for (i = 0; i < MIEQ_BENCH_MICE; i++)
+                mieq_bench_enqueue(i, ET_Motion, time + ms);
+        for (j = 0; j < MIEQ_BENCH_TOUCHES; j++)
+            mieq_bench_enqueue(MIEQ_BENCH_MICE, ET_TouchUpdate, time + ms);
+        input_unlock();
+        mieq_bench_sent += MIEQ_BENCH_MICE * MIEQ_BENCH_MOUSE_RATE +
+            MIEQ_BENCH_TOUCHES;
+    }
+
+    __atomic_store_n(&mieq_bench_done, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+static void
+mieq_bench_run(int msecs, Bool stalled, Bool report)
+{
+    struct timespec start, end;
+    pthread_t thread;
+    double ms;
+
+    mieq_bench_msecs = msecs;
+    mieq_bench_sent = mieq_bench_processed = mieq_bench_done = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    assert(pthread_create(&thread, NULL, mieq_bench_input_thread, NULL) == 0);
+    if (stalled)
+        pthread_join(thread, NULL);
+    while (!__atomic_load_n(&mieq_bench_done, __ATOMIC_ACQUIRE) ||
+           InputCheckPending())
+        mieqProcessInputEvents();
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (!stalled)
+        pthread_join(thread, NULL);
+
+    if (!report)
+        return;
+    ms = (end.tv_sec - start.tv_sec) * 1e3 +
+        (end.tv_nsec - start.tv_nsec) / 1e6;
+    printf("mieq: %d ms of input%s in %.1f ms, %d events sent, %d processed "
+           "(%.2f M/s)\n", msecs, stalled ? " to a stalled server" : "", ms,
+           mieq_bench_sent, mieq_bench_processed, mieq_bench_sent / ms / 1e3);
+}
+
+static void
+mieq_benchmark(void)
+{
+    Bool bench = getenv("XSERVER_MIEQ_BENCH") != NULL;
+    int i;
+
+    for (i = 0; i <= MIEQ_BENCH_MICE; i++) {
+        mieq_bench_devs[i].id = i + 2;
+        mieq_bench_devs[i].enabled = 1;
+        mieq_bench_devs[i].spriteInfo = &mieq_bench_sprite_info;
+    }
+    mieq_bench_sprite_info.sprite = &mieq_bench_sprite;
+
+    mieqInit();
+    mieqSetHandler(ET_Motion, mieq_bench_handler);
+    mieqSetHandler(ET_TouchUpdate, mieq_bench_handler);
+
+    if (bench)
+        mieq_bench_run(MIEQ_BENCH_MSECS, FALSE, TRUE);
+
+    /* the devices interleave, so no motion can be merged */
+    mieq_bench_run(MIEQ_BENCH_STALL_MSECS, TRUE, bench);
+    assert(mieq_bench_processed == mieq_bench_sent);
+
+    mieqSetHandler(ET_Motion, NULL);
+    mieqSetHandler(ET_TouchUpdate, NULL);
+    mieqFini();
+}
+#endif
+
 /* Simple check that we're replaying events in-order */
 static void
 process_input_proc(InternalEvent *ev, DeviceIntPtr device)
@@ -1919,6 +2105,7 @@ input_test(void)
     dix_check_grab_values();
     xi2_struct_sizes();
     dix_grab_matching();
+    dix_passive_grab_index();
     dix_valuator_mode();
     include_byte_padding_macros();
     include_bit_test_macros();
@@ -1927,6 +2114,9 @@ input_test(void)
     dix_get_master();
     input_option_test();
     mieq_test();
+#ifdef INPUTTHREAD
+    mieq_benchmark();
+#endif
 
     return 0;
 }
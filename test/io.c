@@ -0,0 +1,528 @@
+/**
+ * Copyright © 2026 X.Org Foundation
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice (including the next
+ *  paragraph) shall be included in all copies or substantial portions of the
+ *  Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#define XSERV_t
+#define TRANS_SERVER
+#define TRANS_REOPEN
+#include <X11/Xtrans/Xtrans.h>
+#include <X11/extensions/bigreqsproto.h>
+#include "misc.h"
+#include "os.h"
+#include "osdep.h"
+#include "dixstruct.h"
+#include "privates.h"
+#include "servermd.h"
+#include "reqstats.h"
+
+#include "tests-common.h"
+
+/*
+ * Client connection tests, with a forked child at the other end of a
+ * socket pair.
+ *
+ * For output, the child checks that data written with WriteToClient and
+ * WriteBufferToClient arrives complete and in order, also when the socket
+ * fills up.  The benchmark sends a 64MB image in IMAGE_BUFSIZE chunks, the
+ * way GetImage does, to a reader that can't keep up.
+ *
+ * For input, the child sends requests the way Xlib does, in 16KB batches,
+ * and they are read back with ReadRequestFromClient.  The benchmark sends
+ * a stream of small requests, as x11perf would, and a series of 4MB
+ * BIG-REQUESTS, and reports the number of read calls per request, as
+ * counted by the request statistics.  Requests sent right after one that
+ * carries a file descriptor must be read without another wakeup, since
+ * client sockets are edge triggered.
+ *
+ * The benchmarks only run with XSERVER_IO_BENCH set.
+ */
+
+/* TRANS_SOCKET_LOCAL_INDEX from Xtrans.c, as in os/connection.c */
+#define LOCAL_TRANS_INDEX 5
+
+static ClientRec client;
+static OsCommRec oc;
+static int released;
+
+/* the requests sent by write_requests */
+static int num_requests;
+static int big_every;           /* every big_every-th request is a big one */
+static int big_words;
+static int sync_every;          /* round trip after this many requests */
+
+static void
+buffer_done(void *buf, void *closure)
+{
+    free(buf);
+    released++;
+}
+
+typedef int (*io_child_proc) (int fd, int arg);
+
+static pid_t
+io_init(io_child_proc child, int arg)
+{
+    int sv[2];
+    pid_t pid;
+
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+
+    pid = fork();
+    assert(pid >= 0);
+    if (pid == 0) {
+        close(sv[0]);
+        _exit((*child) (sv[1], arg));
+    }
+    close(sv[1]);
+
+    if (!server_poll)
+        server_poll = ospoll_create();
+    xorg_list_init(&output_pending_clients);
+
+    memset(&client, 0, sizeof(client));
+    memset(&oc, 0, sizeof(oc));
+    client.index = 1;
+    client.osPrivate = &oc;
+    client.clientState = ClientStateRunning;
+    client.big_requests = TRUE;
+    xorg_list_init(&client.ready);
+    xorg_list_init(&client.output_pending);
+
+    oc.fd = sv[0];
+    oc.trans_conn = _XSERVTransReopenCOTSServer(LOCAL_TRANS_INDEX, sv[0],
+                                                "io-test");
+    assert(oc.trans_conn);
+    _XSERVTransSetOption(oc.trans_conn, TRANS_NONBLOCKING, 1);
+
+    released = 0;
+    return pid;
+}
+
+static void
+io_fini(pid_t pid)
+{
+    struct pollfd pfd = { .fd = oc.fd, .events = POLLOUT };
+    int status;
+
+    /* write whatever is still queued */
+    while (oc.output && FlushClient(&client, &oc, NULL, 0) >= 0 && oc.output)
+        poll(&pfd, 1, -1);
+    assert(!oc.output);
+
+    FreeOsBuffers(&oc);
+    _XSERVTransClose(oc.trans_conn);
+    assert(waitpid(pid, &status, 0) == pid);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+/* reads everything sent, checking the pattern if asked to */
+static int
+read_pattern(int fd, int check)
+{
+    unsigned char buf[4096];
+    unsigned long pos = 0;
+    ssize_t len, i;
+
+    /* let the socket fill up before reading anything */
+    if (check)
+        usleep(100000);
+    while ((len = read(fd, buf, sizeof(buf))) > 0) {
+        for (i = 0; check && i < len; i++)
+            if (buf[i] != (pos + i) % 251)
+                return 1;
+        pos += len;
+    }
+    return len == 0 ? 0 : 2;
+}
+
+static unsigned char *
+pattern(unsigned long *pos, int len)
+{
+    unsigned char *buf = malloc(len);
+    int i;
+
+    assert(buf);
+    for (i = 0; i < len; i++)
+        buf[i] = (*pos + i) % 251;
+    *pos += len;
+    return buf;
+}
+
+static void
+io_write_order(void)
+{
+    static const int sizes[] = { 32, 4, 65536, 100, 20000, 300000, 8, 16384 };
+    unsigned long pos = 0;
+    int i, handed = 0;
+    pid_t pid;
+
+    pid = io_init(read_pattern, TRUE);
+
+    for (i = 0; i < 200; i++) {
+        int len = sizes[i % ARRAY_SIZE(sizes)];
+        unsigned char *buf = pattern(&pos, len);
+
+        if (i % 3) {
+            assert(WriteBufferToClient(&client, len, buf, buffer_done,
+                                       NULL) == len);
+            handed++;
+        }
+        else {
+            assert(WriteToClient(&client, len, buf) == len);
+            free(buf);
+        }
+    }
+
+    io_fini(pid);
+    assert(released == handed);
+}
+
+static double
+elapsed_ms(clockid_t clock, struct timespec *start)
+{
+    struct timespec now;
+
+    clock_gettime(clock, &now);
+    return (now.tv_sec - start->tv_sec) * 1e3 +
+        (now.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+static void
+io_send_image(long size, Bool handover)
+{
+    struct timespec start, cpu_start;
+    double wall_ms, cpu_ms;
+    unsigned char *buf = calloc(1, IMAGE_BUFSIZE);
+    long sent;
+    pid_t pid;
+
+    assert(buf);
+    pid = io_init(read_pattern, FALSE);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_start);
+    for (sent = 0; sent < size; sent += IMAGE_BUFSIZE) {
+        if (handover) {
+            WriteBufferToClient(&client, IMAGE_BUFSIZE, buf, NULL, NULL);
+            buf = calloc(1, IMAGE_BUFSIZE);
+            assert(buf);
+        }
+        else
+            WriteToClient(&client, IMAGE_BUFSIZE, buf);
+    }
+    io_fini(pid);
+    cpu_ms = elapsed_ms(CLOCK_PROCESS_CPUTIME_ID, &cpu_start);
+    wall_ms = elapsed_ms(CLOCK_MONOTONIC, &start);
+    free(buf);
+
+    printf("%ld MB image with %-19s %8.1f MB/s, server cpu %6.1f ms\n",
+           size >> 20, handover ? "WriteBufferToClient" : "WriteToClient",
+           (size >> 20) * 1e3 / wall_ms, cpu_ms);
+}
+
+/* length in CARD32s, including the header, of request i */
+static int
+request_words(int i)
+{
+    if (big_every && i % big_every == big_every - 1)
+        return big_words;
+    return 1 + i % 8;
+}
+
+static Bool
+write_all(int fd, const void *data, size_t len)
+{
+    const char *p = data;
+    ssize_t n;
+
+    while (len > 0) {
+        if ((n = write(fd, p, len)) <= 0)
+            return FALSE;
+        p += n;
+        len -= n;
+    }
+    return TRUE;
+}
+
+/* Sends num_requests requests, each filled with its index, in batches of
+ * 16KB, except that big requests are written on their own.  Every
+ * sync_every requests, waits for the reply to a GetInputFocus, like
+ * XSync. */
+static int
+write_requests(int fd, int unused)
+{
+    static CARD32 batch[4096], payload[16384];
+    int i, j, n = 0;
+
+    for (i = 0; i < num_requests; i++) {
+        int words = request_words(i);
+
+        if (sync_every && i > 0 && i % sync_every == 0) {
+            xReq req = {.reqType = X_GetInputFocus,.length = 1 };
+            xGetInputFocusReply reply;
+
+            if (!write_all(fd, batch, n * 4) ||
+                !write_all(fd, &req, sizeof(req)) ||
+                read(fd, &reply, sizeof(reply)) != sizeof(reply))
+                return 1;
+            n = 0;
+        }
+
+        if (n + words > ARRAY_SIZE(batch) || words > 8) {
+            if (!write_all(fd, batch, n * 4))
+                return 1;
+            n = 0;
+        }
+
+        if (words > 8) {
+            xBigReq req = {
+                .reqType = X_NoOperation,
+                .data = i & 0xff,
+                .zero = 0,
+                .length = words
+            };
+
+            if (!write_all(fd, &req, sizeof(req)))
+                return 1;
+            for (j = 0; j < ARRAY_SIZE(payload); j++)
+                payload[j] = i;
+            for (words -= 2; words > 0; words -= j) {
+                j = min(words, ARRAY_SIZE(payload));
+                if (!write_all(fd, payload, j * 4))
+                    return 1;
+            }
+        }
+        else {
+            xReq *req = (xReq *) &batch[n];
+
+            req->reqType = X_NoOperation;
+            req->data = i & 0xff;
+            req->length = words;
+            for (j = 1; j < words; j++)
+                batch[n + j] = i;
+            n += words;
+        }
+    }
+
+    return write_all(fd, batch, n * 4) ? 0 : 1;
+}
+
+static void
+check_request(int i)
+{
+    xReq *req = client.requestBuffer;
+    CARD32 *data = client.requestBuffer;
+    int words = request_words(i);
+    int j;
+
+    /* big requests are seen with their header reduced to an xReq */
+    if (words > 8)
+        words--;
+
+    assert(req->reqType == X_NoOperation);
+    assert(req->data == (i & 0xff));
+    assert(client.req_len == words);
+    for (j = 1; j < words; j++)
+        assert(data[j] == i);
+}
+
+/* Reads all requests the way Dispatch does, returns the number of reads */
+static int
+read_requests(Bool check)
+{
+    struct pollfd pfd = { .fd = oc.fd, .events = POLLIN };
+    pid_t pid;
+    int i = 0, reads;
+
+    pid = io_init(write_requests, 0);
+
+    ReqStatsInit();
+    assert(dixAllocatePrivates(&client.devPrivates, PRIVATE_CLIENT));
+    reqStatsEnabled = TRUE;
+
+    while (i < num_requests) {
+        int len;
+
+        while (i < num_requests && (len = ReadRequestFromClient(&client)) > 0) {
+            xReq *req = client.requestBuffer;
+
+            if (req->reqType == X_GetInputFocus) {
+                xGetInputFocusReply reply = {.type = X_Reply };
+
+                WriteToClient(&client, sizeof(reply), &reply);
+                continue;
+            }
+            if (check)
+                check_request(i);
+            i++;
+        }
+        if (i < num_requests) {
+            assert(len == 0);
+            poll(&pfd, 1, -1);
+        }
+    }
+
+    io_fini(pid);
+    reqStatsEnabled = FALSE;
+    reads = ReqStatsForClient(&client)->reads;
+    dixFreePrivates(client.devPrivates, PRIVATE_CLIENT);
+
+    return reads;
+}
+
+static void
+io_read_order(void)
+{
+    num_requests = 10000;
+    big_every = 1000;
+    big_words = 1 << 18;
+    sync_every = 300;
+    read_requests(TRUE);
+}
+
+#define FD_BATCH 4
+#define FD_REQUESTS 100
+
+/* Sends FD_BATCH requests with a file descriptor attached, and then the
+ * rest of FD_REQUESTS without.  The kernel ends a read after the data
+ * that came with descriptors, even when more is queued. */
+static int
+write_fd_requests(int fd, int unused)
+{
+    CARD32 batch[FD_REQUESTS];
+    char control[CMSG_SPACE(sizeof(int))];
+    struct iovec iov = {
+        .iov_base = batch,
+        .iov_len = FD_BATCH * sizeof(CARD32)
+    };
+    struct msghdr msg = {
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+        .msg_control = control,
+        .msg_controllen = sizeof(control)
+    };
+    struct cmsghdr *cmsg;
+    int i, passed = open("/dev/null", O_RDONLY);
+
+    if (passed < 0)
+        return 1;
+    for (i = 0; i < FD_REQUESTS; i++) {
+        xReq *req = (xReq *) &batch[i];
+
+        req->reqType = X_NoOperation;
+        req->data = i;
+        req->length = 1;
+    }
+
+    memset(control, 0, sizeof(control));
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &passed, sizeof(int));
+
+    if (sendmsg(fd, &msg, 0) != iov.iov_len)
+        return 1;
+    return write_all(fd, &batch[FD_BATCH],
+                     (FD_REQUESTS - FD_BATCH) * sizeof(CARD32)) ? 0 : 2;
+}
+
+static void
+io_read_fds(void)
+{
+    struct pollfd pfd = { .fd = oc.fd, .events = POLLIN };
+    pid_t pid;
+    int i;
+
+    pid = io_init(write_fd_requests, 0);
+
+    /* one wakeup for everything, as with an edge triggered socket */
+    poll(&pfd, 1, -1);
+    usleep(100000);
+
+    for (i = 0; i < FD_REQUESTS; i++) {
+        xReq *req;
+
+        assert(ReadRequestFromClient(&client) > 0);
+        req = client.requestBuffer;
+        assert(req->reqType == X_NoOperation);
+        assert(req->data == i);
+    }
+
+    io_fini(pid);
+}
+
+static void
+io_read_benchmark(const char *what, int count, int every, int words,
+                  int sync)
+{
+    struct timespec start;
+    double ms;
+    int reads;
+
+    num_requests = count;
+    big_every = every;
+    big_words = words;
+    sync_every = sync;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    reads = read_requests(FALSE);
+    ms = elapsed_ms(CLOCK_MONOTONIC, &start);
+
+    printf("%d %s: %8.1f ms, %d reads, %.4f per request\n", count, what,
+           ms, reads, (double) reads / count);
+}
+
+static void
+io_benchmark(void)
+{
+    io_send_image(64L << 20, FALSE);
+    io_send_image(64L << 20, TRUE);
+
+    io_read_benchmark("small requests", 1000000, 0, 0, 500);
+    io_read_benchmark("4MB requests", 64, 1, 1 << 20, 0);
+}
+
+int
+io_test(void)
+{
+    io_write_order();
+    io_read_order();
+    io_read_fds();
+    if (getenv("XSERVER_IO_BENCH"))
+        io_benchmark();
+
+    return 0;
+}
@@ -26,6 +26,7 @@
 #endif
 
 #include <stdint.h>
+#include <string.h>
 #include "misc.h"
 #include "scrnintstr.h"
 #include "dix.h"
@@ -222,6 +223,34 @@ bswap_test(void)
     assert(result_64 == expect_64);
 }
 
+static void
+dix_smart_schedule_penalty(void)
+{
+    ClientRec client;
+    long slice = SmartScheduleSlice;
+    int i;
+
+    memset(&client, 0, sizeof(client));
+
+    /* one step per slice used, partial slices don't count */
+    SmartSchedulePenalize(&client, slice);
+    assert(client.smart_priority == -1);
+    SmartSchedulePenalize(&client, 3 * slice + slice / 2);
+    assert(client.smart_priority == -4);
+
+    /* never below the minimum, however long the request took */
+    SmartSchedulePenalize(&client, 1000 * slice);
+    assert(client.smart_priority == SMART_MIN_PRIORITY);
+    for (i = 0; i < 100; i++) {
+        SmartSchedulePenalize(&client, slice * (i + 1));
+        assert(client.smart_priority == SMART_MIN_PRIORITY);
+    }
+
+    client.smart_priority = SMART_MAX_PRIORITY;
+    SmartSchedulePenalize(&client, 0x7fffffffL);
+    assert(client.smart_priority == SMART_MIN_PRIORITY);
+}
+
 int
 misc_test(void)
 {
@@ -229,6 +258,7 @@ misc_test(void)
     dix_update_desktop_dimensions();
     dix_request_size_checks();
     bswap_test();
+    dix_smart_schedule_penalty();
 
     return 0;
 }
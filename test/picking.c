@@ -0,0 +1,248 @@
+/**
+ * Copyright © 2026 X.Org Foundation
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice (including the next
+ *  paragraph) shall be included in all copies or substantial portions of the
+ *  Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include "misc.h"
+#include "windowstr.h"
+#include "scrnintstr.h"
+#include "inputstr.h"
+#include "mi.h"
+
+#include "tests-common.h"
+
+/*
+ * Pointer picking tests.  A root window gets a few thousand unshaped
+ * children at random positions; miSpriteTrace must find the same window as
+ * a plain walk of the stacking order, both before and after the child
+ * index is built and across restacking and moves.  With
+ * XSERVER_PICKING_BENCH set, both ways of picking are also timed over
+ * 20000 windows.
+ */
+
+#define ROOT_SIZE       4096
+
+static ScreenRec screen;
+static WindowRec root;
+static WindowPtr windows;
+static SpriteRec sprite;
+
+static void
+picking_init(int num)
+{
+    WindowPtr prev = NullWindow;
+    int i;
+
+    memset(&root, 0, sizeof(root));
+    root.drawable.pScreen = &screen;
+    root.drawable.width = ROOT_SIZE;
+    root.drawable.height = ROOT_SIZE;
+    root.mapped = TRUE;
+    root.optional = calloc(1, sizeof(WindowOptRec));
+    assert(root.optional);
+
+    windows = calloc(num, sizeof(WindowRec));
+    assert(windows);
+    srand(1);
+    for (i = 0; i < num; i++) {
+        WindowPtr pWin = &windows[i];
+
+        pWin->drawable.pScreen = &screen;
+        pWin->parent = &root;
+        pWin->borderWidth = rand() % 3;
+        pWin->origin.x = rand() % ROOT_SIZE - 100;
+        pWin->origin.y = rand() % ROOT_SIZE - 100;
+        /* mostly small windows, with a few large ones */
+        pWin->drawable.width = 1 + rand() % (i % 100 ? 200 : 2000);
+        pWin->drawable.height = 1 + rand() % (i % 100 ? 200 : 2000);
+        pWin->drawable.x = pWin->origin.x;
+        pWin->drawable.y = pWin->origin.y;
+        pWin->mapped = (i % 7) != 0;
+
+        pWin->prevSib = prev;
+        if (prev)
+            prev->nextSib = pWin;
+        else
+            root.firstChild = pWin;
+        prev = pWin;
+    }
+    root.lastChild = prev;
+
+    sprite.spriteTraceSize = 10;
+    sprite.spriteTrace = calloc(sprite.spriteTraceSize, sizeof(WindowPtr));
+    assert(sprite.spriteTrace);
+    sprite.spriteTrace[0] = &root;
+}
+
+static void
+picking_fini(void)
+{
+    InvalidateChildIndex(&root);
+    free(root.optional);
+    free(windows);
+    free(sprite.spriteTrace);
+}
+
+static WindowPtr
+linear_pick(int x, int y)
+{
+    WindowPtr pWin;
+
+    for (pWin = root.firstChild; pWin; pWin = pWin->nextSib) {
+        int bw = wBorderWidth(pWin);
+
+        if (pWin->mapped &&
+            x >= pWin->drawable.x - bw &&
+            x < pWin->drawable.x + (int) pWin->drawable.width + bw &&
+            y >= pWin->drawable.y - bw &&
+            y < pWin->drawable.y + (int) pWin->drawable.height + bw)
+            return pWin;
+    }
+    return &root;
+}
+
+static WindowPtr
+sprite_pick(int x, int y)
+{
+    return miXYToWindow(&screen, &sprite, x, y);
+}
+
+static void
+check_picks(int picks)
+{
+    int i;
+
+    for (i = 0; i < picks; i++) {
+        int x = rand() % ROOT_SIZE, y = rand() % ROOT_SIZE;
+
+        assert(sprite_pick(x, y) == linear_pick(x, y));
+    }
+}
+
+static void
+picking_index(void)
+{
+    const int num = 5000;
+    WindowPtr pWin;
+    int i;
+
+    picking_init(num);
+
+    /* the first long walk builds the index */
+    assert(!wChildIndex(&root));
+    sprite_pick(-1000, -1000);
+    assert(wChildIndex(&root));
+    check_picks(20000);
+
+    /* restacking throws the index away */
+    for (i = 0; i < 100; i++) {
+        do
+            pWin = &windows[rand() % num];
+        while (pWin == root.firstChild);
+        MoveWindowInStack(pWin, root.firstChild);
+        assert(!wChildIndex(&root));
+        check_picks(100);
+        assert(wChildIndex(&root));
+    }
+
+    /* so does moving a window, which mi does through MoveWindowInStack */
+    for (i = 0; i < 100; i++) {
+        pWin = &windows[rand() % num];
+        pWin->origin.x = pWin->drawable.x = rand() % ROOT_SIZE;
+        pWin->origin.y = pWin->drawable.y = rand() % ROOT_SIZE;
+        MoveWindowInStack(pWin, pWin->nextSib);
+        assert(!wChildIndex(&root));
+        check_picks(100);
+    }
+
+    /* mapping and unmapping keeps it */
+    for (i = 0; i < 100; i++) {
+        pWin = &windows[rand() % num];
+        pWin->mapped = !pWin->mapped;
+        check_picks(100);
+        assert(wChildIndex(&root));
+    }
+
+    picking_fini();
+}
+
+static double
+elapsed_ms(struct timespec *start)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1e3 +
+        (now.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+static void
+picking_benchmark(void)
+{
+    const int num = 20000, picks = 200000;
+    struct timespec start;
+    double linear_ms, index_ms;
+    int i, x, y;
+
+    picking_init(num);
+
+    srand(2);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < picks; i++) {
+        x = rand() % ROOT_SIZE;
+        y = rand() % ROOT_SIZE;
+        linear_pick(x, y);
+    }
+    linear_ms = elapsed_ms(&start);
+
+    sprite_pick(-1000, -1000);
+    srand(2);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < picks; i++) {
+        x = rand() % ROOT_SIZE;
+        y = rand() % ROOT_SIZE;
+        sprite_pick(x, y);
+    }
+    index_ms = elapsed_ms(&start);
+
+    printf("%d windows: linear pick %.2f us, indexed pick %.2f us\n", num,
+           linear_ms * 1e3 / picks, index_ms * 1e3 / picks);
+
+    picking_fini();
+}
+
+int
+picking_test(void)
+{
+    picking_index();
+    if (getenv("XSERVER_PICKING_BENCH"))
+        picking_benchmark();
+
+    return 0;
+}
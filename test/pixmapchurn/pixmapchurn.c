@@ -0,0 +1,164 @@
+/*
+ * Copyright © 2026 X.Org Foundation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Checks that a large pixmap freed by one client does not show through
+ * in the next pixmap of the same size made by another: fb reuses the
+ * mapping, and must clear it first.
+ *
+ * With XSERVER_PIXMAPCHURN_BENCH set, it first times creating a pixmap,
+ * filling it, reading a pixel back and freeing it again, for a small
+ * pixmap and a 4K one.  The fill touches every page, so the large case
+ * shows what each new pixmap costs in page faults.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <xcb/xcb.h>
+
+#define ITERATIONS 200
+#define STRIP 64
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+churn(xcb_connection_t *c, xcb_screen_t *screen, int width, int height)
+{
+    xcb_gcontext_t gc = xcb_generate_id(c);
+    xcb_rectangle_t rect = { 0, 0, width, height };
+    double start;
+    int i;
+
+    xcb_create_gc(c, gc, screen->root, 0, NULL);
+
+    start = now();
+    for (i = 0; i < ITERATIONS; i++) {
+        xcb_pixmap_t pixmap = xcb_generate_id(c);
+        xcb_get_image_reply_t *reply;
+
+        xcb_create_pixmap(c, screen->root_depth, pixmap, screen->root,
+                          width, height);
+        xcb_poly_fill_rectangle(c, pixmap, gc, 1, &rect);
+        reply = xcb_get_image_reply(c,
+                                    xcb_get_image(c, XCB_IMAGE_FORMAT_Z_PIXMAP,
+                                                  pixmap, width - 1,
+                                                  height - 1, 1, 1, ~0),
+                                    NULL);
+        assert(reply);
+        free(reply);
+        xcb_free_pixmap(c, pixmap);
+    }
+    printf("%dx%d: %.3f ms/pixmap\n", width, height,
+           (now() - start) * 1e3 / ITERATIONS);
+
+    xcb_free_gc(c, gc);
+}
+
+static int
+check_cleared(xcb_connection_t *c, xcb_screen_t *screen,
+              int width, int height)
+{
+    xcb_connection_t *other = xcb_connect(NULL, NULL);
+    xcb_pixmap_t pixmap = xcb_generate_id(c);
+    xcb_gcontext_t gc = xcb_generate_id(c);
+    uint32_t foreground = 0x5a5a5a;
+    xcb_rectangle_t rect = { 0, 0, width, height };
+    xcb_get_image_reply_t *reply;
+    const uint8_t *data;
+    int y, rows, i, len, ret = 0;
+
+    assert(other && !xcb_connection_has_error(other));
+
+    xcb_create_pixmap(c, screen->root_depth, pixmap, screen->root,
+                      width, height);
+    xcb_create_gc(c, gc, pixmap, XCB_GC_FOREGROUND, &foreground);
+    xcb_poly_fill_rectangle(c, pixmap, gc, 1, &rect);
+    xcb_free_gc(c, gc);
+    xcb_free_pixmap(c, pixmap);
+    free(xcb_get_input_focus_reply(c, xcb_get_input_focus(c), NULL));
+
+    pixmap = xcb_generate_id(other);
+    xcb_create_pixmap(other, screen->root_depth, pixmap, screen->root,
+                      width, height);
+    for (y = 0; y < height && !ret; y += rows) {
+        rows = height - y < STRIP ? height - y : STRIP;
+        reply = xcb_get_image_reply(other,
+                                    xcb_get_image(other,
+                                                  XCB_IMAGE_FORMAT_Z_PIXMAP,
+                                                  pixmap, 0, y, width,
+                                                  rows, ~0),
+                                    NULL);
+        assert(reply);
+        data = xcb_get_image_data(reply);
+        len = xcb_get_image_data_length(reply);
+        for (i = 0; i < len; i++) {
+            if (data[i]) {
+                fprintf(stderr, "%dx%d: old contents at row %d\n",
+                        width, height, y + i / (len / rows));
+                ret = 1;
+                break;
+            }
+        }
+        free(reply);
+    }
+    xcb_free_pixmap(other, pixmap);
+    xcb_disconnect(other);
+
+    if (!ret)
+        printf("%dx%d: reused pixmap is clear\n", width, height);
+    return ret;
+}
+
+int
+main(int argc, char **argv)
+{
+    xcb_connection_t *c = xcb_connect(NULL, NULL);
+    xcb_screen_t *screen;
+    int ret;
+
+    if (!c || xcb_connection_has_error(c)) {
+        fprintf(stderr, "Failed to connect to X server\n");
+        return 1;
+    }
+    screen = xcb_setup_roots_iterator(xcb_get_setup(c)).data;
+
+    if (getenv("XSERVER_PIXMAPCHURN_BENCH")) {
+        churn(c, screen, 64, 64);
+        churn(c, screen, 3840, 2160);
+    }
+    ret = check_cleared(c, screen, 3840, 2160);
+
+    assert(!xcb_connection_has_error(c));
+    xcb_disconnect(c);
+
+    return ret;
+}
@@ -0,0 +1,268 @@
+/**
+ * Copyright © 2026 X.Org Foundation
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice (including the next
+ *  paragraph) shall be included in all copies or substantial portions of the
+ *  Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <X11/Xatom.h>
+#include "misc.h"
+#include "dixstruct.h"
+#include "windowstr.h"
+#include "scrnintstr.h"
+#include "propertyst.h"
+#include "xacestr.h"
+
+#include "tests-common.h"
+
+/*
+ * Window property tests.  The benchmark, run with XSERVER_PROPERTY_BENCH
+ * set, polls the properties of a window with 1000 of them, the way panels
+ * and compositors poll the root window.
+ */
+
+#define FIRST_ATOM      100
+
+static ScreenRec screen;
+static WindowRec window;
+static ClientRec client;
+
+static void
+property_init(void)
+{
+    memset(&window, 0, sizeof(window));
+    window.drawable.pScreen = &screen;
+    window.drawable.id = 0x1;
+    window.optional = calloc(1, sizeof(WindowOptRec));
+    assert(window.optional);
+}
+
+static void
+property_fini(void)
+{
+    DeleteAllWindowProperties(&window);
+    assert(window.optional->propIndex == NULL);
+    free(window.optional);
+}
+
+static void
+change_property(Atom name, Atom type, int mode, CARD32 value)
+{
+    int rc = dixChangeWindowProperty(&client, &window, name, type, 32, mode,
+                                     1, &value, FALSE);
+
+    assert(rc == Success);
+}
+
+static void
+check_property(Atom name, Bool exists, CARD32 value)
+{
+    PropertyPtr pProp;
+    int rc = dixLookupProperty(&pProp, &window, name, &client, DixReadAccess);
+
+    if (!exists) {
+        assert(rc == BadMatch);
+        return;
+    }
+    assert(rc == Success);
+    assert(pProp->propertyName == name);
+    assert(pProp->size >= 1);
+    assert(((CARD32 *) pProp->data)[pProp->size - 1] == value);
+}
+
+static int
+count_properties(void)
+{
+    PropertyPtr pProp;
+    int n = 0;
+
+    for (pProp = window.optional->userProps; pProp; pProp = pProp->next)
+        n++;
+    return n;
+}
+
+static void
+property_lookup(void)
+{
+    const int num = 1000;
+    PropertyPtr pProp;
+    int i;
+
+    property_init();
+
+    for (i = 0; i < num; i++) {
+        change_property(FIRST_ATOM + i, XA_CARDINAL, PropModeReplace, i);
+        check_property(FIRST_ATOM + i, TRUE, i);
+        check_property(FIRST_ATOM + i + 1, FALSE, 0);
+    }
+    assert(window.optional->propIndex != NULL);
+
+    /* changing a property leaves the protocol order alone, newest first */
+    change_property(FIRST_ATOM, XA_CARDINAL, PropModeReplace, 42);
+    change_property(FIRST_ATOM + 1, XA_CARDINAL, PropModeAppend, 43);
+    i = num - 1;
+    for (pProp = window.optional->userProps; pProp; pProp = pProp->next)
+        assert(pProp->propertyName == FIRST_ATOM + i--);
+    assert(i == -1);
+    check_property(FIRST_ATOM, TRUE, 42);
+    check_property(FIRST_ATOM + 1, TRUE, 43);
+
+    for (i = 0; i < num; i += 2)
+        assert(DeleteProperty(&client, &window, FIRST_ATOM + i) == Success);
+    assert(count_properties() == num / 2);
+    for (i = 2; i < num; i++)
+        check_property(FIRST_ATOM + i, i & 1, i);
+
+    /* down to a handful the window goes back to the plain list */
+    for (i = 1; i < num - 10; i += 2)
+        assert(DeleteProperty(&client, &window, FIRST_ATOM + i) == Success);
+    assert(count_properties() == 5);
+    assert(window.optional->propIndex == NULL);
+    for (i = num - 10; i < num; i++)
+        check_property(FIRST_ATOM + i, i & 1, i);
+
+    property_fini();
+}
+
+/*
+ * Like SELinux polyinstantiation: a window can have several properties of
+ * the same name, the hook picks the first one whose type matches.
+ */
+static Atom instance;
+
+static void
+instance_hook(CallbackListPtr *pcbl, void *unused, void *calldata)
+{
+    XacePropertyAccessRec *rec = calldata;
+    PropertyPtr pProp = *rec->ppProp;
+    Atom name = pProp->propertyName;
+
+    if (rec->access_mode & DixCreateAccess)
+        return;
+
+    while (pProp && (pProp->propertyName != name || pProp->type != instance))
+        pProp = pProp->next;
+
+    if (pProp)
+        *rec->ppProp = pProp;
+    else
+        rec->status = BadMatch;
+}
+
+static void
+property_instances(void)
+{
+    int i;
+
+    property_init();
+    assert(XaceRegisterCallback(XACE_PROPERTY_ACCESS, instance_hook, NULL));
+
+    for (instance = 1; instance <= 3; instance++)
+        for (i = 0; i < 100; i++)
+            change_property(FIRST_ATOM + i, instance, PropModeReplace,
+                            instance * 1000 + i);
+    assert(count_properties() == 300);
+    assert(window.optional->propIndex != NULL);
+
+    for (instance = 1; instance <= 3; instance++)
+        for (i = 0; i < 100; i++)
+            check_property(FIRST_ATOM + i, TRUE, instance * 1000 + i);
+
+    /* removing the indexed instance uncovers the next one */
+    instance = 3;
+    for (i = 0; i < 100; i++)
+        assert(DeleteProperty(&client, &window, FIRST_ATOM + i) == Success);
+    for (instance = 1; instance <= 3; instance++)
+        for (i = 0; i < 100; i++)
+            check_property(FIRST_ATOM + i, instance != 3, instance * 1000 + i);
+
+    instance = 1;
+    for (i = 0; i < 100; i++)
+        assert(DeleteProperty(&client, &window, FIRST_ATOM + i) == Success);
+    instance = 2;
+    for (i = 0; i < 100; i++)
+        check_property(FIRST_ATOM + i, TRUE, instance * 1000 + i);
+
+    XaceDeleteCallback(XACE_PROPERTY_ACCESS, instance_hook, NULL);
+    property_fini();
+}
+
+static double
+elapsed_ms(struct timespec *start)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1e3 +
+        (now.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+static void
+property_benchmark(void)
+{
+    const int num = 1000, polls = 1000000;
+    struct timespec start;
+    double get_ms, change_ms;
+    PropertyPtr pProp;
+    int i, j;
+
+    property_init();
+
+    for (i = 0; i < num; i++)
+        change_property(FIRST_ATOM + i, XA_CARDINAL, PropModeReplace, i);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0, j = 0; i < polls; i++) {
+        j = (j + 7919) % num;
+        dixLookupProperty(&pProp, &window, FIRST_ATOM + j, &client,
+                          DixReadAccess);
+    }
+    get_ms = elapsed_ms(&start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0, j = 0; i < polls; i++) {
+        j = (j + 7919) % num;
+        change_property(FIRST_ATOM + j, XA_CARDINAL, PropModeReplace, i);
+    }
+    change_ms = elapsed_ms(&start);
+
+    printf("%d properties: lookup %.2f ns, replace %.2f ns\n", num,
+           get_ms * 1e6 / polls, change_ms * 1e6 / polls);
+
+    property_fini();
+}
+
+int
+property_test(void)
+{
+    property_lookup();
+    property_instances();
+    if (getenv("XSERVER_PROPERTY_BENCH"))
+        property_benchmark();
+
+    return 0;
+}
@@ -0,0 +1,375 @@
+/*
+ * Copyright © 2026 X.Org Foundation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Times screen-sized software rendering: a Render composite, a core solid
+ * fill and a copy between pixmaps.  Run against servers started with
+ * different -renderthreads values to see how the fb bands scale.  Each
+ * operation is followed by GetImage of one pixel, which must see the
+ * finished result.  The timings are only taken with
+ * XSERVER_RENDERTHREADS_BENCH set.
+ *
+ * Before that, the same operations are checked against single-threaded
+ * rendering: each is done once over the whole destination, which the
+ * server cuts into bands, and once in tiles too small to be banded.  The
+ * whole images must match.  Sizes that don't divide evenly into bands and
+ * clip rectangles that cross band edges are included, since band seams
+ * and per-band clipping are where threading bugs show.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <xcb/xcb.h>
+#include <xcb/render.h>
+
+#define ITERATIONS 50
+#define TILE 128                /* below the fb banding threshold */
+#define STRIP 32                /* rows per PutImage/GetImage */
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint32_t
+get_pixel(xcb_connection_t *c, xcb_drawable_t drawable, int x, int y)
+{
+    xcb_get_image_reply_t *reply =
+        xcb_get_image_reply(c, xcb_get_image(c, XCB_IMAGE_FORMAT_Z_PIXMAP,
+                                             drawable, x, y, 1, 1, ~0),
+                            NULL);
+    uint32_t pixel;
+
+    assert(reply);
+    pixel = *(uint32_t *) xcb_get_image_data(reply);
+    free(reply);
+    return pixel;
+}
+
+static xcb_render_pictformat_t
+find_format(xcb_connection_t *c, int depth, int alpha)
+{
+    xcb_render_query_pict_formats_reply_t *reply =
+        xcb_render_query_pict_formats_reply(c,
+                                            xcb_render_query_pict_formats(c),
+                                            NULL);
+    xcb_render_pictforminfo_iterator_t i;
+    xcb_render_pictformat_t format = 0;
+
+    assert(reply);
+    for (i = xcb_render_query_pict_formats_formats_iterator(reply);
+         i.rem; xcb_render_pictforminfo_next(&i)) {
+        if (i.data->type == XCB_RENDER_PICT_TYPE_DIRECT &&
+            i.data->depth == depth &&
+            (depth == 8 || i.data->direct.red_mask == 0xff) &&
+            i.data->direct.alpha_mask == (alpha ? 0xff : 0)) {
+            format = i.data->id;
+            break;
+        }
+    }
+    free(reply);
+    assert(format);
+    return format;
+}
+
+static void
+report(const char *name, double start, int width, int height)
+{
+    double ms = (now() - start) * 1e3 / ITERATIONS;
+
+    printf("%s: %.2f ms/op, %.0f Mpixel/s\n", name, ms,
+           (double) width * height / ms / 1e3);
+}
+
+static void
+put_random(xcb_connection_t *c, xcb_drawable_t drawable, xcb_gcontext_t gc,
+           int depth, int width, int height)
+{
+    int bpp = depth == 8 ? 1 : 4;
+    int stride = (width * bpp + 3) & ~3;
+    uint8_t *data = malloc(stride * STRIP);
+    int x, y;
+
+    assert(data);
+    for (y = 0; y < height; y += STRIP) {
+        int rows = height - y < STRIP ? height - y : STRIP;
+
+        for (x = 0; x < stride * rows; x++)
+            data[x] = rand() >> 7;
+        xcb_put_image(c, XCB_IMAGE_FORMAT_Z_PIXMAP, drawable, gc, width, rows,
+                      0, y, 0, depth, stride * rows, data);
+    }
+    free(data);
+}
+
+static void
+compare_images(xcb_connection_t *c, xcb_drawable_t a, xcb_drawable_t b,
+               int width, int height, const char *what)
+{
+    int y;
+
+    for (y = 0; y < height; y += STRIP) {
+        int rows = height - y < STRIP ? height - y : STRIP;
+        xcb_get_image_cookie_t ca =
+            xcb_get_image(c, XCB_IMAGE_FORMAT_Z_PIXMAP, a, 0, y, width, rows, ~0);
+        xcb_get_image_cookie_t cb =
+            xcb_get_image(c, XCB_IMAGE_FORMAT_Z_PIXMAP, b, 0, y, width, rows, ~0);
+        xcb_get_image_reply_t *ra = xcb_get_image_reply(c, ca, NULL);
+        xcb_get_image_reply_t *rb = xcb_get_image_reply(c, cb, NULL);
+
+        assert(ra && rb);
+        if (xcb_get_image_data_length(ra) != xcb_get_image_data_length(rb) ||
+            memcmp(xcb_get_image_data(ra), xcb_get_image_data(rb),
+                   xcb_get_image_data_length(ra)) != 0) {
+            fprintf(stderr, "%s %dx%d: banded result differs in rows %d-%d\n",
+                    what, width, height, y, y + rows - 1);
+            abort();
+        }
+        free(ra);
+        free(rb);
+    }
+}
+
+/* Clip rectangles with edges at odd rows, so they cross band edges */
+static const xcb_rectangle_t clips[] = {
+    { 3, 5, 301, 157 },
+    { 11, 170, 517, 611 },
+    { 200, 33, 97, 1999 },
+};
+
+static void
+check_size(xcb_connection_t *c, xcb_screen_t *screen, int width, int height)
+{
+    xcb_pixmap_t src, mask, dst[2];
+    xcb_render_picture_t src_pict, mask_pict, dst_pict[2];
+    xcb_gcontext_t gc, gc8, clip_gc[2];
+    uint32_t pixel = 0x80c04020;
+    int i, x, y;
+    unsigned seed = width * 7919 + height;
+
+    src = xcb_generate_id(c);
+    xcb_create_pixmap(c, 32, src, screen->root, width, height);
+    mask = xcb_generate_id(c);
+    xcb_create_pixmap(c, 8, mask, screen->root, width, height);
+    gc = xcb_generate_id(c);
+    xcb_create_gc(c, gc, src, 0, NULL);
+    gc8 = xcb_generate_id(c);
+    xcb_create_gc(c, gc8, mask, 0, NULL);
+
+    srand(seed);
+    put_random(c, src, gc, 32, width, height);
+    put_random(c, mask, gc8, 8, width, height);
+
+    src_pict = xcb_generate_id(c);
+    xcb_render_create_picture(c, src_pict, src, find_format(c, 32, 1), 0, NULL);
+    mask_pict = xcb_generate_id(c);
+    xcb_render_create_picture(c, mask_pict, mask, find_format(c, 8, 1),
+                              0, NULL);
+
+    /* dst[0] is drawn in one go, dst[1] in tiles */
+    for (i = 0; i < 2; i++) {
+        dst[i] = xcb_generate_id(c);
+        xcb_create_pixmap(c, 32, dst[i], screen->root, width, height);
+        srand(seed + 1);
+        put_random(c, dst[i], gc, 32, width, height);
+        dst_pict[i] = xcb_generate_id(c);
+        xcb_render_create_picture(c, dst_pict[i], dst[i],
+                                  find_format(c, 32, 1), 0, NULL);
+        clip_gc[i] = xcb_generate_id(c);
+        xcb_create_gc(c, clip_gc[i], dst[i], XCB_GC_FOREGROUND, &pixel);
+        xcb_set_clip_rectangles(c, XCB_CLIP_ORDERING_UNSORTED, clip_gc[i],
+                                0, 0, sizeof(clips) / sizeof(clips[0]),
+                                clips);
+    }
+
+    /* Composite: OVER with a mask, ADD, both offset in the source */
+    for (i = 0; i < 2; i++) {
+        int tw = i ? TILE : width, th = i ? TILE : height;
+
+        for (y = 0; y < height; y += th)
+            for (x = 0; x < width; x += tw) {
+                int w = width - x < tw ? width - x : tw;
+                int h = height - y < th ? height - y : th;
+
+                xcb_render_composite(c, XCB_RENDER_PICT_OP_OVER, src_pict,
+                                     mask_pict, dst_pict[i], x, y, x, y,
+                                     x, y, w, h);
+                xcb_render_composite(c, XCB_RENDER_PICT_OP_ADD, src_pict, 0,
+                                     dst_pict[i], x + 3, y + 1, 0, 0,
+                                     x, y, w, h);
+            }
+    }
+    compare_images(c, dst[0], dst[1], width, height, "composite");
+
+    /* The same through clip rectangles */
+    for (i = 0; i < 2; i++) {
+        int tw = i ? TILE : width, th = i ? TILE : height;
+
+        xcb_render_set_picture_clip_rectangles(c, dst_pict[i], 0, 0,
+                                               sizeof(clips) /
+                                               sizeof(clips[0]), clips);
+        for (y = 0; y < height; y += th)
+            for (x = 0; x < width; x += tw) {
+                int w = width - x < tw ? width - x : tw;
+                int h = height - y < th ? height - y : th;
+
+                xcb_render_composite(c, XCB_RENDER_PICT_OP_OVER, src_pict,
+                                     mask_pict, dst_pict[i], x + 1, y + 2,
+                                     x, y, x, y, w, h);
+            }
+    }
+    compare_images(c, dst[0], dst[1], width, height, "clipped composite");
+
+    /* Solid fill through the clip */
+    for (i = 0; i < 2; i++) {
+        int tw = i ? TILE : width, th = i ? TILE : height;
+
+        for (y = 0; y < height; y += th)
+            for (x = 0; x < width; x += tw) {
+                xcb_rectangle_t rect = {
+                    x, y, width - x < tw ? width - x : tw,
+                    height - y < th ? height - y : th
+                };
+
+                xcb_poly_fill_rectangle(c, dst[i], clip_gc[i], 1, &rect);
+            }
+    }
+    compare_images(c, dst[0], dst[1], width, height, "fill");
+
+    /* Copies from an offset in another pixmap */
+    for (i = 0; i < 2; i++) {
+        int tw = i ? TILE : width, th = i ? TILE : height;
+
+        for (y = 0; y < height - 7; y += th)
+            for (x = 0; x < width - 5; x += tw) {
+                int w = width - 5 - x < tw ? width - 5 - x : tw;
+                int h = height - 7 - y < th ? height - 7 - y : th;
+
+                xcb_copy_area(c, src, dst[i], gc, x + 5, y + 7, x, y, w, h);
+            }
+    }
+    compare_images(c, dst[0], dst[1], width, height, "copy");
+
+    for (i = 0; i < 2; i++) {
+        xcb_free_gc(c, clip_gc[i]);
+        xcb_render_free_picture(c, dst_pict[i]);
+        xcb_free_pixmap(c, dst[i]);
+    }
+    xcb_render_free_picture(c, mask_pict);
+    xcb_render_free_picture(c, src_pict);
+    xcb_free_gc(c, gc8);
+    xcb_free_gc(c, gc);
+    xcb_free_pixmap(c, mask);
+    xcb_free_pixmap(c, src);
+}
+
+static void
+benchmark(xcb_connection_t *c, xcb_screen_t *screen)
+{
+    xcb_pixmap_t src, dst, copy;
+    xcb_render_picture_t src_pict, dst_pict;
+    xcb_gcontext_t gc;
+    xcb_rectangle_t rect;
+    xcb_render_color_t half_red = { 0x8000, 0, 0, 0x8000 };
+    int width = screen->width_in_pixels, height = screen->height_in_pixels;
+    int i;
+    double start;
+
+    rect = (xcb_rectangle_t) { 0, 0, width, height };
+
+    src = xcb_generate_id(c);
+    xcb_create_pixmap(c, 32, src, screen->root, width, height);
+    dst = xcb_generate_id(c);
+    xcb_create_pixmap(c, 24, dst, screen->root, width, height);
+    copy = xcb_generate_id(c);
+    xcb_create_pixmap(c, 24, copy, screen->root, width, height);
+
+    src_pict = xcb_generate_id(c);
+    xcb_render_create_picture(c, src_pict, src, find_format(c, 32, 1), 0, NULL);
+    dst_pict = xcb_generate_id(c);
+    xcb_render_create_picture(c, dst_pict, dst, find_format(c, 24, 0), 0, NULL);
+    xcb_render_fill_rectangles(c, XCB_RENDER_PICT_OP_SRC, src_pict, half_red,
+                               1, &rect);
+
+    gc = xcb_generate_id(c);
+    xcb_create_gc(c, gc, dst, 0, NULL);
+
+    start = now();
+    for (i = 0; i < ITERATIONS; i++) {
+        uint32_t pixel = i & 1 ? 0x0000ff : 0x00ff00;
+
+        xcb_change_gc(c, gc, XCB_GC_FOREGROUND, &pixel);
+        xcb_poly_fill_rectangle(c, dst, gc, 1, &rect);
+        assert((get_pixel(c, dst, width - 1, height - 1) & 0xffffff) == pixel);
+    }
+    report("fill", start, width, height);
+
+    start = now();
+    for (i = 0; i < ITERATIONS; i++) {
+        xcb_render_composite(c, XCB_RENDER_PICT_OP_OVER, src_pict, 0, dst_pict,
+                             0, 0, 0, 0, 0, 0, width, height);
+        get_pixel(c, dst, width - 1, height - 1);
+    }
+    report("composite", start, width, height);
+
+    start = now();
+    for (i = 0; i < ITERATIONS; i++) {
+        xcb_copy_area(c, dst, copy, gc, 0, 0, 0, 0, width, height);
+        assert(get_pixel(c, copy, width - 1, height - 1) ==
+               get_pixel(c, dst, width - 1, height - 1));
+    }
+    report("copy", start, width, height);
+}
+
+int
+main(int argc, char **argv)
+{
+    xcb_connection_t *c = xcb_connect(NULL, NULL);
+    xcb_screen_t *screen;
+
+    if (!c || xcb_connection_has_error(c)) {
+        fprintf(stderr, "Failed to connect to X server\n");
+        return 1;
+    }
+    screen = xcb_setup_roots_iterator(xcb_get_setup(c)).data;
+
+    /* Band counts that don't divide these evenly */
+    check_size(c, screen, 1001, 997);
+    check_size(c, screen, 777, 1283);
+    check_size(c, screen, screen->width_in_pixels, screen->height_in_pixels);
+
+    if (getenv("XSERVER_RENDERTHREADS_BENCH"))
+        benchmark(c, screen);
+
+    assert(!xcb_connection_has_error(c));
+    xcb_disconnect(c);
+
+    return 0;
+}
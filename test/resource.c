@@ -0,0 +1,295 @@
+/**
+ * Copyright © 2026 X.Org Foundation
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice (including the next
+ *  paragraph) shall be included in all copies or substantial portions of the
+ *  Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include "misc.h"
+#include "dixstruct.h"
+#include "resource.h"
+
+#include "tests-common.h"
+
+/*
+ * Resource table tests.  The benchmark, run with XSERVER_RESOURCE_BENCH
+ * set, times lookup, insert and bulk free for 10^3 to 10^6 resources.
+ * A client can't have many more, with the default client limit its XIDs
+ * leave room for 2^21 resources.
+ */
+
+static ClientRec server_client;
+static ClientRec test_client;
+static RESTYPE TestType, OtherType;
+static int deleted;
+
+static int
+delete_test_resource(void *value, XID id)
+{
+    deleted++;
+    return Success;
+}
+
+/* frees the resource stored as value, from within a delete function */
+static int
+delete_chained_resource(void *value, XID id)
+{
+    deleted++;
+    FreeResource((XID) (uintptr_t) value, RT_NONE);
+    return Success;
+}
+
+static void
+resource_init(void)
+{
+    server_client.index = 0;
+    server_client.clientAsMask = 0;
+    serverClient = &server_client;
+    clients[0] = serverClient;
+    assert(InitClientResources(serverClient));
+
+    test_client.index = 1;
+    test_client.clientAsMask = (XID) 1 << CLIENTOFFSET;
+    clients[1] = &test_client;
+    currentMaxClients = 2;
+    assert(InitClientResources(&test_client));
+
+    TestType = CreateNewResourceType(delete_test_resource, "TestResource");
+    OtherType = CreateNewResourceType(delete_chained_resource, "OtherResource");
+    assert(TestType && OtherType);
+    deleted = 0;
+}
+
+static void
+resource_fini(void)
+{
+    FreeClientResources(&test_client);
+    FreeClientResources(serverClient);
+}
+
+static XID
+test_id(int i)
+{
+    return test_client.clientAsMask | (i + 1);
+}
+
+static void
+resource_add_lookup_free(void)
+{
+    const int num = 5000;
+    void *value;
+    int i, rc;
+
+    resource_init();
+
+    for (i = 0; i < num; i++)
+        assert(AddResource(test_id(i), TestType, (void *) (uintptr_t) i));
+
+    for (i = 0; i < num; i++) {
+        rc = dixLookupResourceByType(&value, test_id(i), TestType, NULL,
+                                     DixReadAccess);
+        assert(rc == Success);
+        assert(value == (void *) (uintptr_t) i);
+
+        /* repeated lookups go through the cache */
+        rc = dixLookupResourceByType(&value, test_id(i), TestType, NULL,
+                                     DixReadAccess);
+        assert(rc == Success);
+        assert(value == (void *) (uintptr_t) i);
+
+        rc = dixLookupResourceByType(&value, test_id(i), OtherType, NULL,
+                                     DixReadAccess);
+        assert(rc == BadValue);
+        assert(value == NULL);
+    }
+
+    rc = dixLookupResourceByClass(&value, test_id(num), RC_ANY, NULL,
+                                  DixReadAccess);
+    assert(rc == BadValue);
+
+    /* free every other one, the rest must still be found */
+    for (i = 0; i < num; i += 2)
+        FreeResource(test_id(i), RT_NONE);
+    assert(deleted == num / 2);
+
+    for (i = 0; i < num; i++) {
+        rc = dixLookupResourceByType(&value, test_id(i), TestType, NULL,
+                                     DixReadAccess);
+        assert(rc == ((i & 1) ? Success : BadValue));
+    }
+
+    assert(ChangeResourceValue(test_id(1), TestType, (void *) 42));
+    assert(!ChangeResourceValue(test_id(0), TestType, (void *) 42));
+    rc = dixLookupResourceByType(&value, test_id(1), TestType, NULL,
+                                 DixReadAccess);
+    assert(rc == Success && value == (void *) 42);
+
+    FreeResourceByType(test_id(1), TestType, TRUE);
+    assert(deleted == num / 2);
+    rc = dixLookupResourceByType(&value, test_id(1), TestType, NULL,
+                                 DixReadAccess);
+    assert(rc == BadValue);
+
+    resource_fini();
+    assert(deleted == num - 1);
+}
+
+static void
+resource_same_id(void)
+{
+    void *value;
+    int rc;
+
+    resource_init();
+
+    /* the most recently added resource of a type wins */
+    assert(AddResource(test_id(0), TestType, (void *) 1));
+    rc = dixLookupResourceByType(&value, test_id(0), TestType, NULL,
+                                 DixReadAccess);
+    assert(rc == Success && value == (void *) 1);
+    assert(AddResource(test_id(0), TestType, (void *) 2));
+    rc = dixLookupResourceByType(&value, test_id(0), TestType, NULL,
+                                 DixReadAccess);
+    assert(rc == Success && value == (void *) 2);
+
+    assert(AddResource(test_id(0), RT_NONE, (void *) 3));
+    rc = dixLookupResourceByClass(&value, test_id(0), RC_ANY, NULL,
+                                  DixReadAccess);
+    assert(rc == Success && value == (void *) 2);
+
+    FreeResourceByType(test_id(0), TestType, FALSE);
+    rc = dixLookupResourceByType(&value, test_id(0), TestType, NULL,
+                                 DixReadAccess);
+    assert(rc == Success && value == (void *) 1);
+
+    FreeResource(test_id(0), RT_NONE);
+    rc = dixLookupResourceByType(&value, test_id(0), TestType, NULL,
+                                 DixReadAccess);
+    assert(rc == BadValue);
+    assert(deleted == 2);
+
+    resource_fini();
+}
+
+static void
+count_resource(void *value, XID id, void *cdata)
+{
+    int *count = cdata;
+
+    (*count)++;
+    FreeResource(id, RT_NONE);
+}
+
+static void
+resource_free_while_walking(void)
+{
+    const int num = 1000;
+    int i, count = 0;
+
+    resource_init();
+
+    /* each of these frees the next one when deleted */
+    for (i = 0; i < num; i++)
+        assert(AddResource(test_id(i), OtherType,
+                           (void *) (uintptr_t) test_id(i + 1)));
+    for (i = num; i < 2 * num; i++)
+        assert(AddResource(test_id(i), TestType, NULL));
+
+    FreeResource(test_id(0), RT_NONE);
+    assert(deleted == num + 1);
+
+    FindClientResourcesByType(&test_client, TestType, count_resource, &count);
+    assert(count == num - 1);
+    assert(deleted == 2 * num);
+
+    for (i = 0; i < num; i++)
+        assert(AddResource(test_id(i), OtherType,
+                           (void *) (uintptr_t) test_id(num - 1 - i)));
+    resource_fini();
+    assert(deleted == 3 * num);
+}
+
+static double
+elapsed_ms(struct timespec *start)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1e3 +
+        (now.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+static void
+resource_benchmark(void)
+{
+    int num, i, j;
+
+    for (num = 1000; num <= 1000000; num *= 10) {
+        struct timespec start;
+        double add_ms, lookup_ms, free_ms;
+        int lookups = max(num, 1000000);
+        void *value;
+
+        resource_init();
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (i = 0; i < num; i++)
+            AddResource(test_id(i), TestType, NULL);
+        add_ms = elapsed_ms(&start);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (i = 0, j = 0; i < lookups; i++) {
+            j = (j + 7919) % num;
+            dixLookupResourceByType(&value, test_id(j), TestType, NULL,
+                                    DixReadAccess);
+        }
+        lookup_ms = elapsed_ms(&start);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        FreeClientResources(&test_client);
+        free_ms = elapsed_ms(&start);
+        assert(deleted == num);
+
+        printf("%9d resources: insert %8.2f ns, lookup %8.2f ns, "
+               "bulk free %8.2f ns per resource\n", num,
+               add_ms * 1e6 / num, lookup_ms * 1e6 / lookups,
+               free_ms * 1e6 / num);
+
+        FreeClientResources(serverClient);
+    }
+}
+
+int
+resource_test(void)
+{
+    resource_add_lookup_free();
+    resource_same_id();
+    resource_free_while_walking();
+    if (getenv("XSERVER_RESOURCE_BENCH"))
+        resource_benchmark();
+
+    return 0;
+}
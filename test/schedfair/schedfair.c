@@ -0,0 +1,216 @@
+/*
+ * Copyright © 2026 X.Org Foundation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+/*
+ * Measures how the smart scheduler shares the server between interactive
+ * and bulk clients.  Bulk clients stream large PutImage requests as fast
+ * as they can; interactive clients make a round trip every few
+ * milliseconds, like a terminal or an editor echoing keys.  Reported are
+ * the interactive round trip latencies and how evenly the bulk clients
+ * were served (Jain's fairness index, 1.0 being perfectly even).  Every
+ * client must make progress.  The measurements run for longer and are
+ * only printed with XSERVER_SCHEDFAIR_BENCH set.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <xcb/xcb.h>
+
+#define NUM_BULK 4
+#define NUM_INTERACTIVE 4
+#define BULK_WIDTH 1024
+#define BULK_HEIGHT 128
+#define INTERACTIVE_PERIOD_US 5000
+#define MAX_ROUNDS 2000
+
+typedef struct {
+    long ops;
+    double p50, p99, max;
+} result_t;
+
+static double duration = 0.5;
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+round_trip(xcb_connection_t *c)
+{
+    free(xcb_get_input_focus_reply(c, xcb_get_input_focus(c), NULL));
+}
+
+static int
+compare_double(const void *a, const void *b)
+{
+    double x = *(const double *) a, y = *(const double *) b;
+
+    return x < y ? -1 : x > y;
+}
+
+static void
+wait_until(double t)
+{
+    double delay = t - now();
+
+    if (delay > 0)
+        usleep(delay * 1e6);
+}
+
+static void
+bulk(xcb_connection_t *c, double start, result_t *result)
+{
+    xcb_screen_t *screen = xcb_setup_roots_iterator(xcb_get_setup(c)).data;
+    xcb_pixmap_t pixmap = xcb_generate_id(c);
+    xcb_gcontext_t gc = xcb_generate_id(c);
+    size_t size = BULK_WIDTH * BULK_HEIGHT * 4;
+    uint8_t *data = malloc(size);
+
+    assert(data);
+    memset(data, 0x5a, size);
+    xcb_create_pixmap(c, 24, pixmap, screen->root, BULK_WIDTH, BULK_HEIGHT);
+    xcb_create_gc(c, gc, pixmap, 0, NULL);
+    round_trip(c);
+
+    wait_until(start);
+    while (now() < start + duration) {
+        xcb_put_image(c, XCB_IMAGE_FORMAT_Z_PIXMAP, pixmap, gc,
+                      BULK_WIDTH, BULK_HEIGHT, 0, 0, 0, 24, size, data);
+        round_trip(c);
+        result->ops++;
+    }
+    free(data);
+}
+
+static void
+interactive(xcb_connection_t *c, double start, result_t *result)
+{
+    static double latency[MAX_ROUNDS];
+    double t;
+
+    wait_until(start);
+    while (now() < start + duration && result->ops < MAX_ROUNDS) {
+        t = now();
+        round_trip(c);
+        latency[result->ops++] = now() - t;
+        usleep(INTERACTIVE_PERIOD_US);
+    }
+
+    qsort(latency, result->ops, sizeof(double), compare_double);
+    result->p50 = latency[result->ops / 2] * 1e3;
+    result->p99 = latency[result->ops * 99 / 100] * 1e3;
+    result->max = latency[result->ops - 1] * 1e3;
+}
+
+static pid_t
+spawn(int is_bulk, double start, int fd)
+{
+    pid_t pid = fork();
+    xcb_connection_t *c;
+    result_t result = { 0 };
+
+    assert(pid >= 0);
+    if (pid)
+        return pid;
+
+    c = xcb_connect(NULL, NULL);
+    if (!c || xcb_connection_has_error(c))
+        _exit(1);
+    if (is_bulk)
+        bulk(c, start, &result);
+    else
+        interactive(c, start, &result);
+    if (xcb_connection_has_error(c))
+        _exit(1);
+    xcb_disconnect(c);
+
+    if (write(fd, &result, sizeof(result)) != sizeof(result))
+        _exit(1);
+    _exit(0);
+}
+
+int
+main(int argc, char **argv)
+{
+    result_t results[NUM_BULK + NUM_INTERACTIVE];
+    pid_t pids[NUM_BULK + NUM_INTERACTIVE];
+    int fds[NUM_BULK + NUM_INTERACTIVE][2];
+    double start = now() + 1.0, sum = 0, sum_sq = 0;
+    long min_ops = -1, max_ops = 0;
+    int i, status;
+
+    if (getenv("XSERVER_SCHEDFAIR_BENCH"))
+        duration = 3.0;
+
+    for (i = 0; i < NUM_BULK + NUM_INTERACTIVE; i++) {
+        assert(pipe(fds[i]) == 0);
+        pids[i] = spawn(i < NUM_BULK, start, fds[i][1]);
+        close(fds[i][1]);
+    }
+
+    for (i = 0; i < NUM_BULK + NUM_INTERACTIVE; i++) {
+        assert(read(fds[i][0], &results[i], sizeof(results[i])) ==
+               sizeof(results[i]));
+        close(fds[i][0]);
+        assert(waitpid(pids[i], &status, 0) == pids[i]);
+        assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+        assert(results[i].ops > 0);
+    }
+
+    if (!getenv("XSERVER_SCHEDFAIR_BENCH"))
+        return 0;
+
+    for (i = 0; i < NUM_BULK; i++) {
+        long ops = results[i].ops;
+
+        sum += ops;
+        sum_sq += (double) ops * ops;
+        if (min_ops < 0 || ops < min_ops)
+            min_ops = ops;
+        if (ops > max_ops)
+            max_ops = ops;
+    }
+    printf("bulk: %ld-%ld PutImage/client, %.1f MB/s total, fairness %.3f\n",
+           min_ops, max_ops,
+           sum * BULK_WIDTH * BULK_HEIGHT * 4 / duration / 1e6,
+           sum * sum / (NUM_BULK * sum_sq));
+
+    for (i = NUM_BULK; i < NUM_BULK + NUM_INTERACTIVE; i++)
+        printf("interactive %d: %ld round trips, "
+               "p50 %.2f ms, p99 %.2f ms, max %.2f ms\n",
+               i - NUM_BULK, results[i].ops,
+               results[i].p50, results[i].p99, results[i].max);
+
+    return 0;
+}
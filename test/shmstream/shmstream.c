@@ -0,0 +1,156 @@
+/*
+ * Copyright © 2026 X.Org Foundation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+/*
+ * Streams screen-sized frames through MIT-SHM: ShmPutImage into a window
+ * and ShmGetImage back out of it, as a compositor or screen recorder would.
+ * Every frame is checked at one pixel so a dropped or partial copy fails.
+ * With XSERVER_SHMSTREAM_BENCH set, more frames are streamed and the rates
+ * are printed.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <xcb/xcb.h>
+#include <xcb/shm.h>
+
+/* Even, so that the last frame put is blue */
+static int frames = 2;
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+report(const char *name, double start, int width, int height)
+{
+    double ms = (now() - start) * 1e3 / frames;
+
+    printf("%s: %.2f ms/frame, %.0f frames/s, %.0f MB/s\n", name, ms,
+           1e3 / ms, (double) width * height * 4 / ms / 1e3);
+}
+
+int
+main(int argc, char **argv)
+{
+    xcb_connection_t *c = xcb_connect(NULL, NULL);
+    xcb_screen_t *screen;
+    const xcb_query_extension_reply_t *ext;
+    xcb_window_t window;
+    xcb_gcontext_t gc;
+    xcb_shm_seg_t seg;
+    uint32_t *pixels;
+    int width, height, shmid, i;
+    size_t size;
+    int bench = getenv("XSERVER_SHMSTREAM_BENCH") != NULL;
+    double start;
+
+    if (!c || xcb_connection_has_error(c)) {
+        fprintf(stderr, "Failed to connect to X server\n");
+        return 1;
+    }
+    ext = xcb_get_extension_data(c, &xcb_shm_id);
+    if (!ext || !ext->present) {
+        fprintf(stderr, "MIT-SHM not available\n");
+        return 77;
+    }
+    screen = xcb_setup_roots_iterator(xcb_get_setup(c)).data;
+    width = screen->width_in_pixels;
+    height = screen->height_in_pixels;
+    size = (size_t) width * height * 4;
+    if (bench)
+        frames = 60;
+
+    shmid = shmget(IPC_PRIVATE, size, IPC_CREAT | 0600);
+    assert(shmid >= 0);
+    pixels = shmat(shmid, NULL, 0);
+    assert(pixels != (void *) -1);
+    seg = xcb_generate_id(c);
+    xcb_shm_attach(c, seg, shmid, 0);
+
+    window = xcb_generate_id(c);
+    xcb_create_window(c, XCB_COPY_FROM_PARENT, window, screen->root,
+                      0, 0, width, height, 0, XCB_WINDOW_CLASS_INPUT_OUTPUT,
+                      screen->root_visual, 0, NULL);
+    xcb_map_window(c, window);
+    gc = xcb_generate_id(c);
+    xcb_create_gc(c, gc, window, 0, NULL);
+
+    start = now();
+    for (i = 0; i < frames; i++) {
+        uint32_t pixel = i & 1 ? 0x0000ff : 0x00ff00;
+        xcb_get_image_reply_t *reply;
+        size_t j;
+
+        for (j = 0; j < size / 4; j++)
+            pixels[j] = pixel;
+        xcb_shm_put_image(c, window, gc, width, height, 0, 0, width, height,
+                          0, 0, screen->root_depth,
+                          XCB_IMAGE_FORMAT_Z_PIXMAP, 0, seg, 0);
+        reply = xcb_get_image_reply(c,
+                                    xcb_get_image(c, XCB_IMAGE_FORMAT_Z_PIXMAP,
+                                                  window, width - 1,
+                                                  height - 1, 1, 1, ~0),
+                                    NULL);
+        assert(reply);
+        assert((*(uint32_t *) xcb_get_image_data(reply) & 0xffffff) == pixel);
+        free(reply);
+    }
+    if (bench)
+        report("put", start, width, height);
+
+    start = now();
+    for (i = 0; i < frames; i++) {
+        xcb_shm_get_image_cookie_t cookie;
+        xcb_shm_get_image_reply_t *reply;
+
+        pixels[size / 4 - 1] = 0;
+        cookie = xcb_shm_get_image(c, window, 0, 0, width, height, ~0,
+                                   XCB_IMAGE_FORMAT_Z_PIXMAP, seg, 0);
+        reply = xcb_shm_get_image_reply(c, cookie, NULL);
+        assert(reply);
+        assert((pixels[size / 4 - 1] & 0xffffff) == 0x0000ff);
+        free(reply);
+    }
+    if (bench)
+        report("get", start, width, height);
+
+    xcb_shm_detach(c, seg);
+    assert(!xcb_connection_has_error(c));
+    xcb_disconnect(c);
+    shmdt(pixels);
+    shmctl(shmid, IPC_RMID, NULL);
+
+    return 0;
+}
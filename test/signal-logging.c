@@ -396,11 +396,93 @@ static void logging_format(void)
 }
 #pragma GCC diagnostic pop /* "-Wformat-security" */
 
+/* Lines logged through the writer thread arrive complete and in order. */
+static void
+logging_async(void)
+{
+    const char *log_file_path = "/tmp/Xorg-logging-async-test.log";
+    unsigned long queue_full, rate_limited;
+    char read_buf[2048];
+    FILE *f;
+    int i, n, last = -1, lines = 0;
+
+    LogInit(log_file_path, NULL);
+    if (!LogSetParameter(XLOG_ASYNC, TRUE)) {
+        /* built without thread support */
+        LogClose(EXIT_NO_ERROR);
+        unlink(log_file_path);
+        return;
+    }
+
+    for (i = 0; i < 10000; i++) {
+        LogMessageVerb(X_INFO, 1, "line %d ", i);
+        LogWrite(1, "of %d\n", 10000);
+    }
+    LogGetDropped(&queue_full, &rate_limited);
+    LogClose(EXIT_NO_ERROR);
+    LogSetParameter(XLOG_ASYNC, FALSE);
+
+    assert((f = fopen(log_file_path, "r")));
+    while (fgets(read_buf, sizeof(read_buf), f)) {
+        char *msg = strchr(read_buf, ']');
+
+        assert(msg);
+        if (sscanf(msg, "] (II) line %d of 10000\n", &n) == 1) {
+            assert(n > last);
+            last = n;
+            lines++;
+        }
+    }
+    fclose(f);
+    unlink(log_file_path);
+
+    /* a full queue may have cost some lines, but never silently */
+    assert(lines + queue_full >= 10000);
+}
+
+/* Only the first burst of messages gets past XLOG_RATE_LIMIT. */
+static void
+logging_rate_limit(void)
+{
+    const char *log_file_path = "/tmp/Xorg-logging-rate-test.log";
+    unsigned long queue_full, rate_limited, before;
+    char read_buf[2048];
+    FILE *f;
+    int i, lines = 0, errors = 0;
+
+    LogInit(log_file_path, NULL);
+    LogGetDropped(&queue_full, &before);
+    LogSetParameter(XLOG_RATE_LIMIT, 10);
+    for (i = 0; i < 100; i++)
+        LogMessageVerb(X_INFO, 1, "limited %d\n", i);
+    LogMessageVerb(X_ERROR, 1, "never limited\n");
+    LogGetDropped(&queue_full, &rate_limited);
+    LogSetParameter(XLOG_RATE_LIMIT, 0);
+    LogClose(EXIT_NO_ERROR);
+
+    assert(rate_limited - before >= 80);
+
+    assert((f = fopen(log_file_path, "r")));
+    while (fgets(read_buf, sizeof(read_buf), f)) {
+        if (strstr(read_buf, "(II) limited"))
+            lines++;
+        else if (strstr(read_buf, "never limited"))
+            errors++;
+    }
+    fclose(f);
+    unlink(log_file_path);
+
+    assert(lines == 100 - (rate_limited - before));
+    assert(errors == 1);
+}
+
 int
 signal_logging_test(void)
 {
     number_formatting();
     logging_format();
+    logging_async();
+    logging_rate_limit();
 
     return 0;
 }
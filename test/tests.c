@@ -11,8 +11,13 @@ main(int argc, char **argv)
 #ifdef XORG_TESTS
     run_test(fixes_test);
     run_test(input_test);
+    run_test(io_test);
     run_test(misc_test);
+    run_test(picking_test);
+    run_test(property_test);
+    run_test(resource_test);
     run_test(signal_logging_test);
+    run_test(timer_test);
     run_test(touch_test);
     run_test(xfree86_test);
     run_test(xkb_test);
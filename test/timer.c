@@ -0,0 +1,230 @@
+/**
+ * Copyright © 2026 X.Org Foundation
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice (including the next
+ *  paragraph) shall be included in all copies or substantial portions of the
+ *  Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifdef HAVE_DIX_CONFIG_H
+#include <dix-config.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include "misc.h"
+#include "os.h"
+
+#include "tests-common.h"
+
+/*
+ * OsTimer tests: timers must fire in expiry order, in arming order when
+ * they expire together, never after being cancelled, and a callback must
+ * be able to re-arm its own timer.  With XSERVER_TIMER_BENCH set, arming
+ * and cancelling 100000 timers is timed too.
+ */
+
+#define NUM_TIMERS      1000
+
+static CARD32 expiry[NUM_TIMERS];
+static int armed[NUM_TIMERS];   /* when each timer was last armed */
+static int fired[NUM_TIMERS];
+static int nfired;
+
+static CARD32
+record_fire(OsTimerPtr timer, CARD32 now, void *arg)
+{
+    fired[nfired++] = (intptr_t) arg;
+    return 0;
+}
+
+static int repeats;
+
+static CARD32
+repeat_fire(OsTimerPtr timer, CARD32 now, void *arg)
+{
+    return ++repeats < 5 ? 1 : 0;
+}
+
+static void
+run_timers_until(int *count, int want)
+{
+    CARD32 start = GetTimeInMillis();
+
+    while (*count < want) {
+        assert(GetTimeInMillis() - start < 5000);
+        usleep(500);
+        TimerCheck();
+    }
+}
+
+static void
+timer_order(void)
+{
+    OsTimerPtr timers[NUM_TIMERS];
+    CARD32 now = GetTimeInMillis();
+    int i, expected = 0;
+
+    srand(1);
+    for (i = 0; i < NUM_TIMERS; i++) {
+        /* few distinct expiry times, so plenty of ties */
+        expiry[i] = now + 50 + rand() % 20;
+        timers[i] = TimerSet(NULL, TimerAbsolute, expiry[i], record_fire,
+                             (void *) (intptr_t) i);
+        assert(timers[i]);
+        armed[i] = i;
+    }
+
+    /* cancel a third of them, and move some others */
+    for (i = 0; i < NUM_TIMERS; i++) {
+        if (i % 3 == 0)
+            TimerCancel(timers[i]);
+        else if (i % 3 == 1 && i % 2) {
+            expiry[i] = now + 50 + rand() % 20;
+            TimerSet(timers[i], TimerAbsolute, expiry[i], record_fire,
+                     (void *) (intptr_t) i);
+            armed[i] = NUM_TIMERS + i;
+        }
+    }
+    for (i = 0; i < NUM_TIMERS; i++)
+        if (i % 3)
+            expected++;
+
+    run_timers_until(&nfired, expected);
+    assert(nfired == expected);
+
+    for (i = 0; i < nfired; i++) {
+        assert(fired[i] % 3 != 0);
+        if (i > 0) {
+            int diff = expiry[fired[i]] - expiry[fired[i - 1]];
+
+            assert(diff >= 0);
+            if (diff == 0)
+                assert(armed[fired[i]] > armed[fired[i - 1]]);
+        }
+    }
+
+    /* nothing left to fire */
+    for (i = 0; i < NUM_TIMERS; i++)
+        assert(!TimerForce(timers[i]));
+
+    for (i = 0; i < NUM_TIMERS; i++)
+        TimerFree(timers[i]);
+}
+
+/* Timers expiring together fire in the order they were armed, whatever
+ * their position in the heap */
+static void
+timer_ties(void)
+{
+    static const int order[] = { 7, 2, 9, 0, 4, 8, 1, 6, 3, 5 };
+    OsTimerPtr timers[ARRAY_SIZE(order)];
+    CARD32 when = GetTimeInMillis() + 30;
+    int i;
+
+    nfired = 0;
+    for (i = 0; i < ARRAY_SIZE(order); i++) {
+        timers[i] = TimerSet(NULL, TimerAbsolute, when, record_fire,
+                             (void *) (intptr_t) order[i]);
+        assert(timers[i]);
+    }
+    /* an earlier and a later timer around them */
+    timers[0] = TimerSet(timers[0], TimerAbsolute, when - 10, record_fire,
+                         (void *) (intptr_t) -1);
+    timers[1] = TimerSet(timers[1], TimerAbsolute, when + 10, record_fire,
+                         (void *) (intptr_t) 10);
+
+    run_timers_until(&nfired, ARRAY_SIZE(order));
+    assert(fired[0] == -1);
+    for (i = 2; i < ARRAY_SIZE(order); i++)
+        assert(fired[i - 1] == order[i]);
+    assert(fired[ARRAY_SIZE(order) - 1] == 10);
+
+    for (i = 0; i < ARRAY_SIZE(order); i++)
+        TimerFree(timers[i]);
+}
+
+static void
+timer_rearm(void)
+{
+    OsTimerPtr timer = TimerSet(NULL, 0, 1, repeat_fire, NULL);
+
+    assert(timer);
+    run_timers_until(&repeats, 5);
+    assert(!TimerForce(timer));
+    TimerFree(timer);
+}
+
+static double
+elapsed_ms(struct timespec *start)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1e3 +
+        (now.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+static void
+timer_benchmark(void)
+{
+    const int num = 100000;
+    OsTimerPtr *timers = calloc(num, sizeof(OsTimerPtr));
+    struct timespec start;
+    double arm_ms, cancel_ms;
+    int i;
+
+    assert(timers);
+    for (i = 0; i < num; i++) {
+        timers[i] = TimerSet(NULL, 0, 0, NULL, NULL);
+        assert(timers[i]);
+    }
+
+    srand(2);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < num; i++)
+        TimerSet(timers[i], 0, 60000 + rand() % 60000, record_fire, NULL);
+    arm_ms = elapsed_ms(&start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < num; i++)
+        TimerCancel(timers[(i * 7919) % num]);
+    cancel_ms = elapsed_ms(&start);
+
+    printf("%d timers: arm %.3f us, cancel %.3f us\n", num,
+           arm_ms * 1e3 / num, cancel_ms * 1e3 / num);
+
+    for (i = 0; i < num; i++)
+        TimerFree(timers[i]);
+    free(timers);
+}
+
+int
+timer_test(void)
+{
+    timer_order();
+    timer_ties();
+    timer_rearm();
+    if (getenv("XSERVER_TIMER_BENCH"))
+        timer_benchmark();
+
+    return 0;
+}
@@ -0,0 +1,328 @@
+/*
+ * Copyright © 2026 X.Org Foundation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Measures ConfigureWindow latency over large window trees: a wide grid of
+ * sibling windows and a deep chain of nested windows, each with a small
+ * override-redirect window being moved, raised and lowered across it.
+ * Every request is followed by a round trip so the time includes the
+ * server revalidating the tree.
+ *
+ * The covered case moves and restacks windows hidden under an opaque
+ * sibling, above a grid whose clipping therefore doesn't change; that is
+ * what the unchanged clip shortcut in miComputeClips skips.  It must not
+ * generate exposures, and drawing into every window afterwards must give
+ * the same pixels as after the tree was unmapped and mapped again, which
+ * computes all clips from scratch.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <xcb/xcb.h>
+
+#define GRID_SIZE 40
+#define DEEP_LEVELS 200
+#define ITERATIONS 2000
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+round_trip(xcb_connection_t *c)
+{
+    free(xcb_get_input_focus_reply(c, xcb_get_input_focus(c), NULL));
+}
+
+static xcb_window_t
+create_window(xcb_connection_t *c, xcb_screen_t *screen, xcb_window_t parent,
+              int x, int y, int w, int h, int override)
+{
+    xcb_window_t win = xcb_generate_id(c);
+    uint32_t values[2] = { screen->white_pixel, override };
+
+    xcb_create_window(c, XCB_COPY_FROM_PARENT, win, parent, x, y, w, h, 1,
+                      XCB_WINDOW_CLASS_INPUT_OUTPUT, XCB_COPY_FROM_PARENT,
+                      XCB_CW_BACK_PIXEL | XCB_CW_OVERRIDE_REDIRECT, values);
+    return win;
+}
+
+static void
+bench_configure(xcb_connection_t *c, xcb_window_t win, const char *name,
+                int width, int height)
+{
+    double start, elapsed;
+    int i;
+
+    xcb_map_window(c, win);
+    round_trip(c);
+
+    start = now();
+    for (i = 0; i < ITERATIONS; i++) {
+        uint32_t pos[2] = { (i * 7) % (width - 32), (i * 13) % (height - 32) };
+
+        xcb_configure_window(c, win,
+                             XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y, pos);
+        round_trip(c);
+    }
+    elapsed = now() - start;
+    printf("%s: move %.1f us/request\n", name, elapsed * 1e6 / ITERATIONS);
+
+    start = now();
+    for (i = 0; i < ITERATIONS; i++) {
+        uint32_t mode = (i & 1) ? XCB_STACK_MODE_ABOVE : XCB_STACK_MODE_BELOW;
+
+        xcb_configure_window(c, win, XCB_CONFIG_WINDOW_STACK_MODE, &mode);
+        round_trip(c);
+    }
+    elapsed = now() - start;
+    printf("%s: restack %.1f us/request\n", name, elapsed * 1e6 / ITERATIONS);
+
+    start = now();
+    for (i = 0; i < ITERATIONS; i++) {
+        if (i & 1)
+            xcb_map_window(c, win);
+        else
+            xcb_unmap_window(c, win);
+        round_trip(c);
+    }
+    elapsed = now() - start;
+    printf("%s: map/unmap %.1f us/request\n", name, elapsed * 1e6 / ITERATIONS);
+
+    xcb_unmap_window(c, win);
+}
+
+static void
+bench_wide(xcb_connection_t *c, xcb_screen_t *screen)
+{
+    int w = screen->width_in_pixels, h = screen->height_in_pixels;
+    xcb_window_t top, mover;
+    int x, y;
+
+    top = create_window(c, screen, screen->root, 0, 0, w, h, 1);
+    for (y = 0; y < GRID_SIZE; y++) {
+        for (x = 0; x < GRID_SIZE; x++) {
+            xcb_window_t child =
+                create_window(c, screen, top, x * w / GRID_SIZE,
+                              y * h / GRID_SIZE, w / GRID_SIZE + 8,
+                              h / GRID_SIZE + 8, 0);
+
+            create_window(c, screen, child, 2, 2, 4, 4, 0);
+        }
+    }
+    xcb_map_subwindows(c, top);
+    xcb_map_window(c, top);
+    mover = create_window(c, screen, screen->root, 0, 0, 32, 32, 1);
+
+    bench_configure(c, mover, "wide", w, h);
+
+    xcb_destroy_window(c, mover);
+    xcb_destroy_window(c, top);
+}
+
+static void
+bench_deep(xcb_connection_t *c, xcb_screen_t *screen)
+{
+    int w = screen->width_in_pixels, h = screen->height_in_pixels;
+    xcb_window_t top, parent, mover;
+    int i;
+
+    top = parent = create_window(c, screen, screen->root, 0, 0, w, h, 1);
+    for (i = 0; i < DEEP_LEVELS; i++) {
+        xcb_window_t child = create_window(c, screen, parent, 1, 1,
+                                           w - 2 * (i + 2), h - 2 * (i + 2), 0);
+
+        /* a sibling at every level so each one has something to clip */
+        xcb_map_window(c, create_window(c, screen, parent, w / 2, 0,
+                                        16, 16, 0));
+        xcb_map_window(c, child);
+        parent = child;
+    }
+    xcb_map_window(c, top);
+    mover = create_window(c, screen, screen->root, 0, 0, 32, 32, 1);
+
+    bench_configure(c, mover, "deep", w, h);
+
+    xcb_destroy_window(c, mover);
+    xcb_destroy_window(c, top);
+}
+
+static int
+count_exposures(xcb_connection_t *c)
+{
+    xcb_generic_event_t *ev;
+    int exposures = 0;
+
+    round_trip(c);
+    while ((ev = xcb_poll_for_event(c))) {
+        if ((ev->response_type & 0x7f) == XCB_EXPOSE)
+            exposures++;
+        free(ev);
+    }
+    return exposures;
+}
+
+static xcb_window_t
+create_colored(xcb_connection_t *c, xcb_window_t parent,
+               int x, int y, int w, int h, uint32_t pixel)
+{
+    xcb_window_t win = xcb_generate_id(c);
+    uint32_t values[2] = { pixel, XCB_EVENT_MASK_EXPOSURE };
+
+    xcb_create_window(c, 24, win, parent, x, y, w, h, 0,
+                      XCB_WINDOW_CLASS_INPUT_OUTPUT, XCB_COPY_FROM_PARENT,
+                      XCB_CW_BACK_PIXEL | XCB_CW_EVENT_MASK, values);
+    return win;
+}
+
+/* Fills each window with a color of its own, through its clip, and reads
+ * back the screen */
+static uint8_t *
+draw_and_read(xcb_connection_t *c, xcb_screen_t *screen,
+              xcb_window_t *windows, int num, int *len)
+{
+    xcb_gcontext_t gc = xcb_generate_id(c);
+    xcb_rectangle_t rect = { 0, 0, 0xffff, 0xffff };
+    xcb_get_image_reply_t *reply;
+    uint8_t *pixels;
+    int i;
+
+    xcb_create_gc(c, gc, screen->root, 0, NULL);
+    for (i = 0; i < num; i++) {
+        uint32_t pixel = 0x010101 * (i % 200) + 0x400000;
+
+        xcb_change_gc(c, gc, XCB_GC_FOREGROUND, &pixel);
+        xcb_poly_fill_rectangle(c, windows[i], gc, 1, &rect);
+    }
+    xcb_free_gc(c, gc);
+
+    reply = xcb_get_image_reply(c,
+                                xcb_get_image(c, XCB_IMAGE_FORMAT_Z_PIXMAP,
+                                              screen->root, 0, 0,
+                                              screen->width_in_pixels,
+                                              screen->height_in_pixels, ~0),
+                                NULL);
+    assert(reply);
+    *len = xcb_get_image_data_length(reply);
+    pixels = malloc(*len);
+    assert(pixels);
+    memcpy(pixels, xcb_get_image_data(reply), *len);
+    free(reply);
+    return pixels;
+}
+
+static void
+bench_covered(xcb_connection_t *c, xcb_screen_t *screen)
+{
+    int w = screen->width_in_pixels, h = screen->height_in_pixels;
+    int num = GRID_SIZE * GRID_SIZE + 3;
+    xcb_window_t *windows = calloc(num, sizeof(xcb_window_t));
+    xcb_window_t top, *movers = &windows[num - 3];
+    int cx = w / 4, cy = h / 4, cw = w / 2, ch = h / 2;
+    uint8_t *incremental, *fresh;
+    int x, y, i, n = 0, len, fresh_len;
+    double start, elapsed;
+
+    assert(windows);
+    top = create_window(c, screen, screen->root, 0, 0, w, h, 1);
+    for (y = 0; y < GRID_SIZE; y++)
+        for (x = 0; x < GRID_SIZE; x++, n++)
+            windows[n] = create_colored(c, top, x * w / GRID_SIZE,
+                                        y * h / GRID_SIZE, w / GRID_SIZE + 8,
+                                        h / GRID_SIZE + 8, n);
+    movers[0] = create_colored(c, top, cx + 8, cy + 8, 64, 64, 0xff0000);
+    movers[1] = create_colored(c, top, cx + 40, cy + 40, 64, 64, 0x00ff00);
+    /* the cover, above both movers */
+    windows[num - 1] = create_colored(c, top, cx, cy, cw, ch, 0x0000ff);
+    xcb_map_subwindows(c, top);
+    xcb_map_window(c, top);
+    count_exposures(c);
+
+    start = now();
+    for (i = 0; i < ITERATIONS; i++) {
+        uint32_t pos[2] = { cx + (i * 7) % (cw - 64),
+                            cy + (i * 13) % (ch - 64) };
+
+        xcb_configure_window(c, movers[i & 1],
+                             XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y, pos);
+        round_trip(c);
+    }
+    elapsed = now() - start;
+    printf("covered: move %.1f us/request\n", elapsed * 1e6 / ITERATIONS);
+
+    start = now();
+    for (i = 0; i < ITERATIONS; i++) {
+        uint32_t values[2] = { movers[!(i & 1)], XCB_STACK_MODE_ABOVE };
+
+        xcb_configure_window(c, movers[i & 1], XCB_CONFIG_WINDOW_SIBLING |
+                             XCB_CONFIG_WINDOW_STACK_MODE, values);
+        round_trip(c);
+    }
+    elapsed = now() - start;
+    printf("covered: restack %.1f us/request\n", elapsed * 1e6 / ITERATIONS);
+
+    /* nothing visible changed, so nothing may be exposed */
+    assert(count_exposures(c) == 0);
+
+    incremental = draw_and_read(c, screen, windows, num, &len);
+    xcb_unmap_window(c, top);
+    xcb_map_window(c, top);
+    count_exposures(c);
+    fresh = draw_and_read(c, screen, windows, num, &fresh_len);
+    assert(len == fresh_len && memcmp(incremental, fresh, len) == 0);
+
+    free(incremental);
+    free(fresh);
+    free(windows);
+    xcb_destroy_window(c, top);
+}
+
+int
+main(int argc, char **argv)
+{
+    xcb_connection_t *c = xcb_connect(NULL, NULL);
+    xcb_screen_t *screen;
+
+    if (!c || xcb_connection_has_error(c)) {
+        fprintf(stderr, "Failed to connect to X server\n");
+        return 1;
+    }
+    screen = xcb_setup_roots_iterator(xcb_get_setup(c)).data;
+
+    bench_wide(c, screen);
+    bench_deep(c, screen);
+    bench_covered(c, screen);
+
+    assert(!xcb_connection_has_error(c));
+    xcb_disconnect(c);
+
+    return 0;
+}
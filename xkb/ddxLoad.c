@@ -32,6 +32,9 @@ THE USE OR PERFORMANCE OF THIS SOFTWARE.
 
 #include <stdio.h>
 #include <ctype.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 #include <X11/X.h>
 #include <X11/Xos.h>
 #include <X11/Xproto.h>
@@ -44,6 +47,15 @@ THE USE OR PERFORMANCE OF THIS SOFTWARE.
 #include <xkbsrv.h>
 #include <X11/extensions/XI.h>
 #include "xkb.h"
+#include "xsha1.h"
+
+#if defined(INPUTTHREAD) && !defined(WIN32)
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#endif
 
 #define	PRE_ERROR_MSG "\"The XKEYBOARD keymap compiler (xkbcomp) reports:\""
 #define	ERROR_PREFIX	"\"> \""
@@ -57,7 +69,8 @@ THE USE OR PERFORMANCE OF THIS SOFTWARE.
 #endif
 
 static unsigned
-LoadXKM(unsigned want, unsigned need, const char *keymap, XkbDescPtr *xkbRtrn);
+LoadXKM(unsigned want, unsigned need, const char *keymap, FILE *cached,
+        XkbDescPtr *xkbRtrn);
 
 static void
 OutputDirectory(char *outdir, size_t size)
@@ -81,45 +94,46 @@ OutputDirectory(char *outdir, size_t size)
     }
 }
 
+/**
+ * Path of the .xkm file for mapName in the output directory.
+ */
+static Bool
+XkmFileName(const char *mapName, char *buf, size_t size)
+{
+    char xkm_output_dir[PATH_MAX];
+
+    OutputDirectory(xkm_output_dir, sizeof(xkm_output_dir));
+    if ((XkbBaseDirectory != NULL) && (xkm_output_dir[0] != '/')
+#ifdef WIN32
+        && (!isalpha(xkm_output_dir[0]) || xkm_output_dir[1] != ':')
+#endif
+        )
+        return snprintf(buf, size, "%s/%s%s.xkm", XkbBaseDirectory,
+                        xkm_output_dir, mapName) < size;
+    return snprintf(buf, size, "%s%s.xkm", xkm_output_dir, mapName) < size;
+}
+
 /**
  * Callback invoked by XkbRunXkbComp. Write to out to talk to xkbcomp.
  */
 typedef void (*xkbcomp_buffer_callback)(FILE *out, void *userdata);
 
 /**
- * Start xkbcomp, let the callback write into xkbcomp's stdin. When done,
- * return a strdup'd copy of the file name we've written to.
+ * The xkbcomp command line compiling xkmfile (or "-" for stdin) into the
+ * keymap of the given name in the output directory.
  */
 static char *
-RunXkbComp(xkbcomp_buffer_callback callback, void *userdata)
+XkbCompCommand(const char *xkmfile, const char *keymap)
 {
-    FILE *out;
-    char *buf = NULL, keymap[PATH_MAX], xkm_output_dir[PATH_MAX];
+    char *buf = NULL, xkm_output_dir[PATH_MAX];
 
     const char *emptystring = "";
     char *xkbbasedirflag = NULL;
     const char *xkbbindir = emptystring;
     const char *xkbbindirsep = emptystring;
 
-#ifdef WIN32
-    /* WIN32 has no popen. The input must be stored in a file which is
-       used as input for xkbcomp. xkbcomp does not read from stdin. */
-    char tmpname[PATH_MAX];
-    const char *xkmfile = tmpname;
-#else
-    const char *xkmfile = "-";
-#endif
-
-    snprintf(keymap, sizeof(keymap), "server-%s", display);
-
     OutputDirectory(xkm_output_dir, sizeof(xkm_output_dir));
 
-#ifdef WIN32
-    strcpy(tmpname, Win32TempDir());
-    strcat(tmpname, "\\xkb_XXXXXX");
-    (void) mktemp(tmpname);
-#endif
-
     if (XkbBaseDirectory != NULL) {
         if (asprintf(&xkbbasedirflag, "\"-R%s\"", XkbBaseDirectory) == -1)
             xkbbasedirflag = NULL;
@@ -148,7 +162,37 @@ RunXkbComp(xkbcomp_buffer_callback callback, void *userdata)
         buf = NULL;
 
     free(xkbbasedirflag);
+    return buf;
+}
 
+/**
+ * Start xkbcomp, let the callback write into xkbcomp's stdin. When done,
+ * return a strdup'd copy of the file name we've written to.
+ */
+static char *
+RunXkbComp(xkbcomp_buffer_callback callback, void *userdata)
+{
+    FILE *out;
+    char *buf, keymap[PATH_MAX];
+
+#ifdef WIN32
+    /* WIN32 has no popen. The input must be stored in a file which is
+       used as input for xkbcomp. xkbcomp does not read from stdin. */
+    char tmpname[PATH_MAX];
+    const char *xkmfile = tmpname;
+#else
+    const char *xkmfile = "-";
+#endif
+
+    snprintf(keymap, sizeof(keymap), "server-%s", display);
+
+#ifdef WIN32
+    strcpy(tmpname, Win32TempDir());
+    strcat(tmpname, "\\xkb_XXXXXX");
+    (void) mktemp(tmpname);
+#endif
+
+    buf = XkbCompCommand(xkmfile, keymap);
     if (!buf) {
         LogMessage(X_ERROR,
                    "XKB: Could not invoke xkbcomp: not enough memory\n");
@@ -199,6 +243,560 @@ RunXkbComp(xkbcomp_buffer_callback callback, void *userdata)
     return NULL;
 }
 
+typedef struct {
+    const char *keymap;
+    size_t len;
+} XkbKeymapString;
+
+static void
+xkb_write_keymap_string_cb(FILE *out, void *userdata)
+{
+    XkbKeymapString *s = userdata;
+    fwrite(s->keymap, s->len, 1, out);
+}
+
+#ifndef WIN32
+/*
+ * Compiled keymaps are kept in the output directory under a name derived
+ * from xkbcomp's input, the modification times of the XKB data directories
+ * and the modification time and size of xkbcomp and of every component
+ * file the keymap includes, directly or through other component files.
+ * The next server (or the next keyboard) asking for the same keymap reads
+ * the .xkm instead of running xkbcomp again.
+ *
+ * The output directory may be shared, as /tmp is, and the names are easy
+ * to guess.  Cache files are therefore opened without following links,
+ * checked through the descriptor, and read from that same descriptor.
+ * Each use updates the file's modification time, and only the
+ * XKB_CACHE_ENTRIES most recently used keymaps are kept.
+ */
+#define XKB_CACHE_PREFIX        "xkbcache-"
+#define XKB_CACHE_ENTRIES       32
+#define XKB_CACHE_FILES         256     /* component files per keymap */
+#define XKB_CACHE_FILE_MAX      (1 << 20)
+
+static const char *xkb_data_dirs[] = {
+    "keycodes", "types", "compat", "symbols", "geometry", "rules"
+};
+
+typedef struct {
+    void *ctx;
+    int nfiles;
+    char *files[XKB_CACHE_FILES];
+} XkbCacheKeyRec;
+
+static void XkbCacheHashIncludes(XkbCacheKeyRec *key, const char *dir,
+                                 const char *text, size_t len);
+
+/*
+ * Add a component file to the key: its path, modification time and size,
+ * and then the files it includes.  Each file is only looked at once.
+ */
+static void
+XkbCacheHashFile(XkbCacheKeyRec *key, const char *dir,
+                 const char *name, size_t len)
+{
+    char path[PATH_MAX], *text = NULL;
+    struct stat st;
+    ssize_t n = -1;
+    int i, fd;
+
+    if (snprintf(path, sizeof(path), "%s/%s/%.*s", XkbBaseDirectory, dir,
+                 (int) len, name) >= sizeof(path))
+        return;
+    for (i = 0; i < key->nfiles; i++)
+        if (strcmp(key->files[i], path) == 0)
+            return;
+    if (key->nfiles == XKB_CACHE_FILES ||
+        !(key->files[key->nfiles] = strdup(path)))
+        return;
+    key->nfiles++;
+
+    /* A missing file still counts, in case it turns up later */
+    x_sha1_update(key->ctx, path, strlen(path) + 1);
+    if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0)
+        return;
+    if (fstat(fd, &st) == 0) {
+        x_sha1_update(key->ctx, &st.st_mtime, sizeof(st.st_mtime));
+        x_sha1_update(key->ctx, &st.st_size, sizeof(st.st_size));
+        if (S_ISREG(st.st_mode) && st.st_size <= XKB_CACHE_FILE_MAX &&
+            (text = malloc(st.st_size)))
+            n = read(fd, text, st.st_size);
+    }
+    close(fd);
+    if (n > 0)
+        XkbCacheHashIncludes(key, dir, text, n);
+    free(text);
+}
+
+/* One name from an include statement, like "us(intl):2" */
+static void
+XkbCacheHashName(XkbCacheKeyRec *key, const char *dir,
+                 const char *name, size_t len)
+{
+    size_t n;
+
+    for (n = 0; n < len && name[n] != '(' && name[n] != ':'; n++)
+        if (name[n] == '%')
+            return;
+    if (n > 0)
+        XkbCacheHashFile(key, dir, name, n);
+}
+
+/*
+ * Find the include, augment, override and replace statements in text and
+ * add the files they name.  Statements in comments are picked up as well,
+ * which only costs looking at a file xkbcomp won't read.
+ */
+static void
+XkbCacheHashIncludes(XkbCacheKeyRec *key, const char *dir,
+                     const char *text, size_t len)
+{
+    static const char *keywords[] = {
+        "include", "augment", "override", "replace"
+    };
+    const char *end = text + len, *p, *q, *name;
+    size_t n;
+    int i;
+
+    for (p = text; p < end; p++) {
+        if (p > text && (isalnum((unsigned char) p[-1]) || p[-1] == '_'))
+            continue;
+        for (i = 0; i < ARRAY_SIZE(keywords); i++) {
+            n = strlen(keywords[i]);
+            if (end - p > n && strncmp(p, keywords[i], n) == 0)
+                break;
+        }
+        if (i == ARRAY_SIZE(keywords))
+            continue;
+        for (q = p + n; q < end && isspace((unsigned char) *q); q++)
+            ;
+        if (q == end || *q != '"')
+            continue;
+        for (name = ++q; q < end && *q != '"'; q++) {
+            if (*q == '+' || *q == '|') {
+                XkbCacheHashName(key, dir, name, q - name);
+                name = q + 1;
+            }
+        }
+        if (q == end)
+            break;
+        XkbCacheHashName(key, dir, name, q - name);
+        p = q;
+    }
+}
+
+/* Add the files included by each section of xkbcomp's input */
+static void
+XkbCacheHashKeymap(XkbCacheKeyRec *key, const char *text, size_t len)
+{
+    static const struct {
+        const char *section;
+        const char *dir;
+    } sections[] = {
+        { "xkb_keycodes", "keycodes" },
+        { "xkb_types", "types" },
+        { "xkb_compat", "compat" },
+        { "xkb_symbols", "symbols" },
+        { "xkb_geometry", "geometry" },
+    };
+    const char *end = text + len, *start, *next;
+    int i;
+
+    for (start = strstr(text, "xkb_"); start; start = next) {
+        next = strstr(start + 4, "xkb_");
+        for (i = 0; i < ARRAY_SIZE(sections); i++) {
+            if (strncmp(start, sections[i].section,
+                        strlen(sections[i].section)) == 0) {
+                XkbCacheHashIncludes(key, sections[i].dir, start,
+                                     (next ? next : end) - start);
+                break;
+            }
+        }
+    }
+}
+
+/* Add the path, modification time and size of the xkbcomp that would run */
+static void
+XkbCacheHashXkbComp(void *ctx)
+{
+    char path[PATH_MAX];
+    const char *dirs, *sep;
+    struct stat st;
+    int len;
+
+    path[0] = '\0';
+    if (XkbBinDirectory != NULL) {
+        len = strlen(XkbBinDirectory);
+        if (snprintf(path, sizeof(path), "%s%sxkbcomp", XkbBinDirectory,
+                     (len >= strlen(PATHSEPARATOR) &&
+                      strcmp(XkbBinDirectory + len - strlen(PATHSEPARATOR),
+                             PATHSEPARATOR) == 0) ? "" : PATHSEPARATOR) >=
+            sizeof(path))
+            return;
+    }
+    else {
+        /* As the shell will look for it */
+        for (dirs = getenv("PATH"); dirs && !path[0];
+             dirs = sep ? sep + 1 : NULL) {
+            sep = strchr(dirs, ':');
+            len = sep ? sep - dirs : strlen(dirs);
+            if (snprintf(path, sizeof(path), "%.*s/xkbcomp", len ? len : 1,
+                         len ? dirs : ".") >= sizeof(path) ||
+                access(path, X_OK) != 0)
+                path[0] = '\0';
+        }
+    }
+
+    x_sha1_update(ctx, path, strlen(path) + 1);
+    if (path[0] && stat(path, &st) == 0) {
+        x_sha1_update(ctx, &st.st_mtime, sizeof(st.st_mtime));
+        x_sha1_update(ctx, &st.st_size, sizeof(st.st_size));
+    }
+}
+
+static Bool
+XkbCacheName(char *text, size_t len, char *name, size_t size)
+{
+    unsigned char sha1[20];
+    char path[PATH_MAX];
+    struct stat st;
+    XkbCacheKeyRec key = { 0 };
+    int i;
+
+    if (len > INT_MAX || !(key.ctx = x_sha1_init()))
+        return FALSE;
+    x_sha1_update(key.ctx, text, len);
+    for (i = 0; i < ARRAY_SIZE(xkb_data_dirs); i++) {
+        if (snprintf(path, sizeof(path), "%s/%s", XkbBaseDirectory,
+                     xkb_data_dirs[i]) >= sizeof(path) ||
+            stat(path, &st) != 0)
+            continue;
+        x_sha1_update(key.ctx, &st.st_mtime, sizeof(st.st_mtime));
+    }
+    XkbCacheHashKeymap(&key, text, len);
+    for (i = 0; i < key.nfiles; i++)
+        free(key.files[i]);
+    XkbCacheHashXkbComp(key.ctx);
+    if (!x_sha1_final(key.ctx, sha1))
+        return FALSE;
+
+    if (size < sizeof(XKB_CACHE_PREFIX) + 2 * sizeof(sha1))
+        return FALSE;
+    strcpy(name, XKB_CACHE_PREFIX);
+    for (i = 0; i < sizeof(sha1); i++)
+        sprintf(name + strlen(XKB_CACHE_PREFIX) + 2 * i, "%02x", sha1[i]);
+    return TRUE;
+}
+
+/*
+ * Open a regular file of ours in the output directory for reading.
+ * Returns the descriptor, or -1.
+ */
+static int
+XkbCacheOpenPath(const char *path, struct stat *st)
+{
+    int fd = open(path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+
+    if (fd < 0)
+        return -1;
+    if (fstat(fd, st) != 0 || !S_ISREG(st->st_mode) ||
+        st->st_uid != geteuid()) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/*
+ * Open the cached keymap, if there is one we can trust: one we wrote
+ * ourselves and nobody else can have changed.
+ */
+static FILE *
+XkbCacheOpen(const char *name)
+{
+    char path[PATH_MAX];
+    struct stat st;
+    FILE *file;
+    int fd;
+
+    if (!XkmFileName(name, path, sizeof(path)) ||
+        (fd = XkbCacheOpenPath(path, &st)) < 0)
+        return NULL;
+    if (st.st_mode & (S_IWGRP | S_IWOTH) ||
+        !(file = fdopen(fd, "rb"))) {
+        close(fd);
+        return NULL;
+    }
+    /* Most recently used, for XkbCachePrune */
+    (void) futimens(fd, NULL);
+    return file;
+}
+
+typedef struct {
+    time_t mtime;
+    char name[NAME_MAX + 1];
+} XkbCacheEntryRec;
+
+static int
+XkbCacheEntryCompare(const void *a, const void *b)
+{
+    const XkbCacheEntryRec *ea = a, *eb = b;
+
+    return ea->mtime < eb->mtime ? -1 : ea->mtime > eb->mtime;
+}
+
+/*
+ * Remove all but the XKB_CACHE_ENTRIES most recently used cache files
+ * of ours from the output directory.  Runs on the precompile thread
+ * too, so it must not log.
+ */
+static void
+XkbCachePrune(void)
+{
+    XkbCacheEntryRec *entries = NULL, *tmp;
+    int count = 0, size = 0, i;
+    char dir[PATH_MAX], *slash;
+    struct dirent *ent;
+    struct stat st;
+    DIR *d;
+
+    if (!XkmFileName(XKB_CACHE_PREFIX, dir, sizeof(dir)) ||
+        !(slash = strrchr(dir, '/')))
+        return;
+    slash[1] = '\0';
+    if (!(d = opendir(dir)))
+        return;
+
+    while ((ent = readdir(d)) != NULL) {
+        size_t len = strlen(ent->d_name);
+
+        if (strncmp(ent->d_name, XKB_CACHE_PREFIX,
+                    strlen(XKB_CACHE_PREFIX)) != 0 ||
+            len < 4 || strcmp(ent->d_name + len - 4, ".xkm") != 0 ||
+            fstatat(dirfd(d), ent->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0 ||
+            !S_ISREG(st.st_mode) || st.st_uid != geteuid())
+            continue;
+        if (count == size) {
+            size = size ? size * 2 : 2 * XKB_CACHE_ENTRIES;
+            tmp = reallocarray(entries, size, sizeof(*entries));
+            if (!tmp)
+                break;
+            entries = tmp;
+        }
+        entries[count].mtime = st.st_mtime;
+        strlcpy(entries[count].name, ent->d_name,
+                sizeof(entries[count].name));
+        count++;
+    }
+
+    if (count > XKB_CACHE_ENTRIES) {
+        qsort(entries, count, sizeof(*entries), XkbCacheEntryCompare);
+        for (i = 0; i < count - XKB_CACHE_ENTRIES; i++)
+            (void) unlinkat(dirfd(d), entries[i].name, 0);
+    }
+    free(entries);
+    closedir(d);
+}
+
+/*
+ * Turn the keymap xkbcomp just wrote into the cache entry name, and
+ * return it open for loading.
+ */
+static FILE *
+XkbCacheStore(const char *keymap, const char *name)
+{
+    char from[PATH_MAX], to[PATH_MAX];
+    struct stat st;
+    FILE *file;
+    int fd;
+
+    if (!XkmFileName(keymap, from, sizeof(from)) ||
+        !XkmFileName(name, to, sizeof(to)) ||
+        (fd = XkbCacheOpenPath(from, &st)) < 0)
+        return NULL;
+    if (fchmod(fd, 0644) != 0 || rename(from, to) != 0 ||
+        !(file = fdopen(fd, "rb"))) {
+        close(fd);
+        return NULL;
+    }
+    XkbCachePrune();
+    return file;
+}
+#endif
+
+#if defined(INPUTTHREAD) && !defined(WIN32)
+/*
+ * The first keymap the server needs is usually the default one, when
+ * InitInput adds the core keyboard, well after it could be known.
+ * XkbPrecompileKeymap runs xkbcomp for it on a helper thread while the
+ * screens and extensions are set up, and leaves the result in the cache.
+ */
+typedef struct {
+    char *text;
+    size_t len;
+    char name[PATH_MAX];
+} XkbPrecompileRec;
+
+static pthread_t precompile_thread;
+static Bool precompiling;
+
+/* Whether there is a cache entry RunXkbCompCached would use */
+static Bool
+XkbCacheHit(const char *name)
+{
+    FILE *file = XkbCacheOpen(name);
+
+    if (!file)
+        return FALSE;
+    fclose(file);
+    return TRUE;
+}
+
+extern char **environ;
+
+/*
+ * Start cmd with a pipe to its stdin, returned in *fd.  The helper thread
+ * blocks every signal, so the child is given an empty signal mask rather
+ * than inheriting that one.  Popen() is for the main thread, and setuid
+ * servers never get here, so there are no privileges to drop.
+ */
+static pid_t
+XkbPrecompileSpawn(const char *cmd, int *fd)
+{
+    char *argv[] = { "sh", "-c", (char *) cmd, NULL };
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attr;
+    sigset_t mask;
+    int pdes[2];
+    pid_t pid = -1;
+
+    if (pipe(pdes) < 0)
+        return -1;
+    /* Keep the write end out of anything else the server starts */
+    fcntl(pdes[1], F_SETFD, FD_CLOEXEC);
+
+    sigemptyset(&mask);
+    if (posix_spawn_file_actions_init(&actions) == 0) {
+        if (posix_spawnattr_init(&attr) == 0) {
+            if (posix_spawn_file_actions_adddup2(&actions, pdes[0], 0) == 0 &&
+                posix_spawn_file_actions_addclose(&actions, pdes[0]) == 0 &&
+                posix_spawnattr_setsigmask(&attr, &mask) == 0 &&
+                posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK) == 0 &&
+                posix_spawn(&pid, "/bin/sh", &actions, &attr, argv,
+                            environ) != 0)
+                pid = -1;
+            posix_spawnattr_destroy(&attr);
+        }
+        posix_spawn_file_actions_destroy(&actions);
+    }
+
+    close(pdes[0]);
+    if (pid == -1)
+        close(pdes[1]);
+    else
+        *fd = pdes[1];
+    return pid;
+}
+
+static void *
+XkbPrecompileThread(void *arg)
+{
+    XkbPrecompileRec *pre = arg;
+    char keymap[PATH_MAX], path[PATH_MAX];
+    char *cmd;
+    FILE *out, *file = NULL;
+    int fd, status = -1;
+    pid_t pid;
+
+    snprintf(keymap, sizeof(keymap), "server-%s-dflt", display);
+    cmd = XkbCompCommand("-", keymap);
+    if (cmd && (pid = XkbPrecompileSpawn(cmd, &fd)) != -1) {
+        if ((out = fdopen(fd, "w")) != NULL) {
+            fwrite(pre->text, pre->len, 1, out);
+            fclose(out);
+        }
+        else
+            close(fd);
+        while (waitpid(pid, &status, 0) == -1 && errno == EINTR)
+            ;
+        if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
+            file = XkbCacheStore(keymap, pre->name);
+        if (file)
+            fclose(file);
+        else if (XkmFileName(keymap, path, sizeof(path)))
+            (void) unlink(path);
+    }
+    free(cmd);
+    free(pre->text);
+    free(pre);
+    return NULL;
+}
+
+static void
+XkbPrecompileWait(void)
+{
+    if (precompiling) {
+        pthread_join(precompile_thread, NULL);
+        precompiling = FALSE;
+    }
+}
+#else
+static void
+XkbPrecompileWait(void)
+{
+}
+#endif
+
+/**
+ * Like RunXkbComp, but look the keymap up in the cache first and add it
+ * there afterwards.  If the returned keymap is a cache entry, *cachedRtrn
+ * is set to it opened for LoadXKM; the file must not be removed once
+ * loaded.
+ */
+static char *
+RunXkbCompCached(xkbcomp_buffer_callback callback, void *userdata,
+                 FILE **cachedRtrn)
+{
+#ifndef WIN32
+    XkbKeymapString map;
+    char name[PATH_MAX], *text = NULL, *keymap;
+    size_t len = 0;
+    FILE *mem;
+
+    *cachedRtrn = NULL;
+    XkbPrecompileWait();
+    if (!XkbKeymapCache || !(mem = open_memstream(&text, &len)))
+        return RunXkbComp(callback, userdata);
+
+    (*callback)(mem, userdata);
+    if (fclose(mem) != 0 || !XkbCacheName(text, len, name, sizeof(name))) {
+        free(text);
+        return RunXkbComp(callback, userdata);
+    }
+
+    if ((*cachedRtrn = XkbCacheOpen(name)) != NULL) {
+        LogMessageVerb(X_INFO, 4, "XKB: Using cached keymap %s\n", name);
+        free(text);
+        return xnfstrdup(name);
+    }
+
+    map.keymap = text;
+    map.len = len;
+    keymap = RunXkbComp(xkb_write_keymap_string_cb, &map);
+    free(text);
+
+    if (keymap && (*cachedRtrn = XkbCacheStore(keymap, name)) != NULL) {
+        free(keymap);
+        return xnfstrdup(name);
+    }
+    return keymap;
+#else
+    *cachedRtrn = NULL;
+    return RunXkbComp(callback, userdata);
+#endif
+}
+
 typedef struct {
     XkbDescPtr xkb;
     XkbComponentNamesPtr names;
@@ -223,7 +821,8 @@ static Bool
 XkbDDXCompileKeymapByNames(XkbDescPtr xkb,
                            XkbComponentNamesPtr names,
                            unsigned want,
-                           unsigned need, char *nameRtrn, int nameRtrnLen)
+                           unsigned need, char *nameRtrn, int nameRtrnLen,
+                           FILE **cachedRtrn)
 {
     char *keymap;
     Bool rc = FALSE;
@@ -234,7 +833,8 @@ XkbDDXCompileKeymapByNames(XkbDescPtr xkb,
         .need = need
     };
 
-    keymap = RunXkbComp(xkb_write_keymap_for_names_cb, &ctx);
+    keymap = RunXkbCompCached(xkb_write_keymap_for_names_cb, &ctx,
+                              cachedRtrn);
 
     if (keymap) {
         if(nameRtrn)
@@ -248,18 +848,6 @@ XkbDDXCompileKeymapByNames(XkbDescPtr xkb,
     return rc;
 }
 
-typedef struct {
-    const char *keymap;
-    size_t len;
-} XkbKeymapString;
-
-static void
-xkb_write_keymap_string_cb(FILE *out, void *userdata)
-{
-    XkbKeymapString *s = userdata;
-    fwrite(s->keymap, s->len, 1, out);
-}
-
 static unsigned int
 XkbDDXLoadKeymapFromString(DeviceIntPtr keybd,
                           const char *keymap, int keymap_length,
@@ -269,6 +857,7 @@ XkbDDXLoadKeymapFromString(DeviceIntPtr keybd,
 {
     unsigned int have;
     char *map_name;
+    FILE *cached;
     XkbKeymapString map = {
         .keymap = keymap,
         .len = keymap_length
@@ -276,13 +865,13 @@ XkbDDXLoadKeymapFromString(DeviceIntPtr keybd,
 
     *xkbRtrn = NULL;
 
-    map_name = RunXkbComp(xkb_write_keymap_string_cb, &map);
+    map_name = RunXkbCompCached(xkb_write_keymap_string_cb, &map, &cached);
     if (!map_name) {
         LogMessage(X_ERROR, "XKB: Couldn't compile keymap\n");
         return 0;
     }
 
-    have = LoadXKM(want, need, map_name, xkbRtrn);
+    have = LoadXKM(want, need, map_name, cached, xkbRtrn);
     free(map_name);
 
     return have;
@@ -291,26 +880,13 @@ XkbDDXLoadKeymapFromString(DeviceIntPtr keybd,
 static FILE *
 XkbDDXOpenConfigFile(const char *mapName, char *fileNameRtrn, int fileNameRtrnLen)
 {
-    char buf[PATH_MAX], xkm_output_dir[PATH_MAX];
+    char buf[PATH_MAX];
     FILE *file;
 
     buf[0] = '\0';
     if (mapName != NULL) {
-        OutputDirectory(xkm_output_dir, sizeof(xkm_output_dir));
-        if ((XkbBaseDirectory != NULL) && (xkm_output_dir[0] != '/')
-#ifdef WIN32
-            && (!isalpha(xkm_output_dir[0]) || xkm_output_dir[1] != ':')
-#endif
-            ) {
-            if (snprintf(buf, PATH_MAX, "%s/%s%s.xkm", XkbBaseDirectory,
-                         xkm_output_dir, mapName) >= PATH_MAX)
-                buf[0] = '\0';
-        }
-        else {
-            if (snprintf(buf, PATH_MAX, "%s%s.xkm", xkm_output_dir, mapName)
-                >= PATH_MAX)
-                buf[0] = '\0';
-        }
+        if (!XkmFileName(mapName, buf, PATH_MAX))
+            buf[0] = '\0';
         if (buf[0] != '\0')
             file = fopen(buf, "rb");
         else
@@ -324,14 +900,25 @@ XkbDDXOpenConfigFile(const char *mapName, char *fileNameRtrn, int fileNameRtrnLe
     return file;
 }
 
+/*
+ * Load the compiled keymap, from the cache file RunXkbCompCached opened
+ * if there is one.  Any other .xkm is removed once read.
+ */
 static unsigned
-LoadXKM(unsigned want, unsigned need, const char *keymap, XkbDescPtr *xkbRtrn)
+LoadXKM(unsigned want, unsigned need, const char *keymap, FILE *cached,
+        XkbDescPtr *xkbRtrn)
 {
     FILE *file;
     char fileName[PATH_MAX];
     unsigned missing;
 
-    file = XkbDDXOpenConfigFile(keymap, fileName, PATH_MAX);
+    if (cached) {
+        file = cached;
+        if (!keymap || !XkmFileName(keymap, fileName, PATH_MAX))
+            fileName[0] = '\0';
+    }
+    else
+        file = XkbDDXOpenConfigFile(keymap, fileName, PATH_MAX);
     if (file == NULL) {
         LogMessage(X_ERROR, "Couldn't open compiled keymap file %s\n",
                    fileName);
@@ -341,7 +928,8 @@ LoadXKM(unsigned want, unsigned need, const char *keymap, XkbDescPtr *xkbRtrn)
     if (*xkbRtrn == NULL) {
         LogMessage(X_ERROR, "Error loading keymap %s\n", fileName);
         fclose(file);
-        (void) unlink(fileName);
+        if (fileName[0])
+            (void) unlink(fileName);
         return 0;
     }
     else {
@@ -349,7 +937,8 @@ LoadXKM(unsigned want, unsigned need, const char *keymap, XkbDescPtr *xkbRtrn)
                (*xkbRtrn)->defined);
     }
     fclose(file);
-    (void) unlink(fileName);
+    if (!cached)
+        (void) unlink(fileName);
     return (need | want) & (~missing);
 }
 
@@ -361,6 +950,7 @@ XkbDDXLoadKeymapByNames(DeviceIntPtr keybd,
                         XkbDescPtr *xkbRtrn, char *nameRtrn, int nameRtrnLen)
 {
     XkbDescPtr xkb;
+    FILE *cached;
 
     *xkbRtrn = NULL;
     if ((keybd == NULL) || (keybd->key == NULL) ||
@@ -376,12 +966,12 @@ XkbDDXLoadKeymapByNames(DeviceIntPtr keybd,
         return 0;
     }
     else if (!XkbDDXCompileKeymapByNames(xkb, names, want, need,
-                                         nameRtrn, nameRtrnLen)) {
+                                         nameRtrn, nameRtrnLen, &cached)) {
         LogMessage(X_ERROR, "XKB: Couldn't compile keymap\n");
         return 0;
     }
 
-    return LoadXKM(want, need, nameRtrn, xkbRtrn);
+    return LoadXKM(want, need, nameRtrn, cached, xkbRtrn);
 }
 
 Bool
@@ -548,3 +1138,53 @@ XkbCompileKeymapFromString(DeviceIntPtr dev,
 
     return KeymapOrDefaults(dev, xkb);
 }
+
+/**
+ * Start compiling the default keymap in the background, see
+ * XkbPrecompileThread.
+ */
+void
+XkbPrecompileKeymap(void)
+{
+#if defined(INPUTTHREAD) && !defined(WIN32)
+    XkbRMLVOSet rmlvo;
+    XkbComponentNamesRec kccgst = { 0 };
+    XkbPrecompileRec *pre;
+    sigset_t set, old;
+    unsigned int need;
+    FILE *mem;
+
+    XkbPrecompileWait();
+    if (!XkbKeymapCache || getuid() != geteuid())
+        return;
+
+    /* As XkbCompileKeymap asks for them */
+    need = XkmSymbolsMask | XkmCompatMapMask | XkmTypesMask |
+        XkmKeyNamesMask | XkmVirtualModsMask;
+
+    XkbGetRulesDflts(&rmlvo);
+    pre = calloc(1, sizeof(*pre));
+    if (pre && XkbRMLVOtoKcCGST(NULL, &rmlvo, &kccgst) &&
+        (mem = open_memstream(&pre->text, &pre->len)) != NULL) {
+        XkbWriteXKBKeymapForNames(mem, &kccgst, NULL, XkmAllIndicesMask, need);
+        if (fclose(mem) == 0 &&
+            XkbCacheName(pre->text, pre->len, pre->name, sizeof(pre->name)) &&
+            !XkbCacheHit(pre->name)) {
+            /* The helper must never handle signals */
+            sigfillset(&set);
+            pthread_sigmask(SIG_SETMASK, &set, &old);
+            precompiling = pthread_create(&precompile_thread, NULL,
+                                          XkbPrecompileThread, pre) == 0;
+            pthread_sigmask(SIG_SETMASK, &old, NULL);
+            if (precompiling)
+                pre = NULL;
+        }
+    }
+    if (pre) {
+        free(pre->text);
+        free(pre);
+    }
+    XkbFreeComponentNames(&kccgst, FALSE);
+    XkbFreeRMLVOSet(&rmlvo, FALSE);
+#endif
+}
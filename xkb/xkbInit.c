@@ -89,6 +89,7 @@ typedef struct _SrvXkmInfo {
 
 const char *XkbBaseDirectory = XKB_BASE_DIRECTORY;
 const char *XkbBinDirectory = XKB_BIN_DIRECTORY;
+Bool XkbKeymapCache = TRUE;
 static int XkbWantAccessX = 0;
 
 static char *XkbRulesDflt = NULL;
@@ -767,6 +768,10 @@ XkbProcessArguments(int argc, char *argv[], int i)
             return -1;
         }
     }
+    else if (strcmp(argv[i], "-noxkbcache") == 0) {
+        XkbKeymapCache = FALSE;
+        return 1;
+    }
     else if ((strncmp(argv[i], "-accessx", 8) == 0) ||
              (strncmp(argv[i], "+accessx", 8) == 0)) {
         int j = 1;
@@ -831,4 +836,5 @@ XkbUseMsg(void)
     ErrorF("                       enable/disable accessx key sequences\n");
     ErrorF("-ardelay               set XKB autorepeat delay\n");
     ErrorF("-arinterval            set XKB autorepeat interval\n");
+    ErrorF("-noxkbcache            always run xkbcomp, ignoring compiled keymaps\n");
 }